@@ -20,6 +20,7 @@
  */
 
 #include "animatedsprite.h"
+#include "game.h"
 #include "graphics.h"
 #include "log.h"
 
@@ -38,6 +39,9 @@ AnimatedSprite::AnimatedSprite(SpriteDef *sprite):
     mFrameIndex(0),
     mFrameTime(0),
     mSprite(sprite),
+    mHandle(0),
+    mPlaceholder(0),
+    mPendingAction(ACTION_STAND),
     mAction(0),
     mAnimation(0),
     mFrame(0),
@@ -63,9 +67,62 @@ AnimatedSprite *AnimatedSprite::load(const std::string &filename, int variant)
     return as;
 }
 
+AnimatedSprite::AnimatedSprite():
+    mDirection(DIRECTION_DOWN),
+    mLastTime(0),
+    mFrameIndex(0),
+    mFrameTime(0),
+    mSprite(0),
+    mHandle(0),
+    mPendingAction(ACTION_STAND),
+    mAction(0),
+    mAnimation(0),
+    mFrame(0),
+    mAlpha(1.0f)
+{
+    ResourceManager *resman = ResourceManager::getInstance();
+    mPlaceholder = resman->getImage("graphics/gui/circle-gray.png");
+}
+
+AnimatedSprite *AnimatedSprite::loadAsync(const std::string &filename,
+                                          int variant)
+{
+    ResourceManager *resman = ResourceManager::getInstance();
+    AnimatedSprite *as = new AnimatedSprite;
+    as->mHandle = resman->getSpriteAsync(filename, variant, spriteLoaded, as);
+    return as;
+}
+
+void AnimatedSprite::spriteLoaded(ResourceHandle *handle, void *data)
+{
+    AnimatedSprite *as = static_cast<AnimatedSprite*>(data);
+    SpriteDef *sprite = static_cast<SpriteDef*>(handle->getResource());
+
+    // Keep showing the placeholder when the sprite couldn't be loaded
+    if (!sprite)
+        return;
+
+    as->mSprite = sprite;
+    as->mSprite->incRef();
+
+    if (as->mPlaceholder)
+    {
+        as->mPlaceholder->decRef();
+        as->mPlaceholder = 0;
+    }
+
+    as->play(as->mPendingAction);
+    requestRedraw();
+}
+
 AnimatedSprite::~AnimatedSprite()
 {
-    mSprite->decRef();
+    if (mHandle)
+        mHandle->release();
+    if (mSprite)
+        mSprite->decRef();
+    if (mPlaceholder)
+        mPlaceholder->decRef();
 }
 
 void AnimatedSprite::reset()
@@ -77,6 +134,10 @@ void AnimatedSprite::reset()
 
 void AnimatedSprite::play(SpriteAction spriteAction)
 {
+    mPendingAction = spriteAction;
+    if (!mSprite)
+        return;
+
     Action *action = mSprite->getAction(spriteAction);
     if (!action)
         return;
@@ -93,7 +154,7 @@ void AnimatedSprite::play(SpriteAction spriteAction)
     }
 }
 
-void AnimatedSprite::update(int time)
+bool AnimatedSprite::update(int time)
 {
     // Avoid freaking out at first frame or when tick_time overflows
     if (time < mLastTime || mLastTime == 0)
@@ -101,16 +162,20 @@ void AnimatedSprite::update(int time)
 
     // If not enough time has passed yet, do nothing
     if (time <= mLastTime || !mAnimation)
-        return;
+        return false;
 
     unsigned int dt = time - mLastTime;
     mLastTime = time;
 
+    const Frame *oldFrame = mFrame;
+
     if (!updateCurrentAnimation(dt))
     {
         // Animation finished, reset to default
         play(ACTION_STAND);
     }
+
+    return mFrame != oldFrame;
 }
 
 bool AnimatedSprite::updateCurrentAnimation(unsigned int time)
@@ -143,18 +208,25 @@ bool AnimatedSprite::updateCurrentAnimation(unsigned int time)
 
 bool AnimatedSprite::draw(Graphics *graphics, int posX, int posY) const
 {
+    // The placeholder is centered at the bottom of the tile
+    if (!mSprite && mPlaceholder)
+    {
+        return graphics->drawImage(mPlaceholder,
+                                   posX + 16 - mPlaceholder->getWidth() / 2,
+                                   posY + 32 - mPlaceholder->getHeight(),
+                                   mAlpha);
+    }
+
     if (!mFrame)
         return false;
 
     if (!mFrame->image)
       return false;
 
-    if (mFrame->image->getAlpha() != mAlpha)
-        mFrame->image->setAlpha(mAlpha);
-
     return graphics->drawImage(mFrame->image,
                                posX + mFrame->offsetX,
-                               posY + mFrame->offsetY);
+                               posY + mFrame->offsetY,
+                               mAlpha);
 }
 
 void AnimatedSprite::setDirection(SpriteDirection direction)
@@ -179,6 +251,9 @@ void AnimatedSprite::setDirection(SpriteDirection direction)
 
 int AnimatedSprite::getWidth() const
 {
+    if (!mSprite && mPlaceholder)
+        return mPlaceholder->getWidth();
+
     if (mFrame)
         return mFrame->image ? mFrame->image->getWidth() : 0;
     else
@@ -187,6 +262,9 @@ int AnimatedSprite::getWidth() const
 
 int AnimatedSprite::getHeight() const
 {
+    if (!mSprite && mPlaceholder)
+        return mPlaceholder->getHeight();
+
     if (mFrame)
         return mFrame->image ? mFrame->image->getHeight() : 0;
     else
@@ -29,6 +29,8 @@
 
 class Animation;
 class Graphics;
+class Image;
+class ResourceHandle;
 struct Frame;
 
 /**
@@ -53,6 +55,16 @@ class AnimatedSprite
         static AnimatedSprite *load(const std::string &filename,
                                     int variant = 0);
 
+        /**
+         * Like load(), but lets the resource manager load the sprite in the
+         * background. A placeholder is drawn until the sprite is ready.
+         *
+         * @param filename the file of the sprite to animate
+         * @param variant  the sprite variant
+         */
+        static AnimatedSprite *loadAsync(const std::string &filename,
+                                         int variant = 0);
+
         /**
          * Destructor.
          */
@@ -71,8 +83,12 @@ class AnimatedSprite
         /**
          * Inform the animation of the passed time so that it can output the
          * correct animation frame.
+         *
+         * @return whether a different frame is shown. The owner of the sprite
+         *         is to report the change, since only it knows where the
+         *         sprite is drawn.
          */
-        void update(int time);
+        bool update(int time);
 
         /**
          * Draw the current animation frame at the coordinates given in screen
@@ -108,6 +124,18 @@ class AnimatedSprite
         { return mAlpha; }
 
     private:
+        /**
+         * Constructor for a sprite of which the definition is still being
+         * loaded.
+         */
+        AnimatedSprite();
+
+        /**
+         * Called by the resource manager when the sprite definition has been
+         * loaded.
+         */
+        static void spriteLoaded(ResourceHandle *handle, void *data);
+
         bool updateCurrentAnimation(unsigned int dt);
 
         SpriteDirection mDirection;    /**< The sprite direction. */
@@ -117,6 +145,9 @@ class AnimatedSprite
         int mFrameTime;                /**< The time since start of frame. */
 
         SpriteDef *mSprite;            /**< The sprite definition. */
+        ResourceHandle *mHandle;       /**< The sprite being loaded. */
+        Image *mPlaceholder;           /**< Drawn until loaded. */
+        SpriteAction mPendingAction;   /**< The action to play once loaded. */
         Action *mAction;               /**< The currently active action. */
         Animation *mAnimation;         /**< The currently active animation. */
         Frame *mFrame;                 /**< The currently active frame. */
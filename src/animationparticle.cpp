@@ -20,6 +20,7 @@
  */
 
 #include "animationparticle.h"
+#include "game.h"
 #include "graphics.h"
 #include "simpleanimation.h"
 
@@ -44,7 +45,14 @@ AnimationParticle::~AnimationParticle()
 bool AnimationParticle::update()
 {
     mAnimation->update(10); // particle engine is updated every 10ms
-    mImage = mAnimation->getCurrentImage();
+
+    Image *image = mAnimation->getCurrentImage();
+    if (image != mImage)
+    {
+        requestMapRedraw(this);
+        mImage = image;
+        requestMapRedraw(this);
+    }
 
     return Particle::update();
 }
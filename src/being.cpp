@@ -52,6 +52,9 @@
 #include "utils/stringutils.h"
 #include "utils/xml.h"
 
+#include <guichan/rectangle.hpp>
+
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -107,14 +110,16 @@ Being::Being(int id, int job, Map *map):
 
 Being::~Being()
 {
+    // Leave the map while the sprites are still there to tell what the
+    // being covered
+    setMap(NULL);
+
     mUsedTargetCursor = NULL;
     delete_all(mSprites);
 
     if (player_node && player_node->getTarget() == this)
         player_node->setTarget(NULL);
 
-    setMap(NULL);
-
     delete mSpeechBubble;
     delete mDispName;
     delete mText;
@@ -125,8 +130,21 @@ void Being::setPosition(const Vector &pos)
     mPos = pos;
 
     // Update pixel coordinates (convert once, for performance reasons)
-    mPx = (int) pos.x;
-    mPy = (int) pos.y;
+    const int px = (int) pos.x;
+    const int py = (int) pos.y;
+
+    if (px != mPx || py != mPy)
+    {
+        // Speech and emotions are drawn outside of the bounds
+        if (mSpeechTime > 0 || mEmotion)
+            requestRedraw();
+        else
+            requestMapRedraw(this);
+
+        mPx = px;
+        mPy = py;
+        requestMapRedraw(this);
+    }
 
     updateCoords();
 
@@ -255,6 +273,8 @@ void Being::setSpeech(const std::string &text, int time)
     if (!mSpeech.empty())
         mSpeechTime = time <= SPEECH_MAX_TIME ? time : SPEECH_MAX_TIME;
 
+    requestRedraw();
+
     const int speech = (int) config.getValue("speech", TEXT_OVERHEAD);
     if (speech == TEXT_OVERHEAD)
     {
@@ -380,13 +400,19 @@ void Being::setMap(Map *map)
 {
     // Remove sprite from potential previous map
     if (mMap)
+    {
+        requestMapRedraw(this);
         mMap->removeSprite(mMapSprite);
+    }
 
     mMap = map;
 
     // Add sprite to potential new map
     if (mMap)
+    {
         mMapSprite = mMap->addSprite(this);
+        requestMapRedraw(this);
+    }
 
     // Clear particle effect list because child particles became invalid
     mChildParticleEffects.clear();
@@ -439,6 +465,7 @@ void Being::setAction(Action action, int attackType)
             if (*it)
                 (*it)->play(currentAction);
         mAction = action;
+        requestMapRedraw(this);
     }
 }
 
@@ -468,6 +495,8 @@ void Being::setDirection(Uint8 direction)
     for (SpriteIterator it = mSprites.begin(); it != mSprites.end(); it++)
         if (*it)
            (*it)->setDirection(dir);
+
+    requestMapRedraw(this);
 }
 
 #ifdef EATHENA_SUPPORT
@@ -511,7 +540,11 @@ void Being::logic()
 {
     // Reduce the time that speech is still displayed
     if (mSpeechTime > 0)
+    {
         mSpeechTime--;
+        if (mSpeechTime == 0)
+            requestRedraw();
+    }
 
     // Remove text and speechbubbles if speech boxes aren't being used
     if (mSpeechTime == 0 && mText)
@@ -597,16 +630,24 @@ void Being::logic()
     {
         mEmotionTime--;
         if (mEmotionTime == 0)
+        {
             mEmotion = 0;
+            requestRedraw();
+        }
     }
 
     // Update sprite animations
-    if (mUsedTargetCursor)
-        mUsedTargetCursor->update(tick_time * 10);
+    bool framesChanged = false;
+
+    if (mUsedTargetCursor && mUsedTargetCursor->update(tick_time * 10))
+        framesChanged = true;
 
     for (SpriteIterator it = mSprites.begin(); it != mSprites.end(); it++)
-        if (*it)
-            (*it)->update(tick_time * 10);
+        if (*it && (*it)->update(tick_time * 10))
+            framesChanged = true;
+
+    if (framesChanged)
+        requestMapRedraw(this);
 
     // Restart status/particle effects, if needed
     if (mMustResetParticles) {
@@ -815,10 +856,54 @@ int Being::getHeight() const
         return DEFAULT_BEING_HEIGHT;
 }
 
+bool Being::getBounds(gcn::Rectangle &bounds) const
+{
+    const int width = getWidth();
+    const int height = getHeight();
+
+    // The frame offsets of the sprites aren't known here, so leave a margin
+    // of half a sprite around the base sprite
+    bounds.x = mPx - width;
+    bounds.y = mPy - height - height / 2;
+    bounds.width = width * 2;
+    bounds.height = height * 2;
+
+    // The target cursor is drawn around the being
+    if (mUsedTargetCursor)
+    {
+        const gcn::Rectangle cursor =
+            mUsedTargetCursor->getArea(mPx - 16, mPy - 32);
+        const int right = std::max(bounds.x + bounds.width,
+                                   cursor.x + cursor.width);
+        const int bottom = std::max(bounds.y + bounds.height,
+                                    cursor.y + cursor.height);
+        bounds.x = std::min(bounds.x, cursor.x);
+        bounds.y = std::min(bounds.y, cursor.y);
+        bounds.width = right - bounds.x;
+        bounds.height = bottom - bounds.y;
+    }
+    return true;
+}
+
 void Being::setTargetAnimation(SimpleAnimation* animation)
 {
+    requestMapRedraw(this);
     mUsedTargetCursor = animation;
     mUsedTargetCursor->reset();
+    requestMapRedraw(this);
+}
+
+void Being::untarget()
+{
+    requestMapRedraw(this);
+    mUsedTargetCursor = NULL;
+}
+
+void Being::setEmote(Uint8 emotion, Uint8 emote_time)
+{
+    mEmotion = emotion;
+    mEmotionTime = emote_time;
+    requestRedraw();
 }
 
 struct EffectDescription {
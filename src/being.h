@@ -394,6 +394,11 @@ class Being : public Sprite, public ConfigListener
          */
         virtual int getHeight() const;
 
+        /**
+         * @see Sprite::getBounds()
+         */
+        virtual bool getBounds(gcn::Rectangle &bounds) const;
+
         /**
          * Returns the required size of a target cursor for this being.
          */
@@ -425,13 +430,9 @@ class Being : public Sprite, public ConfigListener
         /**
          * Untargets the being
          */
-        void untarget() { mUsedTargetCursor = NULL; }
+        void untarget();
 
-        void setEmote(Uint8 emotion, Uint8 emote_time)
-        {
-            mEmotion = emotion;
-            mEmotionTime = emote_time;
-        }
+        void setEmote(Uint8 emotion, Uint8 emote_time);
 
         /**
          * Sets the being's stun mode.  If zero, the being is `normal',
@@ -63,8 +63,10 @@ BeingManager::~BeingManager()
 void BeingManager::setMap(Map *map)
 {
     mMap = map;
-    if (player_node)
-        player_node->setMap(map);
+
+    // Besides the player, beings may have arrived while the map was loading
+    for (Beings::iterator i = mBeings.begin(); i != mBeings.end(); i++)
+        (*i)->setMap(map);
 }
 
 void BeingManager::setPlayer(LocalPlayer *player)
@@ -25,7 +25,10 @@
 #include "channel.h"
 #include "game.h"
 #include "localplayer.h"
+#include "map.h"
 #include "playerrelations.h"
+#include "profiler.h"
+#include "tracer.h"
 
 #include "gui/widgets/channeltab.h"
 #include "gui/widgets/chattab.h"
@@ -37,12 +40,27 @@
 #include "net/net.h"
 #include "net/partyhandler.h"
 
+#include "resources/maploader.h"
+
 #include "utils/gettext.h"
 #include "utils/stringutils.h"
 
-CommandHandler::CommandHandler()
+#include <algorithm>
+#include <functional>
+#include <physfs.h>
+#include <vector>
+
+CommandHandler::CommandHandler():
+    mBenchmarkLoader(0),
+    mBenchmarkParseTime(0.0f),
+    mBenchmarkCreateTime(0.0f)
 {}
 
+CommandHandler::~CommandHandler()
+{
+    delete mBenchmarkLoader;
+}
+
 void CommandHandler::handleCommand(const std::string &command, ChatTab *tab)
 {
     std::string::size_type pos = command.find(' ');
@@ -117,6 +135,14 @@ void CommandHandler::handleCommand(const std::string &command, ChatTab *tab)
     {
         handlePresent(args, tab);
     }
+    else if (type == "profile")
+    {
+        handleProfile(args, tab);
+    }
+    else if (type == "trace")
+    {
+        handleTrace(args, tab);
+    }
     else
     {
         tab->chatLog(_("Unknown command."));
@@ -174,6 +200,8 @@ void CommandHandler::handleHelp(const std::string &args, ChatTab *tab)
         tab->chatLog(_("/record > Start recording the chat to an external file"));
         tab->chatLog(_("/toggle > Determine whether <return> toggles the chat log"));
         tab->chatLog(_("/present > Get list of players present (sent to chat log, if logging)"));
+        tab->chatLog(_("/profile > Display or save the time spent on the last frames"));
+        tab->chatLog(_("/trace > Start or stop writing a trace for the trace viewer"));
 
         tab->chatLog(_("/announce > Global announcement (GM only)"));
 
@@ -256,6 +284,22 @@ void CommandHandler::handleHelp(const std::string &args, ChatTab *tab)
                   "sends it to either the record log if recording, or the chat "
                   "log otherwise."));
     }
+    else if (args == "profile")
+    {
+        tab->chatLog(_("Command: /profile"));
+        tab->chatLog(_("This command displays how long the last frames took "
+                       "and what the time was spent on."));
+        tab->chatLog(_("Command: /profile dump <filename>"));
+        tab->chatLog(_("This command saves the time spent on each of the last "
+                       "frames to the file <filename>, as comma separated "
+                       "values."));
+        tab->chatLog(_("Command: /profile reset"));
+        tab->chatLog(_("This command forgets about the last frames."));
+        tab->chatLog(_("Command: /profile maps"));
+        tab->chatLog(_("This command loads all maps in the background "
+                       "without using the map cache, and displays the ones "
+                       "that took the longest to create."));
+    }
     else if (args == "record")
     {
         tab->chatLog(_("Command: /record <filename>"));
@@ -275,6 +319,16 @@ void CommandHandler::handleHelp(const std::string &args, ChatTab *tab)
         tab->chatLog(_("Command: /toggle"));
         tab->chatLog(_("This command displays the return toggle status."));
     }
+    else if (args == "trace")
+    {
+        tab->chatLog(_("Command: /trace <filename>"));
+        tab->chatLog(_("This command starts writing where the time is spent "
+                       "to the file <filename>, which can be loaded in the "
+                       "Chrome trace viewer (chrome://tracing)."));
+        tab->chatLog(_("Command: /trace"));
+        tab->chatLog(_("This command stops writing the trace, or starts "
+                       "writing it to trace.json."));
+    }
     else if (args == "unignore")
     {
         tab->chatLog(_("Command: /unignore <player>"));
@@ -441,6 +495,152 @@ void CommandHandler::handlePresent(const std::string &args, ChatTab *tab)
     chatWindow->doPresent();
 }
 
+void CommandHandler::handleProfile(const std::string &args, ChatTab *tab)
+{
+    std::string::size_type pos = args.find(' ');
+    const std::string action(args, 0, pos);
+    std::string fileName(args, pos == std::string::npos ? args.size()
+                                                        : pos + 1);
+
+    if (action.empty())
+    {
+        tab->chatLog(strprintf(_("%d frames, p50: %.1f ms, p95: %.1f ms, "
+                                 "p99: %.1f ms"),
+                               Profiler::getSampleCount(),
+                               Profiler::getPercentile(0.50f),
+                               Profiler::getPercentile(0.95f),
+                               Profiler::getPercentile(0.99f)));
+
+        for (int i = 0; i < Profiler::SECTION_COUNT; i++)
+        {
+            const Profiler::Section section = (Profiler::Section) i;
+            tab->chatLog(strprintf(_("%s: %.2f ms per frame"),
+                                   Profiler::getSectionName(section),
+                                   Profiler::getAverage(section)));
+        }
+    }
+    else if (action == "dump")
+    {
+        if (fileName.empty())
+            fileName = "profile.csv";
+
+        const std::string file =
+            std::string(PHYSFS_getUserDir()) + "/.tmw/" + fileName;
+
+        if (Profiler::dump(file))
+            tab->chatLog(strprintf(_("Saved %d frames to %s."),
+                                   Profiler::getSampleCount(), file.c_str()));
+        else
+            tab->chatLog(strprintf(_("Could not write to %s."),
+                                   file.c_str()));
+    }
+    else if (action == "reset")
+    {
+        Profiler::reset();
+        tab->chatLog(_("Profile reset."));
+    }
+    else if (action == "maps")
+    {
+        if (mBenchmarkLoader || !mBenchmarkMaps.empty())
+        {
+            tab->chatLog(_("The maps are already being loaded."));
+            return;
+        }
+
+        // Every map is loaded like on a map change, one after the other, but
+        // without using the map cache. This measures how long decoding the
+        // maps takes in the background, and how long creating them holds up
+        // the main thread.
+        char **files = PHYSFS_enumerateFiles("maps");
+        for (char **i = files; *i; i++)
+        {
+            const std::string file = std::string("maps/") + *i;
+            if (file.find(".tmx") != std::string::npos)
+                mBenchmarkMaps.push_back(file);
+        }
+        PHYSFS_freeList(files);
+
+        mBenchmarkTimes.clear();
+        mBenchmarkParseTime = 0.0f;
+        mBenchmarkCreateTime = 0.0f;
+
+        tab->chatLog(strprintf(_("Loading %d maps, the results are shown "
+                                 "when done."), (int) mBenchmarkMaps.size()));
+    }
+    else
+    {
+        tab->chatLog(_("Unknown profile action."));
+    }
+}
+
+void CommandHandler::logic()
+{
+    if (mBenchmarkLoader)
+    {
+        if (!mBenchmarkLoader->update())
+            return;
+
+        const float parseTime = mBenchmarkLoader->getParseTime();
+        const float createTime = mBenchmarkLoader->getCreateTime();
+
+        if (Map *map = mBenchmarkLoader->takeMap())
+        {
+            mBenchmarkTimes.push_back(MapTime(createTime,
+                    strprintf(_("%s: %.1f ms reading, %.1f ms creating"),
+                              mBenchmarkMaps.back().c_str(),
+                              parseTime, createTime)));
+            mBenchmarkParseTime += parseTime;
+            mBenchmarkCreateTime += createTime;
+            delete map;
+        }
+
+        delete mBenchmarkLoader;
+        mBenchmarkLoader = 0;
+        mBenchmarkMaps.pop_back();
+
+        if (mBenchmarkMaps.empty())
+            finishMapBenchmark();
+    }
+
+    if (!mBenchmarkMaps.empty())
+        mBenchmarkLoader = new MapLoader(mBenchmarkMaps.back(), false);
+}
+
+void CommandHandler::finishMapBenchmark()
+{
+    std::sort(mBenchmarkTimes.begin(), mBenchmarkTimes.end(),
+              std::greater<MapTime>());
+
+    localChatTab->chatLog(strprintf(_("Loaded %d maps, %.1f ms reading in "
+                                      "the background, %.1f ms creating. "
+                                      "Slowest to create:"),
+                                    (int) mBenchmarkTimes.size(),
+                                    mBenchmarkParseTime,
+                                    mBenchmarkCreateTime));
+    for (unsigned i = 0; i < mBenchmarkTimes.size() && i < 5; i++)
+        localChatTab->chatLog(mBenchmarkTimes[i].second);
+
+    mBenchmarkTimes.clear();
+}
+
+void CommandHandler::handleTrace(const std::string &args, ChatTab *tab)
+{
+    if (args.empty() && Tracer::isEnabled())
+    {
+        Tracer::stop();
+        tab->chatLog(_("Trace stopped."));
+        return;
+    }
+
+    const std::string file = std::string(PHYSFS_getUserDir()) + "/.tmw/" +
+                             (args.empty() ? "trace.json" : args);
+
+    if (Tracer::start(file))
+        tab->chatLog(strprintf(_("Writing trace to %s."), file.c_str()));
+    else
+        tab->chatLog(strprintf(_("Could not write to %s."), file.c_str()));
+}
+
 void CommandHandler::handleIgnore(const std::string &args, ChatTab *tab)
 {
     if (args.empty())
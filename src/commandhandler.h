@@ -23,8 +23,11 @@
 #define COMMANDHANDLER_H
 
 #include <string>
+#include <utility>
+#include <vector>
 
 class ChatTab;
+class MapLoader;
 
 extern ChatTab *localChatTab;
 
@@ -45,13 +48,19 @@ class CommandHandler
         /**
          * Destructor
          */
-        ~CommandHandler() {}
+        ~CommandHandler();
 
         /**
          * Parse and handle the given command.
          */
         void handleCommand(const std::string &command, ChatTab *tab = localChatTab);
 
+        /**
+         * Continues the commands that take longer than a frame. To be called
+         * regularly.
+         */
+        void logic();
+
         static char parseBoolean(const std::string &value);
 
     protected:
@@ -128,6 +137,29 @@ class CommandHandler
          */
         void handlePresent(const std::string &args, ChatTab *tab);
 
+        /**
+         * Handle a profile command.
+         */
+        void handleProfile(const std::string &args, ChatTab *tab);
+
+        /**
+         * Handle a trace command.
+         */
+        void handleTrace(const std::string &args, ChatTab *tab);
+
+        /**
+         * Reports the results of the map benchmark started by /profile maps.
+         */
+        void finishMapBenchmark();
+
+        typedef std::pair<float, std::string> MapTime;
+
+        std::vector<std::string> mBenchmarkMaps;  /**< Maps left to load */
+        MapLoader *mBenchmarkLoader;              /**< The map being loaded */
+        std::vector<MapTime> mBenchmarkTimes;
+        float mBenchmarkParseTime;
+        float mBenchmarkCreateTime;
+
         /**
          * Handle an ignore command.
          */
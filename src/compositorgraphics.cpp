@@ -0,0 +1,517 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2004  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <guichan/sdl/sdlpixel.hpp>
+
+#include "compositorgraphics.h"
+#include "log.h"
+
+#include "resources/image.h"
+
+/**
+ * The maximum number of bands the screen can be divided in.
+ */
+static const int MAX_BANDS = 16;
+
+/**
+ * Intersects the given rectangles, returning false when they don't overlap.
+ */
+static bool intersect(const SDL_Rect &a, const SDL_Rect &b, SDL_Rect &result)
+{
+    const int x1 = std::max<int>(a.x, b.x);
+    const int y1 = std::max<int>(a.y, b.y);
+    const int x2 = std::min<int>(a.x + a.w, b.x + b.w);
+    const int y2 = std::min<int>(a.y + a.h, b.y + b.h);
+
+    if (x2 <= x1 || y2 <= y1)
+        return false;
+
+    result.x = x1;
+    result.y = y1;
+    result.w = x2 - x1;
+    result.h = y2 - y1;
+    return true;
+}
+
+/**
+ * Returns the per-surface alpha the given surface is blitted with.
+ */
+static Uint8 surfaceAlpha(const SDL_Surface *surface)
+{
+    if (surface->flags & SDL_SRCALPHA)
+        return surface->format->alpha;
+
+    return SDL_ALPHA_OPAQUE;
+}
+
+CompositorGraphics::CompositorGraphics(int bands):
+    mBandCount(std::max(1, std::min(bands, MAX_BANDS))),
+    mDone(SDL_CreateSemaphore(0)),
+    mQuit(false)
+{
+    mBands = new Band[mBandCount];
+
+    for (int i = 0; i < mBandCount; i++)
+    {
+        mBands[i].graphics = this;
+        mBands[i].thread = 0;
+        mBands[i].start = 0;
+        mBands[i].y = 0;
+        mBands[i].height = 0;
+
+        // The first band is drawn by the thread presenting the frame
+        if (i > 0)
+        {
+            mBands[i].start = SDL_CreateSemaphore(0);
+            mBands[i].thread = SDL_CreateThread(bandThread, &mBands[i]);
+        }
+    }
+
+    logger->log("Drawing the screen in %d bands", mBandCount);
+}
+
+CompositorGraphics::~CompositorGraphics()
+{
+    clearOps();
+
+    mQuit = true;
+    for (int i = 1; i < mBandCount; i++)
+    {
+        SDL_SemPost(mBands[i].start);
+        SDL_WaitThread(mBands[i].thread, NULL);
+        SDL_DestroySemaphore(mBands[i].start);
+    }
+
+    SDL_DestroySemaphore(mDone);
+
+    delete[] mBands;
+}
+
+bool CompositorGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool)
+{
+    clearOps();
+
+    return Graphics::setVideoMode(w, h, bpp, fs, false);
+}
+
+bool CompositorGraphics::blitSurface(SDL_Surface *surface,
+                                     SDL_Rect *srcRect, SDL_Rect *dstRect,
+                                     Image *image)
+{
+    DrawOp op;
+    op.type = DrawOp::BLIT;
+    op.surface = surface;
+
+    // Image::setAlpha changes the surface itself, and widgets set the alpha
+    // of shared images before each draw. The alpha is kept to be applied
+    // when the frame is drawn.
+    op.image = image;
+    op.alpha = image ? image->getAlpha() : 1.0f;
+    op.surfaceAlpha = surfaceAlpha(surface);
+
+    if (srcRect)
+        op.src = *srcRect;
+    else
+    {
+        op.src.x = 0;
+        op.src.y = 0;
+        op.src.w = surface->w;
+        op.src.h = surface->h;
+    }
+
+    op.dst = *dstRect;
+    op.clip = mScreen->clip_rect;
+
+    // Keep the surface alive until the frame has been drawn, since images
+    // may be freed before that
+    surface->refcount++;
+
+    mOps.push_back(op);
+    return true;
+}
+
+void CompositorGraphics::addFill(int x, int y, int w, int h)
+{
+    if (w <= 0 || h <= 0)
+        return;
+
+    DrawOp op;
+    op.type = DrawOp::FILL;
+    op.surface = 0;
+    op.image = 0;
+    op.dst.x = x;
+    op.dst.y = y;
+    op.dst.w = w;
+    op.dst.h = h;
+    op.clip = mScreen->clip_rect;
+    op.color = getColor();
+    op.pixel = SDL_MapRGB(mScreen->format,
+                          op.color.r, op.color.g, op.color.b);
+
+    mOps.push_back(op);
+}
+
+void CompositorGraphics::fillRectangle(const gcn::Rectangle &rectangle)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+
+    addFill(rectangle.x + top.xOffset, rectangle.y + top.yOffset,
+            rectangle.width, rectangle.height);
+}
+
+void CompositorGraphics::drawRectangle(const gcn::Rectangle &rectangle)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+    const int x = rectangle.x + top.xOffset;
+    const int y = rectangle.y + top.yOffset;
+    const int w = rectangle.width;
+    const int h = rectangle.height;
+
+    addFill(x, y, w, 1);
+    addFill(x, y + h - 1, w, 1);
+    addFill(x, y + 1, 1, h - 2);
+    addFill(x + w - 1, y + 1, 1, h - 2);
+}
+
+void CompositorGraphics::drawPoint(int x, int y)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+
+    addFill(x + top.xOffset, y + top.yOffset, 1, 1);
+}
+
+void CompositorGraphics::drawLine(int x1, int y1, int x2, int y2)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+
+    DrawOp op;
+    op.type = DrawOp::LINE;
+    op.surface = 0;
+    op.image = 0;
+    op.x1 = x1 + top.xOffset;
+    op.y1 = y1 + top.yOffset;
+    op.x2 = x2 + top.xOffset;
+    op.y2 = y2 + top.yOffset;
+    op.clip = mScreen->clip_rect;
+    op.color = getColor();
+
+    mOps.push_back(op);
+}
+
+void CompositorGraphics::updateScreen()
+{
+    flushOps();
+    Graphics::updateScreen();
+}
+
+SDL_Surface *CompositorGraphics::getScreenshot()
+{
+    flushOps();
+    return Graphics::getScreenshot();
+}
+
+void CompositorGraphics::forgetImage(const Image *image)
+{
+    Graphics::forgetImage(image);
+
+    for (std::vector<DrawOp>::iterator i = mOps.begin(); i != mOps.end(); ++i)
+    {
+        if (i->image == image)
+            resolveAlpha(*i);
+    }
+}
+
+void CompositorGraphics::resolveAlpha(DrawOp &op)
+{
+    Image *image = op.image;
+    if (!image)
+        return;
+
+    op.image = 0;
+
+    if (image->getAlpha() == op.alpha &&
+        surfaceAlpha(op.surface) == op.surfaceAlpha)
+        return;
+
+    // The translucent copies of an image are never changed
+    SDL_Surface *surface = image->SDLgetAlphaSurface(op.alpha);
+    if (!surface)
+        return;
+
+    surface->refcount++;
+    SDL_FreeSurface(op.surface);
+    op.surface = surface;
+}
+
+void CompositorGraphics::flushOps()
+{
+    if (mOps.empty())
+        return;
+
+    // SDL maps a surface to its destination format on the first blit, which
+    // isn't safe to do from several threads at once. An empty blit does
+    // only the mapping. Copies at another alpha are made here as well.
+    SDL_Surface *lastSurface = 0;
+    for (std::vector<DrawOp>::iterator i = mOps.begin(); i != mOps.end(); ++i)
+    {
+        if (i->type != DrawOp::BLIT)
+            continue;
+
+        resolveAlpha(*i);
+
+        if (i->surface == lastSurface)
+            continue;
+
+        SDL_Rect empty;
+        empty.x = empty.y = 0;
+        empty.w = empty.h = 0;
+        SDL_Rect emptyDst = empty;
+        SDL_LowerBlit(i->surface, &empty, mScreen, &emptyDst);
+        lastSurface = i->surface;
+    }
+
+    // Surfaces that need locking can't be drawn to from several threads
+    const bool mustLock = SDL_MUSTLOCK(mScreen);
+    const int bands = mustLock ? 1 : mBandCount;
+
+    if (mustLock)
+        SDL_LockSurface(mScreen);
+
+    for (int i = 0; i < bands; i++)
+    {
+        mBands[i].y = mScreen->h * i / bands;
+        mBands[i].height = mScreen->h * (i + 1) / bands - mBands[i].y;
+    }
+
+    for (int i = 1; i < bands; i++)
+        SDL_SemPost(mBands[i].start);
+
+    rasterize(mBands[0]);
+
+    for (int i = 1; i < bands; i++)
+        SDL_SemWait(mDone);
+
+    if (mustLock)
+        SDL_UnlockSurface(mScreen);
+
+    clearOps();
+}
+
+void CompositorGraphics::clearOps()
+{
+    for (std::vector<DrawOp>::iterator i = mOps.begin(); i != mOps.end(); ++i)
+    {
+        if (i->surface)
+            SDL_FreeSurface(i->surface);
+    }
+
+    mOps.clear();
+}
+
+void CompositorGraphics::rasterize(const Band &band)
+{
+    SDL_Rect bandRect;
+    bandRect.x = 0;
+    bandRect.y = band.y;
+    bandRect.w = mScreen->w;
+    bandRect.h = band.height;
+
+    for (std::vector<DrawOp>::const_iterator i = mOps.begin();
+         i != mOps.end(); ++i)
+    {
+        SDL_Rect clip;
+        if (!intersect(i->clip, bandRect, clip))
+            continue;
+
+        switch (i->type)
+        {
+            case DrawOp::BLIT:
+                rasterizeBlit(*i, clip);
+                break;
+            case DrawOp::FILL:
+                rasterizeFill(*i, clip);
+                break;
+            case DrawOp::LINE:
+                rasterizeLine(*i, clip);
+                break;
+        }
+    }
+}
+
+void CompositorGraphics::rasterizeBlit(const DrawOp &op, const SDL_Rect &clip)
+{
+    const SDL_Surface *surface = op.surface;
+    int srcX = op.src.x;
+    int srcY = op.src.y;
+    int dstX = op.dst.x;
+    int dstY = op.dst.y;
+    int w = op.src.w;
+    int h = op.src.h;
+
+    // Clip to the source surface, like SDL_BlitSurface does
+    if (srcX < 0)
+    {
+        w += srcX;
+        dstX -= srcX;
+        srcX = 0;
+    }
+    if (srcY < 0)
+    {
+        h += srcY;
+        dstY -= srcY;
+        srcY = 0;
+    }
+    w = std::min(w, surface->w - srcX);
+    h = std::min(h, surface->h - srcY);
+
+    // Clip to the band and the clip area
+    if (dstX < clip.x)
+    {
+        w -= clip.x - dstX;
+        srcX += clip.x - dstX;
+        dstX = clip.x;
+    }
+    if (dstY < clip.y)
+    {
+        h -= clip.y - dstY;
+        srcY += clip.y - dstY;
+        dstY = clip.y;
+    }
+    w = std::min(w, clip.x + clip.w - dstX);
+    h = std::min(h, clip.y + clip.h - dstY);
+
+    if (w <= 0 || h <= 0)
+        return;
+
+    SDL_Rect srcRect;
+    SDL_Rect dstRect;
+    srcRect.x = srcX; srcRect.y = srcY;
+    srcRect.w = w;    srcRect.h = h;
+    dstRect.x = dstX; dstRect.y = dstY;
+    dstRect.w = w;    dstRect.h = h;
+
+    // The lower blit does no clipping and doesn't touch the clip rectangle
+    // of the screen, so bands can be blitted at the same time
+    SDL_LowerBlit(op.surface, &srcRect, mScreen, &dstRect);
+}
+
+void CompositorGraphics::rasterizeFill(const DrawOp &op, const SDL_Rect &clip)
+{
+    SDL_Rect area;
+    if (!intersect(op.dst, clip, area))
+        return;
+
+    const int x2 = area.x + area.w;
+    const int y2 = area.y + area.h;
+
+    if (op.color.a != 255)
+    {
+        for (int y = area.y; y < y2; y++)
+            for (int x = area.x; x < x2; x++)
+                gcn::SDLputPixelAlpha(mScreen, x, y, op.color);
+        return;
+    }
+
+    if (mScreen->format->BytesPerPixel == 4)
+    {
+        for (int y = area.y; y < y2; y++)
+        {
+            Uint32 *row = (Uint32*) ((Uint8*) mScreen->pixels +
+                                     y * mScreen->pitch) + area.x;
+            std::fill_n(row, area.w, op.pixel);
+        }
+    }
+    else if (mScreen->format->BytesPerPixel == 2)
+    {
+        for (int y = area.y; y < y2; y++)
+        {
+            Uint16 *row = (Uint16*) ((Uint8*) mScreen->pixels +
+                                     y * mScreen->pitch) + area.x;
+            std::fill_n(row, area.w, (Uint16) op.pixel);
+        }
+    }
+    else
+    {
+        for (int y = area.y; y < y2; y++)
+            for (int x = area.x; x < x2; x++)
+                gcn::SDLputPixel(mScreen, x, y, op.color);
+    }
+}
+
+void CompositorGraphics::rasterizeLine(const DrawOp &op, const SDL_Rect &clip)
+{
+    int x = op.x1;
+    int y = op.y1;
+    const int dx = std::abs(op.x2 - op.x1);
+    const int dy = std::abs(op.y2 - op.y1);
+    const int stepX = op.x1 < op.x2 ? 1 : -1;
+    const int stepY = op.y1 < op.y2 ? 1 : -1;
+    int error = dx - dy;
+
+    for (;;)
+    {
+        if (x >= clip.x && x < clip.x + clip.w &&
+            y >= clip.y && y < clip.y + clip.h)
+        {
+            if (op.color.a != 255)
+                gcn::SDLputPixelAlpha(mScreen, x, y, op.color);
+            else
+                gcn::SDLputPixel(mScreen, x, y, op.color);
+        }
+
+        if (x == op.x2 && y == op.y2)
+            break;
+
+        const int error2 = error * 2;
+        if (error2 > -dy)
+        {
+            error -= dy;
+            x += stepX;
+        }
+        if (error2 < dx)
+        {
+            error += dx;
+            y += stepY;
+        }
+    }
+}
+
+int CompositorGraphics::bandThread(void *data)
+{
+    Band *band = static_cast<Band*>(data);
+    CompositorGraphics *graphics = band->graphics;
+
+    for (;;)
+    {
+        SDL_SemWait(band->start);
+
+        if (graphics->mQuit)
+            break;
+
+        graphics->rasterize(*band);
+        SDL_SemPost(graphics->mDone);
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2004  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef COMPOSITORGRAPHICS_H
+#define COMPOSITORGRAPHICS_H
+
+#include <guichan/color.hpp>
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include <vector>
+
+#include "graphics.h"
+
+/**
+ * A software graphics context that records everything drawn during a frame,
+ * and rasterizes it in horizontal bands of the screen on a pool of threads
+ * before presenting the frame.
+ */
+class CompositorGraphics : public Graphics
+{
+    public:
+        /**
+         * Constructor, taking the number of bands the screen is divided in.
+         * One thread is started for each band except the first, which is
+         * drawn by the calling thread.
+         */
+        CompositorGraphics(int bands);
+
+        ~CompositorGraphics();
+
+        /**
+         * Sets the video mode. Hardware surfaces are never used, since the
+         * bands are drawn straight into the screen pixels.
+         */
+        bool setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel);
+
+        void fillRectangle(const gcn::Rectangle &rectangle);
+
+        void drawRectangle(const gcn::Rectangle &rectangle);
+
+        void drawPoint(int x, int y);
+
+        void drawLine(int x1, int y1, int x2, int y2);
+
+        /**
+         * Rasterizes the recorded frame and presents it.
+         */
+        void updateScreen();
+
+        SDL_Surface *getScreenshot();
+
+    protected:
+        /**
+         * Records a blit of the given surface, along with the alpha of the
+         * image it belongs to.
+         */
+        bool blitSurface(SDL_Surface *surface,
+                         SDL_Rect *srcRect, SDL_Rect *dstRect,
+                         Image *image = NULL);
+
+        /**
+         * Settles the alpha of the recorded blits of the given image, since
+         * it can't be looked at once unloaded.
+         */
+        void forgetImage(const Image *image);
+
+    private:
+        /**
+         * A single recorded drawing operation, in screen coordinates.
+         */
+        struct DrawOp
+        {
+            enum Type
+            {
+                BLIT,
+                FILL,
+                LINE
+            };
+
+            Type type;
+            SDL_Surface *surface;   /**< Source of a blit, referenced */
+            SDL_Rect src;           /**< Source area of a blit */
+            SDL_Rect dst;           /**< Blit destination or filled area */
+            int x1, y1, x2, y2;     /**< End points of a line */
+            SDL_Rect clip;          /**< Clip area when recorded */
+            Image *image;           /**< Image whose alpha may change */
+            float alpha;            /**< Alpha of the image when recorded */
+            Uint8 surfaceAlpha;     /**< Alpha of the surface when recorded */
+            gcn::Color color;
+            Uint32 pixel;           /**< The color in the screen format */
+        };
+
+        /**
+         * A band of the screen and the thread that draws it.
+         */
+        struct Band
+        {
+            CompositorGraphics *graphics;
+            SDL_Thread *thread;
+            SDL_sem *start;
+            int y, height;
+        };
+
+        /**
+         * Records filling the given area, in screen coordinates.
+         */
+        void addFill(int x, int y, int w, int h);
+
+        /**
+         * Makes the given blit use a surface at the alpha its image had when
+         * it was recorded, in case the alpha was changed since.
+         */
+        void resolveAlpha(DrawOp &op);
+
+        /**
+         * Rasterizes the recorded operations and forgets about them.
+         */
+        void flushOps();
+
+        /**
+         * Forgets about the recorded operations without drawing them.
+         */
+        void clearOps();
+
+        /**
+         * Draws the recorded operations within the given band.
+         */
+        void rasterize(const Band &band);
+
+        void rasterizeBlit(const DrawOp &op, const SDL_Rect &clip);
+        void rasterizeFill(const DrawOp &op, const SDL_Rect &clip);
+        void rasterizeLine(const DrawOp &op, const SDL_Rect &clip);
+
+        static int bandThread(void *data);
+
+        std::vector<DrawOp> mOps;
+
+        int mBandCount;
+        Band *mBands;
+        SDL_sem *mDone;
+        bool mQuit;
+};
+
+#endif
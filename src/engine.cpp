@@ -27,6 +27,7 @@
 #include "log.h"
 #include "map.h"
 #include "particle.h"
+#include "profiler.h"
 #include "sound.h"
 
 #include "gui/gui.h"
@@ -37,7 +38,7 @@
 #include "net/gamehandler.h"
 #include "net/net.h"
 
-#include "resources/mapreader.h"
+#include "resources/maploader.h"
 #include "resources/monsterdb.h"
 #include "resources/resourcemanager.h"
 
@@ -47,12 +48,14 @@
 #include <assert.h>
 
 Engine::Engine():
-    mCurrentMap(0)
+    mCurrentMap(0),
+    mMapLoader(0)
 {
 }
 
 Engine::~Engine()
 {
+    delete mMapLoader;
     delete mCurrentMap;
 }
 
@@ -73,6 +76,15 @@ bool Engine::changeMap(const std::string &mapPath)
 
     particleEngine->clear();
 
+    // Let go of the current map while the new one is loading
+    minimap->setMap(0);
+    beingManager->setMap(0);
+    particleEngine->setMap(0);
+    viewport->setMap(0);
+
+    delete mCurrentMap;
+    mCurrentMap = 0;
+
     mMapName = mapPath;
 
     // Store full map path in global var
@@ -81,8 +93,21 @@ bool Engine::changeMap(const std::string &mapPath)
     if (!resman->exists(map_path))
         map_path += ".gz";
 
-    // Attempt to load the new map
-    Map *newMap = MapReader::readMap(map_path);
+    // Attempt to load the new map, cancelling any map still being loaded
+    delete mMapLoader;
+    mMapLoader = new MapLoader(map_path);
+    viewport->setLoadingProgress(0.0f);
+
+    return true;
+}
+
+void Engine::finishMapChange()
+{
+    Map *newMap = mMapLoader->takeMap();
+    delete mMapLoader;
+    mMapLoader = 0;
+
+    viewport->setLoadingProgress(-1.0f);
 
     if (!newMap)
     {
@@ -94,6 +119,7 @@ bool Engine::changeMap(const std::string &mapPath)
     // Notify the minimap and beingManager about the map change
     minimap->setMap(newMap);
     beingManager->setMap(newMap);
+    floorItemManager->setMap(newMap);
     particleEngine->setMap(newMap);
     viewport->setMap(newMap);
 
@@ -102,21 +128,38 @@ bool Engine::changeMap(const std::string &mapPath)
         newMap->initializeParticleEffects(particleEngine);
 
     // Start playing new music file when necessary
-    std::string oldMusic = mCurrentMap ? mCurrentMap->getMusicFile() : "";
-    std::string newMusic = newMap ? newMap->getMusicFile() : "";
-    if (newMusic != oldMusic)
+    const std::string newMusic = newMap ? newMap->getMusicFile() : "";
+    if (newMusic != mMusicFile)
+    {
         sound.playMusic(newMusic);
+        mMusicFile = newMusic;
+    }
 
-    delete mCurrentMap;
     mCurrentMap = newMap;
 
-    Net::getGameHandler()->mapLoaded(mapPath);
-    return true;
+    Net::getGameHandler()->mapLoaded(mMapName);
 }
 
 void Engine::logic()
 {
-    beingManager->logic();
-    particleEngine->update();
-    gui->logic();
+    if (mMapLoader)
+    {
+        if (mMapLoader->update())
+            finishMapChange();
+        else
+            viewport->setLoadingProgress(mMapLoader->getProgress());
+    }
+
+    {
+        ProfileScope scope(Profiler::BEINGS);
+        beingManager->logic();
+    }
+    {
+        ProfileScope scope(Profiler::PARTICLES);
+        particleEngine->update();
+    }
+    {
+        ProfileScope scope(Profiler::GUI);
+        gui->logic();
+    }
 }
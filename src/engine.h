@@ -25,6 +25,7 @@
 #include <string>
 
 class Map;
+class MapLoader;
 
 /**
  * Game engine. Actually hardly does anything anymore except keeping track of
@@ -45,18 +46,31 @@ class Engine
         const std::string &getCurrentMapName() { return mMapName; }
 
         /**
-         * Sets the currently active map.
+         * Starts changing the currently active map. The new map is loaded
+         * in the background, there is no current map until it is done.
          */
         bool changeMap(const std::string &mapName);
 
+        /**
+         * Returns whether a map is being loaded.
+         */
+        bool isLoadingMap() const { return mMapLoader != 0; }
+
         /**
          * Performs engine logic. This method is called 100 times per second.
          */
         void logic();
 
     private:
+        /**
+         * Makes the map that finished loading the current one.
+         */
+        void finishMapChange();
+
         Map *mCurrentMap;
+        MapLoader *mMapLoader;
         std::string mMapName;
+        std::string mMusicFile;     /**< The music of the current map. */
 };
 
 extern Engine *engine;
@@ -19,8 +19,11 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <guichan/rectangle.hpp>
+
 #include "flooritem.h"
 
+#include "game.h"
 #include "graphics.h"
 #include "item.h"
 #include "map.h"
@@ -42,17 +45,42 @@ FloorItem::FloorItem(int id,
     mItem = new Item(itemId);
 
     // Add ourselves to the map
-    mMapSprite = mMap->addSprite(this);
+    if (mMap)
+    {
+        mMapSprite = mMap->addSprite(this);
+        requestMapRedraw(this);
+    }
 }
 
 FloorItem::~FloorItem()
 {
     // Remove ourselves from the map
-    mMap->removeSprite(mMapSprite);
+    if (mMap)
+    {
+        requestMapRedraw(this);
+        mMap->removeSprite(mMapSprite);
+    }
 
     delete mItem;
 }
 
+void FloorItem::setMap(Map *map)
+{
+    if (mMap)
+    {
+        requestMapRedraw(this);
+        mMap->removeSprite(mMapSprite);
+    }
+
+    mMap = map;
+
+    if (mMap)
+    {
+        mMapSprite = mMap->addSprite(this);
+        requestMapRedraw(this);
+    }
+}
+
 int FloorItem::getItemId() const
 {
     return mItem->getId();
@@ -63,15 +91,24 @@ Item *FloorItem::getItem() const
     return mItem;
 }
 
+bool FloorItem::getBounds(gcn::Rectangle &bounds) const
+{
+    if (!mItem)
+        return false;
+
+    Image *image = mItem->getImage();
+    bounds = gcn::Rectangle(mX * 32, mY * 32,
+                            image->getWidth(), image->getHeight());
+    return true;
+}
+
 void FloorItem::draw(Graphics *graphics, int offsetX, int offsetY) const
 {
     if (mItem)
     {
-        if (mAlpha != mItem->getImage()->getAlpha())
-            mItem->getImage()->setAlpha(mAlpha);
-
         graphics->drawImage(mItem->getImage(),
                             mX * 32 + offsetX,
-                            mY * 32 + offsetY);
+                            mY * 32 + offsetY,
+                            mAlpha);
     }
 }
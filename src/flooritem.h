@@ -44,7 +44,7 @@ class FloorItem : public Sprite
          * @param itemId the item ID
          * @param x      the x position in tiles
          * @param y      the y position in tiles
-         * @param map    the map this item is on
+         * @param map    the map this item is on, may be <code>NULL</code>
          */
         FloorItem(int id,
                   int itemId,
@@ -54,6 +54,12 @@ class FloorItem : public Sprite
 
         ~FloorItem();
 
+        /**
+         * Moves the item to another map. Used for items that arrived while
+         * the map was still loading.
+         */
+        void setMap(Map *map);
+
         /**
          * Returns instance ID of this item.
          */
@@ -106,6 +112,11 @@ class FloorItem : public Sprite
         virtual float getAlpha() const
         { return mAlpha; }
 
+        /**
+         * @see Sprite::getBounds()
+         */
+        bool getBounds(gcn::Rectangle &bounds) const;
+
         /** We consider flooritems (at least for now) to be one layer-sprites */
         virtual int getNumberOfLayers() const
         { return 1; }
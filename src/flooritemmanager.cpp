@@ -49,6 +49,12 @@ void FloorItemManager::clear()
     mFloorItems.clear();
 }
 
+void FloorItemManager::setMap(Map *map)
+{
+    for (FloorItemIterator i = mFloorItems.begin(); i != mFloorItems.end(); i++)
+        (*i)->setMap(map);
+}
+
 FloorItem *FloorItemManager::findById(int id)
 {
     FloorItemIterator i;
@@ -38,6 +38,11 @@ class FloorItemManager
 
         void clear();
 
+        /**
+         * Moves all items to the given map.
+         */
+        void setMap(Map *map);
+
         FloorItem* findById(int id);
         FloorItem* findByCoordinates(int x, int y);
 
@@ -39,6 +39,7 @@
 #include "npc.h"
 #include "particle.h"
 #include "playerrelations.h"
+#include "profiler.h"
 #include "sound.h"
 
 #include "gui/widgets/chattab.h"
@@ -85,12 +86,16 @@
 #include "net/ea/inventoryhandler.h"
 
 #include "resources/imagewriter.h"
+#include "resources/resourcemanager.h"
 
+#include "utils/clock.h"
 #include "utils/gettext.h"
 
 #include <guichan/exception.hpp>
 #include <guichan/focushandler.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <physfs.h>
 #include <sstream>
@@ -157,6 +162,68 @@ const int MAX_TICK_VALUE = 10000;
  */
 const int MILLISECONDS_IN_A_TICK = 10;
 
+/**
+ * The duration of a logic step in microseconds.
+ */
+static const Uint64 TICK_DURATION = MILLISECONDS_IN_A_TICK * 1000;
+
+/**
+ * The maximum time in microseconds the logic catches up on after a stall.
+ */
+static const Uint64 MAX_STEP_BACKLOG = 250 * 1000;
+
+FrameTiming frameTiming = { 0.0f, 0.0f, 0.0f };
+
+/**
+ * Whether something visible changed since the last frame was drawn.
+ */
+static bool redrawRequested = true;
+
+namespace {
+    /**
+     * Collects the time between frames, to publish the frame timing once
+     * every second.
+     */
+    struct FrameStats
+    {
+        FrameStats(): lastFrame(0), periodStart(0), frames(0),
+                      sum(0.0), sumSquares(0.0), maximum(0.0) {}
+
+        void add(Uint64 time)
+        {
+            if (!lastFrame)
+            {
+                lastFrame = periodStart = time;
+                return;
+            }
+
+            const double interval = (time - lastFrame) / 1000.0;
+            lastFrame = time;
+            frames++;
+            sum += interval;
+            sumSquares += interval * interval;
+            maximum = std::max(maximum, interval);
+
+            if (time - periodStart < 1000000)
+                return;
+
+            const double average = sum / frames;
+            const double variance = sumSquares / frames - average * average;
+            frameTiming.average = (float) average;
+            frameTiming.maximum = (float) maximum;
+            frameTiming.deviation = (float) std::sqrt(std::max(variance, 0.0));
+
+            periodStart = time;
+            frames = 0;
+            sum = sumSquares = maximum = 0.0;
+        }
+
+        Uint64 lastFrame, periodStart;
+        int frames;
+        double sum, sumSquares, maximum;
+    } frameStats;
+}
+
 /**
  * Listener used for exiting handling.
  */
@@ -174,18 +241,6 @@ namespace {
     } exitListener;
 }
 
-/**
- * Advances game logic counter.
- * Called every 10 milliseconds by SDL_AddTimer()
- * @see MILLISECONDS_IN_A_TICK value
- */
-Uint32 nextTick(Uint32 interval, void *param)
-{
-    tick_time++;
-    if (tick_time == MAX_TICK_VALUE) tick_time = 0;
-    return interval;
-}
-
 /**
  * Updates fps.
  * Called every seconds by SDL_AddTimer()
@@ -198,6 +253,44 @@ Uint32 nextSecond(Uint32 interval, void *param)
     return interval;
 }
 
+void requestRedraw()
+{
+    redrawRequested = true;
+
+    if (graphics)
+        graphics->setAllDirty();
+}
+
+void requestRedraw(const gcn::Rectangle &area)
+{
+    redrawRequested = true;
+
+    if (graphics)
+        graphics->addDirtyArea(area);
+}
+
+void requestMapRedraw(const gcn::Rectangle &area)
+{
+    if (!viewport)
+    {
+        requestRedraw();
+        return;
+    }
+
+    requestRedraw(gcn::Rectangle(area.x - viewport->getCameraX(),
+                                 area.y - viewport->getCameraY(),
+                                 area.width, area.height));
+}
+
+void requestMapRedraw(const Sprite *sprite)
+{
+    gcn::Rectangle bounds;
+    if (sprite->getBounds(bounds))
+        requestMapRedraw(bounds);
+    else
+        requestRedraw();
+}
+
 /**
  * @return the elapsed time in milliseconds
  * between two tick values.
@@ -296,8 +389,9 @@ static void destroyGuiWindows()
 }
 
 Game::Game():
+    mNextFrame(0),
     mLastTarget(Being::UNKNOWN),
-    mLogicCounterId(0), mSecondsCounterId(0)
+    mSecondsCounterId(0)
 {
     done = false;
 
@@ -319,11 +413,13 @@ Game::Game():
 
     // Initialize logic and seconds counters
     tick_time = 0;
-    mLogicCounterId = SDL_AddTimer(MILLISECONDS_IN_A_TICK, nextTick, NULL);
+    frameStats = FrameStats();
     mSecondsCounterId = SDL_AddTimer(1000, nextSecond, NULL);
 
     // Initialize frame limiting
     config.addListener("fpslimit", this);
+    config.addListener("idleframeskip", this);
+    config.addListener("idlefps", this);
     optionChanged("fpslimit");
 
     // Initialize beings
@@ -378,7 +474,6 @@ Game::~Game()
     floorItemManager = NULL;
     joystick = NULL;
 
-    SDL_RemoveTimer(mLogicCounterId);
     SDL_RemoveTimer(mSecondsCounterId);
 }
 
@@ -435,65 +530,118 @@ void Game::optionChanged(const std::string &name)
 {
     int fpsLimit = (int) config.getValue("fpslimit", 60);
 
-    mMinFrameTime = fpsLimit ? 1000 / fpsLimit : 0;
+    mMinFrameTime = fpsLimit ? 1000000 / fpsLimit : 0;
+
+    // While idle, frames are only drawn at the keepalive rate
+    const int idleFps = (int) config.getValue("idlefps", 5);
+    mIdleFrameTime = config.getValue("idleframeskip", 0) && idleFps > 0 ?
+                     1000000 / idleFps : 0;
 
     // Reset draw time to current time
-    mDrawTime = tick_time * MILLISECONDS_IN_A_TICK;
+    mNextFrame = mNextIdleFrame = getMicroseconds();
+    requestRedraw();
 }
 
 void Game::logic()
 {
-    // mDrawTime has a higher granularity than gameTime in order to be able to
-    // work with minimum frame durations in milliseconds.
-    int gameTime = tick_time;
-    mDrawTime = tick_time * MILLISECONDS_IN_A_TICK;
+    // The game logic advances in fixed steps of MILLISECONDS_IN_A_TICK,
+    // independent of how often frames are drawn.
+    Uint64 lastTime = getMicroseconds();
+    Uint64 accumulator = 0;
+    mNextFrame = lastTime;
+    Profiler::reset();
 
     while (!done)
     {
-        if (Map *map = engine->getCurrentMap())
-            map->update(get_elapsed_time(gameTime));
+        const Uint64 now = getMicroseconds();
+
+        // Don't try to catch up on everything after a long stall
+        accumulator += std::min(now - lastTime, MAX_STEP_BACKLOG);
+        lastTime = now;
 
         // Handle all necessary game logic
-        while (get_elapsed_time(gameTime) > 0)
+        int steps = 0;
+        while (accumulator >= TICK_DURATION)
         {
+            accumulator -= TICK_DURATION;
+
+            TraceScope trace("logic");
+
+            tick_time++;
+            if (tick_time == MAX_TICK_VALUE)
+                tick_time = 0;
+
             handleInput();
             engine->logic();
-            gameTime++;
+            steps++;
         }
 
-        // This is done because at some point tick_time will wrap.
-        gameTime = tick_time;
+        // Turn what was loaded in the background into resources
+        ResourceManager::getInstance()->processAsyncLoads();
+
+        // Continue the commands that take more than a frame
+        commandHandler->logic();
+
+        if (steps > 0)
+        {
+            if (Map *map = engine->getCurrentMap())
+                map->update(steps * MILLISECONDS_IN_A_TICK);
+        }
 
         // Update the screen when application is active, delay otherwise.
         if (SDL_GetAppState() & SDL_APPACTIVE)
         {
-            // Draw a frame if either frames are not limited or enough time has
-            // passed since the last frame.
-            if (!mMinFrameTime ||
-                get_elapsed_time(mDrawTime / 10) > mMinFrameTime)
+            // When idle frame skipping is enabled, frames are only drawn when
+            // something visible changed or when the keepalive frame is due.
+            const bool idle = mIdleFrameTime && !redrawRequested &&
+                              now < mNextIdleFrame;
+
+            // Draw a frame if either frames are not limited or the time for
+            // the next frame has come.
+            if (!idle && (!mMinFrameTime || now >= mNextFrame))
             {
+                redrawRequested = false;
+
+                TraceScope trace("frame");
                 frame++;
-                gui->draw();
-                graphics->updateScreen();
-                mDrawTime += mMinFrameTime;
+                {
+                    ProfileScope scope(Profiler::GUI);
+                    gui->draw();
+                }
+                {
+                    ProfileScope scope(Profiler::SCREEN);
+                    graphics->updateScreen();
+                }
+                frameStats.add(getMicroseconds());
+                Profiler::endFrame();
 
-                // Make sure to wrap mDrawTime, since tick_time will wrap.
-                if (mDrawTime > MAX_TICK_VALUE * MILLISECONDS_IN_A_TICK)
-                    mDrawTime -= MAX_TICK_VALUE * MILLISECONDS_IN_A_TICK;
-            }
-            else
-            {
-                SDL_Delay(MILLISECONDS_IN_A_TICK);
+                // Don't try to catch up on frames that were missed
+                mNextFrame = std::max(mNextFrame + mMinFrameTime, now);
+                mNextIdleFrame = now + mIdleFrameTime;
             }
+
+            // Sleep until the next frame or logic step is due. While idle,
+            // only drawing is skipped: the loop still wakes up every logic
+            // step to handle input and to flush and dispatch the network.
+            const Uint64 nextStep = lastTime + TICK_DURATION - accumulator;
+            ProfileScope scope(Profiler::IDLE);
+            if (idle)
+                sleepUntil(std::min(mNextIdleFrame, nextStep));
+            else if (mMinFrameTime)
+                sleepUntil(std::min(mNextFrame, nextStep));
         }
         else
         {
+            ProfileScope scope(Profiler::IDLE);
             SDL_Delay(MILLISECONDS_IN_A_TICK);
-            mDrawTime = tick_time * MILLISECONDS_IN_A_TICK;
+            mNextFrame = getMicroseconds();
         }
 
         // Handle network stuff
-        Net::getGeneralHandler()->flushNetwork();
+        {
+            ProfileScope scope(Profiler::NETWORK);
+            Net::getGeneralHandler()->flushNetwork();
+        }
         if (!Net::getGameHandler()->isConnected())
         {
             if (state != STATE_ERROR)
@@ -523,6 +671,9 @@ void Game::handleInput()
     {
         bool used = false;
 
+        // Any input may change what the GUI shows
+        requestRedraw();
+
         // Keyboard events (for discontinuous keys)
         if (event.type == SDL_KEYDOWN)
         {
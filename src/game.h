@@ -25,12 +25,27 @@
 #include "SDL.h"
 
 #include "configlistener.h"
+#include "guichanfwd.h"
+
+class Sprite;
 
 extern std::string map_path;
 extern volatile int fps;
 extern volatile int tick_time;
 extern const int MILLISECONDS_IN_A_TICK;
 
+/**
+ * Timing of the frames drawn during the last second, in milliseconds.
+ */
+struct FrameTiming
+{
+    float average;      /**< Average time between frames */
+    float maximum;      /**< Longest time between frames */
+    float deviation;    /**< Standard deviation of the time between frames */
+};
+
+extern FrameTiming frameTiming;
+
 class WindowMenu;
 
 class Game : public ConfigListener
@@ -47,20 +62,51 @@ class Game : public ConfigListener
         void optionChanged(const std::string &name);
 
     private:
-        /** Used to determine whether to draw the next frame. */
-        int mDrawTime;
+        /** The time the next frame is due, in microseconds. */
+        Uint64 mNextFrame;
+
+        /** The minimum frame time in microseconds (for frame limiting). */
+        Uint64 mMinFrameTime;
+
+        /**
+         * The time between frames drawn while nothing visible changes, in
+         * microseconds. 0 when every frame is drawn.
+         */
+        Uint64 mIdleFrameTime;
 
-        /** The minimum frame time (used for frame limiting). */
-        int mMinFrameTime;
+        /** The time the next frame is due while idle, in microseconds. */
+        Uint64 mNextIdleFrame;
 
         int mLastTarget;
 
-        SDL_TimerID mLogicCounterId;
         SDL_TimerID mSecondsCounterId;
 
         WindowMenu *mWindowMenu;
 };
 
+/**
+ * Tells that something visible changed, so that the next frame is drawn even
+ * when frames are only drawn on changes. The whole screen is drawn again.
+ */
+void requestRedraw();
+
+/**
+ * Tells that the given area of the screen changed. When only the changed
+ * parts of the screen are drawn, only this area is drawn again.
+ */
+void requestRedraw(const gcn::Rectangle &area);
+
+/**
+ * Tells that the given area of the map changed, in map pixel coordinates.
+ */
+void requestMapRedraw(const gcn::Rectangle &area);
+
+/**
+ * Tells that the area covered by the given map sprite changed. The whole
+ * screen is drawn again when the sprite doesn't know its bounds.
+ */
+void requestMapRedraw(const Sprite *sprite);
+
 /**
  * Returns elapsed time. (Warning: supposes the delay is always < 100 seconds)
  */
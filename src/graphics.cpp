@@ -19,22 +19,109 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 #include "graphics.h"
 #include "log.h"
 
+#include <SDL_thread.h>
+
 #include "resources/image.h"
 #include "resources/imageloader.h"
 
+/**
+ * Size of the blocks the screen is divided in to check for unreported changes.
+ */
+static const int DIRTY_BLOCK_SIZE = 32;
+
+/**
+ * Percentage of the screen that may change before it is drawn entirely.
+ */
+static const int DIRTY_FULL_UPDATE = 60;
+
+/**
+ * Maximum number of separate changed areas copied to the screen. More areas
+ * are merged into one.
+ */
+static const unsigned int MAX_DIRTY_AREAS = 16;
+
+/**
+ * Maximum number of image rectangle sizes remembered.
+ */
+static const unsigned int MAX_CACHED_FRAMES = 64;
+
+/**
+ * Maximum number of pixels in composed image rectangles.
+ */
+static const int MAX_CACHED_FRAME_PIXELS = 2 * 1024 * 1024;
+
+/**
+ * Blends the given image repeatedly onto the given area of the target.
+ */
+static void blendPattern(Image *image, SDL_Surface *target,
+                         int x, int y, int w, int h)
+{
+    const int iw = image->getWidth();
+    const int ih = image->getHeight();
+
+    if (iw == 0 || ih == 0) return;
+
+    for (int py = 0; py < h; py += ih)
+    {
+        const int dh = (py + ih >= h) ? h - py : ih;
+
+        for (int px = 0; px < w; px += iw)
+        {
+            const int dw = (px + iw >= w) ? w - px : iw;
+            image->SDLblendOnto(target, x + px, y + py, dw, dh);
+        }
+    }
+}
+
+bool Graphics::FrameKey::operator<(const FrameKey &other) const
+{
+    for (int i = 0; i < 9; i++)
+    {
+        if (grid[i] != other.grid[i])
+            return grid[i] < other.grid[i];
+    }
+    if (width != other.width)
+        return width < other.width;
+    if (height != other.height)
+        return height < other.height;
+    return alpha < other.alpha;
+}
+
+std::list<Graphics*> Graphics::mInstances;
+Uint32 Graphics::mMainThread = 0;
+
 Graphics::Graphics():
-    mScreen(0)
+    mScreen(0),
+    mDirtyRects(false),
+    mCheckDirtyRects(false),
+    mAllDirty(true),
+    mDrawAll(true),
+    mLastFrame(0),
+    mFrameCacheUses(0),
+    mFrameCacheFrameStart(0),
+    mFrameCachePixels(0)
 {
+    if (mInstances.empty())
+        mMainThread = SDL_ThreadID();
+
+    mInstances.push_back(this);
 }
 
 Graphics::~Graphics()
 {
     _endDraw();
+    delete[] mLastFrame;
+
+    mInstances.remove(this);
+
+    clearFrameCache();
 }
 
 bool Graphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
@@ -46,9 +133,18 @@ bool Graphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
 
     int displayFlags = SDL_ANYFORMAT;
 
+    // Scaled and composed images are in the display format of the old mode
+    Image::SDLclearScaledImageCache();
+    clearFrameCache();
+
     mFullscreen = fs;
     mHWAccel = hwaccel;
 
+    // The last frame doesn't match the new screen
+    delete[] mLastFrame;
+    mLastFrame = 0;
+    setAllDirty();
+
     if (fs)
         displayFlags |= SDL_FULLSCREEN;
 
@@ -105,6 +201,15 @@ bool Graphics::setFullscreen(bool fs)
             mScreen->format->BitsPerPixel, fs, mHWAccel);
 }
 
+void Graphics::setTargetSurface(SDL_Surface *surface)
+{
+    // What is drawn onto the new surface is a frame of its own
+    mFrameCacheFrameStart = mFrameCacheUses;
+
+    mScreen = surface;
+    setTarget(surface);
+}
+
 int Graphics::getWidth() const
 {
     return mScreen->w;
@@ -115,10 +220,11 @@ int Graphics::getHeight() const
     return mScreen->h;
 }
 
-bool Graphics::drawImage(Image *image, int x, int y)
+bool Graphics::drawImage(Image *image, int x, int y, float opacity)
 {
     if (image)
-        return drawImage(image, 0, 0, x, y, image->mBounds.w, image->mBounds.h);
+        return drawImage(image, 0, 0, x, y,
+                         image->mBounds.w, image->mBounds.h, false, opacity);
     else
         return false;
 }
@@ -133,9 +239,8 @@ bool Graphics::drawRescaledImage(Image *image, int srcX, int srcY,
     if (!mScreen || !image) return false;
     if (!image->mSDLSurface) return false;
 
-    Image *tmpImage = image->SDLgetScaledImage(desiredWidth, desiredHeight);
-    bool returnValue = false;
-
+    Image *tmpImage = image->SDLgetCachedScaledImage(desiredWidth,
+                                                     desiredHeight);
     if (!tmpImage) return false;
     if (!tmpImage->mSDLSurface) return false;
 
@@ -152,20 +257,29 @@ bool Graphics::drawRescaledImage(Image *image, int srcX, int srcY,
     srcRect.w = width;
     srcRect.h = height;
 
-    returnValue = !(SDL_BlitSurface(tmpImage->mSDLSurface, &srcRect, mScreen, &dstRect) < 0);
-
-    delete tmpImage;
-
-    return returnValue;
+    return blitSurface(tmpImage->mSDLSurface, &srcRect, &dstRect, tmpImage);
 }
 
 bool Graphics::drawImage(Image *image, int srcX, int srcY, int dstX, int dstY,
-                         int width, int height, bool)
+                         int width, int height, bool, float opacity)
 {
     // Check that preconditions for blitting are met.
     if (!mScreen || !image) return false;
     if (!image->mSDLSurface) return false;
 
+    SDL_Surface *surface = image->mSDLSurface;
+
+    // Translucent draws use a cached variant of the surface, since the
+    // surface itself is shared by everyone using the image.
+    if (opacity < 1.0f)
+    {
+        if (opacity <= 0.0f)
+            return true;
+
+        surface = image->SDLgetAlphaSurface(image->mAlpha * opacity);
+        if (!surface) return false;
+    }
+
     dstX += mClipStack.top().xOffset;
     dstY += mClipStack.top().yOffset;
 
@@ -179,7 +293,8 @@ bool Graphics::drawImage(Image *image, int srcX, int srcY, int dstX, int dstY,
     srcRect.w = width;
     srcRect.h = height;
 
-    return !(SDL_BlitSurface(image->mSDLSurface, &srcRect, mScreen, &dstRect) < 0);
+    return blitSurface(surface, &srcRect, &dstRect,
+                       surface == image->mSDLSurface ? image : NULL);
 }
 
 void Graphics::drawImage(gcn::Image const *image, int srcX, int srcY,
@@ -220,7 +335,7 @@ void Graphics::drawImagePattern(Image *image, int x, int y, int w, int h)
             srcRect.x = srcX; srcRect.y = srcY;
             srcRect.w = dw;   srcRect.h = dh;
 
-            SDL_BlitSurface(image->mSDLSurface, &srcRect, mScreen, &dstRect);
+            blitSurface(image->mSDLSurface, &srcRect, &dstRect, image);
         }
     }
 }
@@ -234,7 +349,8 @@ void Graphics::drawRescaledImagePattern(Image *image, int x, int y,
 
     if (scaledHeight == 0 || scaledWidth == 0) return;
 
-    Image *tmpImage = image->SDLgetScaledImage(scaledWidth, scaledHeight);
+    Image *tmpImage = image->SDLgetCachedScaledImage(scaledWidth,
+                                                     scaledHeight);
     if (!tmpImage) return;
 
     const int iw = tmpImage->getWidth();
@@ -260,11 +376,15 @@ void Graphics::drawRescaledImagePattern(Image *image, int x, int y,
             srcRect.x = srcX; srcRect.y = srcY;
             srcRect.w = dw;   srcRect.h = dh;
 
-            SDL_BlitSurface(tmpImage->mSDLSurface, &srcRect, mScreen, &dstRect);
+            blitSurface(tmpImage->mSDLSurface, &srcRect, &dstRect, tmpImage);
         }
     }
+}
 
-    delete tmpImage;
+bool Graphics::blitSurface(SDL_Surface *surface,
+                           SDL_Rect *srcRect, SDL_Rect *dstRect, Image *)
+{
+    return !(SDL_BlitSurface(surface, srcRect, mScreen, dstRect) < 0);
 }
 
 void Graphics::drawImageRect(int x, int y, int w, int h,
@@ -313,15 +433,433 @@ void Graphics::drawImageRect(int x, int y, int w, int h,
 void Graphics::drawImageRect(int x, int y, int w, int h,
                              const ImageRect &imgRect)
 {
+    if (Image *frame = getFrame(imgRect, w, h))
+    {
+        drawImage(frame, x, y);
+        return;
+    }
+
     drawImageRect(x, y, w, h,
             imgRect.grid[0], imgRect.grid[2], imgRect.grid[6], imgRect.grid[8],
             imgRect.grid[1], imgRect.grid[5], imgRect.grid[7], imgRect.grid[3],
             imgRect.grid[4]);
 }
 
+Image *Graphics::getFrame(const ImageRect &imgRect, int w, int h)
+{
+#ifdef USE_OPENGL
+    // The quads of the pieces are batched with OpenGL
+    if (Image::getLoadAsOpenGL())
+        return NULL;
+#endif
+
+    if (w <= 0 || h <= 0 || w * h > MAX_CACHED_FRAME_PIXELS)
+        return NULL;
+
+    FrameKey key;
+    for (int i = 0; i < 9; i++)
+    {
+        if (!imgRect.grid[i] || !imgRect.grid[i]->mSDLSurface)
+            return NULL;
+        key.grid[i] = imgRect.grid[i];
+    }
+    key.width = w;
+    key.height = h;
+    key.alpha = imgRect.grid[ImageRect::CENTER]->getAlpha();
+
+    FrameCache::iterator i = mFrameCache.find(key);
+
+    // Rectangles drawn at a size for the first time, like windows being
+    // resized, are drawn piece by piece
+    if (i == mFrameCache.end())
+    {
+        if (makeFrameCacheRoom(1, 0))
+        {
+            CachedFrame &frame = mFrameCache[key];
+            frame.image = NULL;
+            frame.lastUsed = ++mFrameCacheUses;
+        }
+        return NULL;
+    }
+
+    i->second.lastUsed = ++mFrameCacheUses;
+    if (i->second.image)
+        return i->second.image;
+
+    if (!makeFrameCacheRoom(0, w * h))
+        return NULL;
+
+    Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0xff000000;
+    gmask = 0x00ff0000;
+    bmask = 0x0000ff00;
+    amask = 0x000000ff;
+#else
+    rmask = 0x000000ff;
+    gmask = 0x0000ff00;
+    bmask = 0x00ff0000;
+    amask = 0xff000000;
+#endif
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32,
+                                                rmask, gmask, bmask, amask);
+    if (!surface)
+        return NULL;
+
+    SDL_FillRect(surface, NULL, 0);
+
+    Image *const *grid = imgRect.grid;
+    Image *topLeft = grid[ImageRect::UPPER_LEFT];
+    Image *topRight = grid[ImageRect::UPPER_RIGHT];
+    Image *bottomLeft = grid[ImageRect::LOWER_LEFT];
+    Image *bottomRight = grid[ImageRect::LOWER_RIGHT];
+    Image *top = grid[ImageRect::UPPER_CENTER];
+    Image *right = grid[ImageRect::RIGHT];
+    Image *bottom = grid[ImageRect::LOWER_CENTER];
+    Image *left = grid[ImageRect::LEFT];
+
+    // The pieces are composed in the order drawImageRect draws them
+    blendPattern(grid[ImageRect::CENTER], surface,
+            topLeft->getWidth(), topLeft->getHeight(),
+            w - topLeft->getWidth() - topRight->getWidth(),
+            h - topLeft->getHeight() - bottomLeft->getHeight());
+
+    blendPattern(top, surface,
+            left->getWidth(), 0,
+            w - left->getWidth() - right->getWidth(), top->getHeight());
+    blendPattern(bottom, surface,
+            left->getWidth(), h - bottom->getHeight(),
+            w - left->getWidth() - right->getWidth(),
+            bottom->getHeight());
+    blendPattern(left, surface,
+            0, top->getHeight(),
+            left->getWidth(),
+            h - top->getHeight() - bottom->getHeight());
+    blendPattern(right, surface,
+            w - right->getWidth(), top->getHeight(),
+            right->getWidth(),
+            h - top->getHeight() - bottom->getHeight());
+
+    topLeft->SDLblendOnto(surface, 0, 0);
+    topRight->SDLblendOnto(surface, w - topRight->getWidth(), 0);
+    bottomLeft->SDLblendOnto(surface, 0, h - bottomLeft->getHeight());
+    bottomRight->SDLblendOnto(surface,
+            w - bottomRight->getWidth(),
+            h - bottomRight->getHeight());
+
+    i->second.image = Image::load(surface);
+    SDL_FreeSurface(surface);
+
+    if (i->second.image)
+        mFrameCachePixels += w * h;
+
+    return i->second.image;
+}
+
+void Graphics::imageUnloaded(const Image *image)
+{
+    // The caches are used without locking while drawing
+    assert(SDL_ThreadID() == mMainThread);
+
+    for (std::list<Graphics*>::iterator i = mInstances.begin();
+         i != mInstances.end(); ++i)
+        (*i)->forgetImage(image);
+}
+
+void Graphics::forgetImage(const Image *image)
+{
+    forgetFrames(image);
+}
+
+void Graphics::forgetFrames(const Image *image)
+{
+    FrameCache::iterator i = mFrameCache.begin();
+    while (i != mFrameCache.end())
+    {
+        const FrameKey &key = i->first;
+        if (std::find(key.grid, key.grid + 9, image) == key.grid + 9)
+        {
+            ++i;
+            continue;
+        }
+
+        // Deleting the composed image comes back here, so it is only done
+        // once the entry is gone
+        Image *composed = i->second.image;
+        if (composed)
+            mFrameCachePixels -= key.width * key.height;
+        mFrameCache.erase(i++);
+        delete composed;
+    }
+}
+
+bool Graphics::makeFrameCacheRoom(unsigned int frames, int pixels)
+{
+    while (mFrameCache.size() + frames > MAX_CACHED_FRAMES ||
+           mFrameCachePixels + pixels > MAX_CACHED_FRAME_PIXELS)
+    {
+        if (mFrameCache.empty())
+            return false;
+
+        FrameCache::iterator oldest = mFrameCache.begin();
+        for (FrameCache::iterator i = mFrameCache.begin();
+             i != mFrameCache.end(); ++i)
+        {
+            if (i->second.lastUsed < oldest->second.lastUsed)
+                oldest = i;
+        }
+
+        // When all rectangles were drawn in this frame, replacing any of
+        // them would make the cache cycle without ever being used. The
+        // rectangles that don't fit are drawn piece by piece instead.
+        if (oldest->second.lastUsed > mFrameCacheFrameStart)
+            return false;
+
+        if (oldest->second.image)
+        {
+            mFrameCachePixels -= oldest->first.width * oldest->first.height;
+            delete oldest->second.image;
+        }
+        mFrameCache.erase(oldest);
+    }
+
+    return true;
+}
+
+void Graphics::clearFrameCache()
+{
+    for (FrameCache::iterator i = mFrameCache.begin();
+         i != mFrameCache.end(); ++i)
+        delete i->second.image;
+
+    mFrameCache.clear();
+    mFrameCachePixels = 0;
+}
+
+/**
+ * Tells whether the given rectangles overlap or touch.
+ */
+static bool touches(const gcn::Rectangle &a, const gcn::Rectangle &b)
+{
+    return a.x <= b.x + b.width && a.y <= b.y + b.height &&
+           a.x + a.width >= b.x && a.y + a.height >= b.y;
+}
+
+/**
+ * Grows the first rectangle to include the second.
+ */
+static void unite(gcn::Rectangle &a, const gcn::Rectangle &b)
+{
+    const int right = std::max(a.x + a.width, b.x + b.width);
+    const int bottom = std::max(a.y + a.height, b.y + b.height);
+    a.x = std::min(a.x, b.x);
+    a.y = std::min(a.y, b.y);
+    a.width = right - a.x;
+    a.height = bottom - a.y;
+}
+
 void Graphics::updateScreen()
 {
-    SDL_Flip(mScreen);
+    mFrameCacheFrameStart = mFrameCacheUses;
+
+    if (mDirtyRects && !mHWAccel)
+        updateDirtyRects();
+    else
+        SDL_Flip(mScreen);
+
+    mDrawnAreas.clear();
+    mDrawAll = false;
+}
+
+void Graphics::setDirtyRects(bool dirtyRects, bool check)
+{
+    mDirtyRects = dirtyRects;
+    mCheckDirtyRects = dirtyRects && check;
+
+    delete[] mLastFrame;
+    mLastFrame = 0;
+    setAllDirty();
+}
+
+void Graphics::addDirtyArea(const gcn::Rectangle &area)
+{
+    if (mAllDirty || !mScreen)
+        return;
+
+    // Only the part on the screen matters
+    gcn::Rectangle rect(std::max(area.x, 0), std::max(area.y, 0), 0, 0);
+    rect.width = std::min(area.x + area.width, mScreen->w) - rect.x;
+    rect.height = std::min(area.y + area.height, mScreen->h) - rect.y;
+    if (rect.width <= 0 || rect.height <= 0)
+        return;
+
+    for (std::vector<gcn::Rectangle>::iterator i = mDirtyAreas.begin();
+         i != mDirtyAreas.end(); ++i)
+    {
+        if (touches(*i, rect))
+        {
+            unite(*i, rect);
+            return;
+        }
+    }
+
+    mDirtyAreas.push_back(rect);
+
+    // Too many separate areas cost more to copy than they save
+    if (mDirtyAreas.size() > MAX_DIRTY_AREAS)
+    {
+        for (unsigned int i = 1; i < mDirtyAreas.size(); i++)
+            unite(mDirtyAreas[0], mDirtyAreas[i]);
+        mDirtyAreas.resize(1);
+    }
+}
+
+void Graphics::setAllDirty()
+{
+    mAllDirty = true;
+    mDirtyAreas.clear();
+}
+
+bool Graphics::clipToDirtyArea()
+{
+    // What is reported from now on is drawn in the next frame
+    mDrawAll = mAllDirty;
+    mDrawnAreas.swap(mDirtyAreas);
+    mDirtyAreas.clear();
+    mAllDirty = false;
+
+    if (!mDirtyRects || mHWAccel || mCheckDirtyRects || mDrawAll)
+        return true;
+
+    if (mDrawnAreas.empty())
+        return false;
+
+    gcn::Rectangle bounds = mDrawnAreas[0];
+    for (unsigned int i = 1; i < mDrawnAreas.size(); i++)
+        unite(bounds, mDrawnAreas[i]);
+
+    if (bounds.width * bounds.height * 100 >
+        mScreen->w * mScreen->h * DIRTY_FULL_UPDATE)
+    {
+        mDrawAll = true;
+        return true;
+    }
+
+    // Everything is drawn once, clipped to the area around all changes.
+    // Only the changed areas themselves are copied to the screen.
+    gcn::ClipRectangle &top = mClipStack.top();
+    const int right = std::min(top.x + top.width, bounds.x + bounds.width);
+    const int bottom = std::min(top.y + top.height, bounds.y + bounds.height);
+    top.x = std::max(top.x, bounds.x);
+    top.y = std::max(top.y, bounds.y);
+    top.width = std::max(right - top.x, 0);
+    top.height = std::max(bottom - top.y, 0);
+
+    SDL_Rect rect;
+    rect.x = top.x;
+    rect.y = top.y;
+    rect.w = top.width;
+    rect.h = top.height;
+    SDL_SetClipRect(mTarget, &rect);
+
+    return true;
+}
+
+void Graphics::updateDirtyRects()
+{
+    if (mCheckDirtyRects)
+        checkDirtyRects();
+
+    if (mDrawAll || mCheckDirtyRects)
+    {
+        SDL_UpdateRect(mScreen, 0, 0, 0, 0);
+        return;
+    }
+
+    if (mDrawnAreas.empty())
+        return;
+
+    std::vector<SDL_Rect> rects(mDrawnAreas.size());
+    for (unsigned int i = 0; i < mDrawnAreas.size(); i++)
+    {
+        rects[i].x = mDrawnAreas[i].x;
+        rects[i].y = mDrawnAreas[i].y;
+        rects[i].w = mDrawnAreas[i].width;
+        rects[i].h = mDrawnAreas[i].height;
+    }
+    SDL_UpdateRects(mScreen, rects.size(), &rects[0]);
+}
+
+void Graphics::checkDirtyRects()
+{
+    const int pitch = mScreen->pitch;
+    const int bpp = mScreen->format->BytesPerPixel;
+
+    if (SDL_MUSTLOCK(mScreen))
+        SDL_LockSurface(mScreen);
+
+    const Uint8 *pixels = (const Uint8*) mScreen->pixels;
+
+    if (!mLastFrame)
+    {
+        mLastFrame = new Uint8[pitch * mScreen->h];
+        memcpy(mLastFrame, pixels, pitch * mScreen->h);
+
+        if (SDL_MUSTLOCK(mScreen))
+            SDL_UnlockSurface(mScreen);
+        return;
+    }
+
+    for (int blockY = 0; blockY < mScreen->h; blockY += DIRTY_BLOCK_SIZE)
+    {
+        const int height = std::min(DIRTY_BLOCK_SIZE, mScreen->h - blockY);
+
+        for (int blockX = 0; blockX < mScreen->w; blockX += DIRTY_BLOCK_SIZE)
+        {
+            const int width = std::min(DIRTY_BLOCK_SIZE, mScreen->w - blockX);
+            const int offset = blockY * pitch + blockX * bpp;
+            bool changed = false;
+
+            for (int y = 0; y < height; y++)
+            {
+                const int start = offset + y * pitch;
+                if (memcmp(mLastFrame + start, pixels + start, width * bpp))
+                {
+                    changed = true;
+                    memcpy(mLastFrame + start, pixels + start, width * bpp);
+                }
+            }
+
+            if (!changed || mDrawAll)
+                continue;
+
+            // The block may only change when it was reported
+            const gcn::Rectangle block(blockX, blockY, width, height);
+            bool reported = false;
+            for (std::vector<gcn::Rectangle>::const_iterator
+                 i = mDrawnAreas.begin(); i != mDrawnAreas.end(); ++i)
+            {
+                if (i->x < block.x + block.width &&
+                    i->y < block.y + block.height &&
+                    i->x + i->width > block.x &&
+                    i->y + i->height > block.y)
+                {
+                    reported = true;
+                    break;
+                }
+            }
+
+            if (!reported)
+            {
+                logger->log("Unreported change on the screen at %d,%d",
+                            blockX, blockY);
+            }
+        }
+    }
+
+    if (SDL_MUSTLOCK(mScreen))
+        SDL_UnlockSurface(mScreen);
 }
 
 SDL_Surface *Graphics::getScreenshot()
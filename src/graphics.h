@@ -24,9 +24,14 @@
 
 #include <guichan/sdl/sdlgraphics.hpp>
 
+#include <list>
+#include <map>
+#include <vector>
+
 class Image;
 class ImageRect;
 
+struct SDL_Rect;
 struct SDL_Surface;
 
 static const int defaultScreenWidth = 800;
@@ -96,10 +101,14 @@ class Graphics : public gcn::SDLGraphics
         /**
          * Blits an image onto the screen.
          *
+         * @param opacity The opacity to draw the image with. It is combined
+         *                with the alpha of the image itself, which is left
+         *                untouched.
+         *
          * @return <code>true</code> if the image was blitted properly
          *         <code>false</code> otherwise.
          */
-        bool drawImage(Image *image, int x, int y);
+        bool drawImage(Image *image, int x, int y, float opacity = 1.0f);
 
         /**
          * Overrides with our own drawing method.
@@ -132,6 +141,10 @@ class Graphics : public gcn::SDLGraphics
         /**
          * Blits an image onto the screen.
          *
+         * @param opacity The opacity to draw the image with. It is combined
+         *                with the alpha of the image itself, which is left
+         *                untouched.
+         *
          * @return <code>true</code> if the image was blitted properly
          *         <code>false</code> otherwise.
          */
@@ -139,7 +152,8 @@ class Graphics : public gcn::SDLGraphics
                                int srcX, int srcY,
                                int dstX, int dstY,
                                int width, int height,
-                               bool useColor = false);
+                               bool useColor = false,
+                               float opacity = 1.0f);
 
         virtual void drawImagePattern(Image *image,
                                       int x, int y,
@@ -167,17 +181,71 @@ class Graphics : public gcn::SDLGraphics
         /**
          * Draws a rectangle using images. 4 corner images, 4 side images and 1
          * image for the inside.
+         *
+         * With SDL, a rectangle that is drawn at the same size more than once
+         * is composed into a single image, which is drawn from then on.
          */
         void drawImageRect(
                 int x, int y, int w, int h,
                 const ImageRect &imgRect);
 
+        /**
+         * Makes every Graphics forget what it keeps about the given image,
+         * like the composed rectangles made from it. Called when an image is
+         * unloaded, since another image may be loaded at the same address
+         * later.
+         *
+         * Must be called from the main thread, which does all the drawing.
+         * Images are therefore only to be unloaded from the main thread.
+         */
+        static void imageUnloaded(const Image *image);
+
         /**
          * Updates the screen. This is done by either copying the buffer to the
          * screen or swapping pages.
          */
         virtual void updateScreen();
 
+        /**
+         * Sets whether only the parts of the screen that changed since the
+         * last frame are drawn and copied to the screen. The changes are
+         * reported through addDirtyArea() and setAllDirty(). Only has an
+         * effect without hardware acceleration, since pages are swapped
+         * otherwise.
+         *
+         * @param check Draws the whole screen every frame instead, and logs
+         *              the parts that changed without being reported. For
+         *              debugging.
+         */
+        void setDirtyRects(bool dirtyRects, bool check = false);
+
+        /**
+         * Tells that the given area of the screen changed and is to be drawn
+         * again.
+         */
+        void addDirtyArea(const gcn::Rectangle &area);
+
+        /**
+         * Tells that the whole screen is to be drawn again.
+         */
+        void setAllDirty();
+
+        /**
+         * Starts drawing a frame. When only the changed parts of the screen
+         * are drawn, narrows the current clip area to those parts. Changes
+         * reported while drawing are left for the next frame.
+         *
+         * @return <code>false</code> when nothing changed, in which case
+         *         there is nothing to draw.
+         */
+        virtual bool clipToDirtyArea();
+
+        /**
+         * Makes this graphics context draw onto the given surface instead of
+         * the screen. Used to draw widgets into an image.
+         */
+        void setTargetSurface(SDL_Surface *surface);
+
         /**
          * Returns the width of the screen.
          */
@@ -194,8 +262,100 @@ class Graphics : public gcn::SDLGraphics
         virtual SDL_Surface *getScreenshot();
 
     protected:
+        /**
+         * Blits the given surface to the screen, clipped to the current clip
+         * area. All image drawing ends up here.
+         *
+         * @param image The image the surface belongs to, when the surface is
+         *              the one changed by Image::setAlpha.
+         */
+        virtual bool blitSurface(SDL_Surface *surface,
+                                 SDL_Rect *srcRect, SDL_Rect *dstRect,
+                                 Image *image = NULL);
+
+        /**
+         * Forgets what is kept about the given image, which is being
+         * unloaded.
+         */
+        virtual void forgetImage(const Image *image);
+
+        /**
+         * Copies the parts of the buffer that were drawn this frame to the
+         * screen.
+         */
+        void updateDirtyRects();
+
+        /**
+         * Compares the buffer to the last frame and logs the parts that
+         * changed without being reported.
+         */
+        void checkDirtyRects();
+
         SDL_Surface *mScreen;
         bool mFullscreen, mHWAccel;
+
+        bool mDirtyRects;
+        bool mCheckDirtyRects;
+        bool mAllDirty;         /**< The whole screen is to be drawn. */
+        bool mDrawAll;          /**< The whole screen is drawn this frame. */
+        std::vector<gcn::Rectangle> mDirtyAreas; /**< Changes to draw. */
+        std::vector<gcn::Rectangle> mDrawnAreas; /**< Drawn this frame. */
+        Uint8 *mLastFrame;      /**< Copy of the last frame presented. */
+
+    private:
+        /**
+         * Identifies a composed image rectangle.
+         */
+        struct FrameKey
+        {
+            Image *grid[9];
+            int width, height;
+            float alpha;
+
+            bool operator<(const FrameKey &other) const;
+        };
+
+        struct CachedFrame
+        {
+            Image *image;       /**< NULL until drawn twice at this size */
+            int lastUsed;
+        };
+
+        typedef std::map<FrameKey, CachedFrame> FrameCache;
+
+        /**
+         * Returns the composed image of the given rectangle at the given
+         * size, or NULL when it should be drawn piece by piece.
+         */
+        Image *getFrame(const ImageRect &imgRect, int w, int h);
+
+        /**
+         * Frees the least recently drawn composed rectangles until the
+         * given number of rectangles and pixels can be added to the cache.
+         * Rectangles drawn in the current frame are kept, in which case
+         * there is no room.
+         *
+         * @return whether there is room in the cache.
+         */
+        bool makeFrameCacheRoom(unsigned int frames, int pixels);
+
+        /**
+         * Frees all composed rectangles.
+         */
+        void clearFrameCache();
+
+        /**
+         * Forgets the composed rectangles made from the given image.
+         */
+        void forgetFrames(const Image *image);
+
+        FrameCache mFrameCache;
+        int mFrameCacheUses;    /**< Counter telling the last used frame */
+        int mFrameCacheFrameStart; /**< The counter when the frame began */
+        int mFrameCachePixels;  /**< Number of pixels in composed frames */
+
+        static std::list<Graphics*> mInstances;
+        static Uint32 mMainThread;  /**< The thread the graphics draw in */
 };
 
 extern Graphics *graphics;
@@ -25,16 +25,22 @@
 #include "gui/setup_video.h"
 #include "gui/viewport.h"
 
+#include "gui/widgets/frametimegraph.h"
 #include "gui/widgets/label.h"
 #include "gui/widgets/layout.h"
 
 #include "engine.h"
 #include "game.h"
+#ifdef USE_OPENGL
+#include "openglgraphics.h"
+#endif
 #include "particle.h"
 #include "main.h"
 #include "map.h"
+#include "profiler.h"
 
 #include "resources/image.h"
+#include "resources/textureatlas.h"
 
 #include "utils/gettext.h"
 #include "utils/stringutils.h"
@@ -48,7 +54,7 @@ DebugWindow::DebugWindow():
     setResizable(true);
     setCloseButton(true);
     setSaveVisible(true);
-    setDefaultSize(400, 100, ImageRect::CENTER);
+    setDefaultSize(400, 280, ImageRect::CENTER);
 
 #ifdef USE_OPENGL
     if (Image::getLoadAsOpenGL())
@@ -62,13 +68,21 @@ DebugWindow::DebugWindow():
     }
 
     mFPSLabel = new Label(strprintf(_("%d FPS"), 0));
+    mFrameTimeLabel = new Label();
     mMusicFileLabel = new Label(strprintf(_("Music: %s"), ""));
     mMapLabel = new Label(strprintf(_("Map: %s"), ""));
     mMinimapLabel = new Label(strprintf(_("Minimap: %s"), ""));
+    mMapMemoryLabel = new Label();
     mTileMouseLabel = new Label(strprintf(_("Cursor: (%d, %d)"), 0, 0));
     mParticleCountLabel = new Label(strprintf(_("Particle count: %d"), 88888));
     mParticleDetailLabel = new Label();
     mAmbientDetailLabel = new Label();
+    mDrawCallLabel = new Label();
+    mAtlasLabel = new Label();
+    mWindowRedrawLabel = new Label();
+    mPercentileLabel = new Label();
+    mBreakdownLabel = new Label();
+    mFrameTimeGraph = new FrameTimeGraph();
 
     place(0, 0, mFPSLabel, 3);
     place(3, 0, mTileMouseLabel);
@@ -78,6 +92,14 @@ DebugWindow::DebugWindow():
     place(3, 2, mParticleDetailLabel);
     place(0, 3, mMinimapLabel, 4);
     place(3, 3, mAmbientDetailLabel);
+    place(0, 4, mDrawCallLabel, 3);
+    place(3, 4, mAtlasLabel);
+    place(0, 5, mFrameTimeLabel, 4);
+    place(0, 6, mWindowRedrawLabel, 4);
+    place(0, 7, mPercentileLabel, 4);
+    place(0, 8, mBreakdownLabel, 4);
+    place(0, 9, mMapMemoryLabel, 4);
+    place(0, 10, mFrameTimeGraph, 4);
 
     loadWindowState();
 }
@@ -93,6 +115,31 @@ void DebugWindow::logic()
 
     mFPSLabel->setCaption(strprintf(mFPSText.c_str(), fps));
 
+    mFrameTimeLabel->setCaption(strprintf(_("Frame time: %.1f ms, "
+                                            "max: %.1f ms, deviation: %.1f ms"),
+                                          frameTiming.average,
+                                          frameTiming.maximum,
+                                          frameTiming.deviation));
+    mFrameTimeLabel->adjustSize();
+
+    mPercentileLabel->setCaption(strprintf(_("Frame time p50: %.1f ms, "
+                                             "p95: %.1f ms, p99: %.1f ms"),
+                                           Profiler::getPercentile(0.50f),
+                                           Profiler::getPercentile(0.95f),
+                                           Profiler::getPercentile(0.99f)));
+    mPercentileLabel->adjustSize();
+
+    // The average time per frame spent on each subsystem
+    std::string breakdown = _("Per frame:");
+    for (int i = 0; i < Profiler::SECTION_COUNT; i++)
+    {
+        const Profiler::Section section = (Profiler::Section) i;
+        breakdown += strprintf(" %s %.1f", Profiler::getSectionName(section),
+                               Profiler::getAverage(section));
+    }
+    mBreakdownLabel->setCaption(breakdown);
+    mBreakdownLabel->adjustSize();
+
     mTileMouseLabel->setCaption(strprintf(_("Cursor: (%d, %d)"), mouseTileX,
                                           mouseTileY));
 
@@ -111,6 +158,12 @@ void DebugWindow::logic()
         const std::string map =
             "Map: " + currentMap->getProperty("_filename");
         mMapLabel->setCaption(map);
+
+        mMapMemoryLabel->setCaption(strprintf(_("Map memory: %d KiB, "
+                                                "pathfinding: %d KiB"),
+                currentMap->getMemoryUsage() / 1024,
+                Map::getPathfindingMemoryUsage() / 1024));
+        mMapMemoryLabel->adjustSize();
     }
 
     mParticleCountLabel->setCaption(strprintf(_("Particle count: %d"),
@@ -127,4 +180,36 @@ void DebugWindow::logic()
                                     Setup_Video::overlayDetailToString()));
 
     mAmbientDetailLabel->adjustSize();
+
+    // How often the windows drawn from an image had to draw their widgets
+    std::string redraws = _("Window redraws:");
+    const std::list<Window*> &cachedWindows = Window::getCachedWindows();
+    for (std::list<Window*>::const_iterator i = cachedWindows.begin();
+         i != cachedWindows.end(); ++i)
+    {
+        if (i != cachedWindows.begin())
+            redraws += ",";
+        redraws += strprintf(" %s %d", (*i)->getWindowName().c_str(),
+                             (*i)->getRedrawCount());
+    }
+    mWindowRedrawLabel->setCaption(redraws);
+    mWindowRedrawLabel->adjustSize();
+
+#ifdef USE_OPENGL
+    if (Image::getLoadAsOpenGL())
+    {
+        OpenGLGraphics *g = static_cast<OpenGLGraphics*>(graphics);
+        mDrawCallLabel->setCaption(strprintf(_("Draw calls: %d, batches: %d"),
+                                   g->getDrawCallCount(),
+                                   g->getBatchCount()));
+        mDrawCallLabel->adjustSize();
+
+        mAtlasLabel->setCaption(strprintf(_("Atlases: %d, %d%% used, "
+                                            "%d%% fragmented"),
+                                TextureAtlas::getAtlasCount(),
+                                TextureAtlas::getOccupancy(),
+                                TextureAtlas::getFragmentation()));
+        mAtlasLabel->adjustSize();
+    }
+#endif
 }
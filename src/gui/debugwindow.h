@@ -24,6 +24,7 @@
 
 #include "gui/widgets/window.h"
 
+class FrameTimeGraph;
 class Label;
 
 /**
@@ -46,10 +47,15 @@ class DebugWindow : public Window
 
     private:
         Label *mMusicFileLabel, *mMapLabel, *mMinimapLabel;
-        Label *mTileMouseLabel, *mFPSLabel;
+        Label *mMapMemoryLabel;
+        Label *mTileMouseLabel, *mFPSLabel, *mFrameTimeLabel;
         Label *mParticleCountLabel, *mParticleDetailLabel;
         Label *mAmbientDetailLabel;
-
+        Label *mDrawCallLabel;
+        Label *mAtlasLabel;
+        Label *mWindowRedrawLabel;
+        Label *mPercentileLabel, *mBreakdownLabel;
+        FrameTimeGraph *mFrameTimeGraph;
 
         std::string mFPSText;
 };
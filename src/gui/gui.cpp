@@ -25,6 +25,7 @@
 #include "gui/palette.h"
 #include "gui/sdlinput.h"
 #include "gui/skin.h"
+#include "gui/textrenderer.h"
 #include "gui/truetypefont.h"
 #include "gui/viewport.h"
 
@@ -154,6 +155,9 @@ Gui::~Gui()
     if (mMouseCursors)
         mMouseCursors->decRef();
 
+    // The cached text images refer to the fonts
+    TextRenderer::clearCache();
+
     delete mGuiFont;
     delete boldFont;
     delete mInfoParticleFont;
@@ -184,6 +188,14 @@ void Gui::logic()
 void Gui::draw()
 {
     mGraphics->pushClipArea(getTop()->getDimension());
+
+    // Only the parts of the screen that changed may have to be drawn
+    if (!static_cast<Graphics*>(mGraphics)->clipToDirtyArea())
+    {
+        mGraphics->popClipArea();
+        return;
+    }
+
     getTop()->draw(mGraphics);
 
     int mouseX, mouseY;
@@ -194,12 +206,12 @@ void Gui::draw()
             && mMouseCursorAlpha > 0.0f)
     {
         Image *mouseCursor = mMouseCursors->get(mCursorType);
-        mouseCursor->setAlpha(mMouseCursorAlpha);
 
         static_cast<Graphics*>(mGraphics)->drawImage(
                 mouseCursor,
                 mouseX - 15,
-                mouseY - 17);
+                mouseY - 17,
+                mMouseCursorAlpha);
     }
 
     mGraphics->popClipArea();
@@ -143,6 +143,16 @@ ItemAmountWindow::ItemAmountWindow(Usage usage, Window *parent, Item *item,
     mItemIcon->addMouseListener(this);
 }
 
+void ItemAmountWindow::logic()
+{
+    Window::logic();
+
+    // The item shows a placeholder until its image is loaded
+    Image *image = mItem->getImage();
+    if (image && mItemIcon->getImage() != image)
+        mItemIcon->setImage(image);
+}
+
 // Show ItemTooltip
 void ItemAmountWindow::mouseMoved(gcn::MouseEvent &event)
 {
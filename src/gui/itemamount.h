@@ -71,6 +71,11 @@ class ItemAmountWindow : public Window,
 
         void keyReleased(gcn::KeyEvent &keyEvent);
 
+        /**
+         * Logic (shows the item image once it is loaded).
+         */
+        void logic();
+
         /**
          * Creates the dialog, or bypass it if there aren't enough items.
          */
@@ -130,7 +130,6 @@ void ItemContainer::draw(gcn::Graphics *graphics)
                         g->drawImage(mSelImg, itemX, itemY);
                     }
                 }
-                image->setAlpha(1.0f); // ensure the image if fully drawn...
                 g->drawImage(image, itemX, itemY);
             }
             // Draw item caption
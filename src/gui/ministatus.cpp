@@ -28,11 +28,14 @@
 
 #include "animatedsprite.h"
 #include "configuration.h"
+#include "game.h"
 #include "graphics.h"
 #include "localplayer.h"
 
 #include "utils/stringutils.h"
 
+#include <algorithm>
+
 extern volatile int tick_time;
 
 MiniStatusWindow::MiniStatusWindow():
@@ -70,11 +73,13 @@ void MiniStatusWindow::setIcon(int index, AnimatedSprite *sprite)
         delete mIcons[index];
 
     mIcons[index] = sprite;
+    requestRedraw();
 }
 
 void MiniStatusWindow::eraseIcon(int index)
 {
     mIcons.erase(mIcons.begin() + index);
+    requestRedraw();
 }
 
 void MiniStatusWindow::drawIcons(Graphics *graphics)
@@ -122,7 +127,20 @@ void MiniStatusWindow::logic()
     }
     */
 
+    int height = 0;
+    bool changed = false;
+
     for (unsigned int i = 0; i < mIcons.size(); i++)
+    {
         if (mIcons[i])
-            mIcons[i]->update(tick_time * 10);
+        {
+            if (mIcons[i]->update(tick_time * 10))
+                changed = true;
+            height = std::max(height, mIcons[i]->getHeight());
+        }
+    }
+
+    // The icons are drawn in a row at the top of the screen, see drawIcons()
+    if (changed)
+        requestRedraw(gcn::Rectangle(0, 0, graphics->getWidth(), height + 3));
 }
@@ -26,6 +26,7 @@
 #include "game.h"
 
 #include "gui/gui.h"
+#include "gui/textrenderer.h"
 
 #include "utils/gettext.h"
 #include "utils/stringutils.h"
@@ -183,6 +184,9 @@ void Palette::setColor(ColorType type, int r, int g, int b)
     mColVector[type].color.r = r;
     mColVector[type].color.g = g;
     mColVector[type].color.b = b;
+
+    // The cached text images were composed with the old colors
+    TextRenderer::clearCache();
 }
 
 void Palette::setGradient(ColorType type, GradientType grad)
@@ -207,7 +211,20 @@ void Palette::setGradient(ColorType type, GradientType grad)
     if (elem->grad != grad)
     {
         elem->grad = grad;
+        TextRenderer::clearCache();
+    }
+}
+
+bool Palette::isAnimated(const gcn::Color &color) const
+{
+    for (size_t i = 0; i < mGradVector.size(); i++)
+    {
+        const gcn::Color &animated = mGradVector[i]->color;
+        if (animated.r == color.r && animated.g == color.g &&
+            animated.b == color.b)
+            return true;
     }
+    return false;
 }
 
 std::string Palette::getElementAt(int i)
@@ -248,6 +248,20 @@ class Palette : public gcn::ListModel
         void setGradientDelay(ColorType type, int delay)
             { mColVector[type].delay = delay; }
 
+        /**
+         * Tells whether the specified color changes over time.
+         */
+        bool isAnimated(ColorType type) const
+            { return mColVector[type].grad != STATIC; }
+
+        /**
+         * Tells whether the given color currently matches one of the colors
+         * of this palette that change over time. The colors are compared by
+         * value, ignoring the alpha, since callers often pass a copy of a
+         * palette color with its alpha changed.
+         */
+        bool isAnimated(const gcn::Color &color) const;
+
         /**
          * Returns the number of colors known.
          *
@@ -178,6 +178,7 @@ const char *Setup_Video::particleDetailToString(int detail)
 Setup_Video::Setup_Video():
     mFullScreenEnabled(config.getValue("screen", false)),
     mOpenGLEnabled(config.getValue("opengl", false)),
+    mCompositorEnabled(config.getValue("compositor", false)),
     mCustomCursorEnabled(config.getValue("customcursor", true)),
     mVisibleNamesEnabled(config.getValue("visiblenames", true)),
     mParticleEffectsEnabled(config.getValue("particleeffects", true)),
@@ -192,6 +193,7 @@ Setup_Video::Setup_Video():
     mModeList(new ListBox(mModeListModel)),
     mFsCheckBox(new CheckBox(_("Full screen"), mFullScreenEnabled)),
     mOpenGLCheckBox(new CheckBox(_("OpenGL"), mOpenGLEnabled)),
+    mCompositorCheckBox(new CheckBox(_("Threaded"), mCompositorEnabled)),
     mCustomCursorCheckBox(new CheckBox(_("Custom cursor"),
                                        mCustomCursorEnabled)),
     mVisibleNamesCheckBox(new CheckBox(_("Visible names"),
@@ -300,7 +302,8 @@ Setup_Video::Setup_Video():
     place(1, 0, mFsCheckBox, 2);
     place(3, 0, mOpenGLCheckBox, 1);
 
-    place(1, 1, mCustomCursorCheckBox, 3);
+    place(1, 1, mCustomCursorCheckBox, 2);
+    place(3, 1, mCompositorCheckBox, 1);
 
     place(1, 2, mVisibleNamesCheckBox, 3);
     place(3, 2, mNameCheckBox, 1);
@@ -397,6 +400,17 @@ void Setup_Video::apply()
                      _("Applying change to OpenGL requires restart."));
     }
 
+    // Threaded drawing change
+    if (mCompositorCheckBox->isSelected() != mCompositorEnabled)
+    {
+        config.setValue("compositor", mCompositorCheckBox->isSelected());
+
+        // The graphics context can only be changed by restarting
+        new OkDialog(_("Changing to threaded drawing"),
+                     _("Applying change to threaded drawing requires "
+                       "restart."));
+    }
+
     // FPS change
     config.setValue("fpslimit", mFps);
 
@@ -413,6 +427,7 @@ void Setup_Video::apply()
     mOpacity = config.getValue("guialpha", 0.8);
     mOverlayDetail = (int) config.getValue("OverlayDetail", 2);
     mOpenGLEnabled = config.getValue("opengl", false);
+    mCompositorEnabled = config.getValue("compositor", false);
     mPickupChatEnabled = config.getValue("showpickupchat", true);
     mPickupParticleEnabled = config.getValue("showpickupparticle", false);
 }
@@ -421,6 +436,7 @@ void Setup_Video::cancel()
 {
     mFsCheckBox->setSelected(mFullScreenEnabled);
     mOpenGLCheckBox->setSelected(mOpenGLEnabled);
+    mCompositorCheckBox->setSelected(mCompositorEnabled);
     mCustomCursorCheckBox->setSelected(mCustomCursorEnabled);
     mVisibleNamesCheckBox->setSelected(mVisibleNamesEnabled);
     mParticleEffectsCheckBox->setSelected(mParticleEffectsEnabled);
@@ -440,6 +456,7 @@ void Setup_Video::cancel()
         player_node->mUpdateName = true;
     config.setValue("guialpha", mOpacity);
     config.setValue("opengl", mOpenGLEnabled);
+    config.setValue("compositor", mCompositorEnabled);
     config.setValue("showpickupchat", mPickupChatEnabled);
     config.setValue("showpickupparticle", mPickupParticleEnabled);
 }
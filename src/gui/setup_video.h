@@ -51,6 +51,7 @@ class Setup_Video : public SetupTab, public gcn::ActionListener,
     private:
         bool mFullScreenEnabled;
         bool mOpenGLEnabled;
+        bool mCompositorEnabled;
         bool mCustomCursorEnabled;
         bool mVisibleNamesEnabled;
         bool mParticleEffectsEnabled;
@@ -74,6 +75,7 @@ class Setup_Video : public SetupTab, public gcn::ActionListener,
         gcn::ListBox *mModeList;
         gcn::CheckBox *mFsCheckBox;
         gcn::CheckBox *mOpenGLCheckBox;
+        gcn::CheckBox *mCompositorCheckBox;
         gcn::CheckBox *mCustomCursorCheckBox;
         gcn::CheckBox *mVisibleNamesCheckBox;
         gcn::CheckBox *mParticleEffectsCheckBox;
@@ -105,10 +105,7 @@ void ShopListBox::draw(gcn::Graphics *gcnGraphics)
         {
             Image *icon = mShopItems->at(i)->getImage();
             if (icon)
-            {
-                icon->setAlpha(1.0f);
                 graphics->drawImage(icon, 1, y);
-            }
         }
         graphics->setColor(guiPalette->getColor(Palette::TEXT));
         graphics->drawText(mListModel->getElementAt(i), ITEM_ICON_SIZE + 5,
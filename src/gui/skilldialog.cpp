@@ -88,6 +88,7 @@ SkillDialog::SkillDialog():
     setCloseButton(true);
     setResizable(true);
     setSaveVisible(true);
+    setCached(true);
     setDefaultSize(windowContainer->getWidth() - 280, 30, 275, 425);
     setupWindow->registerWindowForReset(this);
 
@@ -95,6 +95,7 @@ StatusWindow::StatusWindow():
     setResizable(true);
     setCloseButton(true);
     setSaveVisible(true);
+    setCached(true);
     setDefaultSize((windowContainer->getWidth() - 365) / 2,
                    (windowContainer->getHeight() - 255) / 2, 365, 275);
 
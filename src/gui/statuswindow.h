@@ -31,6 +31,7 @@
 #include <map>
 
 class AttrDisplay;
+class Label;
 class ProgressBar;
 class ScrollArea;
 class VertContainer;
@@ -75,12 +76,12 @@ class StatusWindow : public Window
         /**
          * Status Part
          */
-        gcn::Label *mLvlLabel, *mMoneyLabel;
-        gcn::Label *mHpLabel, *mMpLabel, *mXpLabel;
+        Label *mLvlLabel, *mMoneyLabel;
+        Label *mHpLabel, *mMpLabel, *mXpLabel;
         ProgressBar *mHpBar, *mMpBar, *mXpBar;
 
 #ifdef EATHENA_SUPPORT
-        gcn::Label *mJobLvlLabel, *mJobLabel;
+        Label *mJobLvlLabel, *mJobLabel;
         ProgressBar *mJobBar;
 #endif
 
@@ -89,9 +90,9 @@ class StatusWindow : public Window
         VertContainer *mDAttrCont;
         ScrollArea *mDAttrScroll;
 
-        gcn::Label *mCharacterPointsLabel;
+        Label *mCharacterPointsLabel;
 #ifdef TMWSERV_SUPPORT
-        gcn::Label *mCorrectionPointsLabel;
+        Label *mCorrectionPointsLabel;
 #endif
 
         typedef std::map<int, AttrDisplay*> Attrs;
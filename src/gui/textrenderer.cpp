@@ -0,0 +1,299 @@
+/*
+ *  Text Renderer
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "gui/textrenderer.h"
+
+#include "gui/truetypefont.h"
+
+#include "game.h"
+
+#include "resources/image.h"
+
+#include <algorithm>
+#include <map>
+
+/**
+ * The number of composed text images kept in the cache.
+ */
+static const unsigned int MAX_CACHED_TEXTS = 256;
+
+/**
+ * The room around the text that is taken by the outline and the shadow.
+ */
+static const int PADDING_BEFORE = 1;
+static const int PADDING_AFTER = 2;
+
+namespace {
+
+    /**
+     * Identifies a composed text image.
+     */
+    struct TextKey
+    {
+        std::string text;
+        const TrueTypeFont *font;
+        Uint32 fill;            /**< Fill color and alpha */
+        Uint32 outline;         /**< Outline color, 0 without outline */
+        Uint32 shadow;          /**< Shadow color, 0 without shadow */
+        int effects;
+
+        bool operator<(const TextKey &other) const
+        {
+            if (font != other.font)
+                return font < other.font;
+            if (fill != other.fill)
+                return fill < other.fill;
+            if (outline != other.outline)
+                return outline < other.outline;
+            if (shadow != other.shadow)
+                return shadow < other.shadow;
+            if (effects != other.effects)
+                return effects < other.effects;
+            return text < other.text;
+        }
+    };
+
+    struct CachedText
+    {
+        Image *image;           /**< NULL when it couldn't be created */
+        int lastUsed;           /**< Tick time the image was last drawn */
+    };
+
+    typedef std::map<TextKey, CachedText> TextCache;
+    TextCache textCache;
+
+    Uint32 packColor(const gcn::Color &color, int alpha)
+    {
+        return (color.r << 24) | (color.g << 16) | (color.b << 8) | alpha;
+    }
+
+    /**
+     * Frees the least recently drawn image, unless it has been drawn during
+     * the current tick, since then it may still be waiting to be drawn.
+     */
+    void freeOldestText()
+    {
+        TextCache::iterator oldest = textCache.end();
+        for (TextCache::iterator i = textCache.begin();
+             i != textCache.end(); ++i)
+        {
+            if (oldest == textCache.end() ||
+                i->second.lastUsed < oldest->second.lastUsed)
+                oldest = i;
+        }
+
+        if (oldest == textCache.end() || oldest->second.lastUsed == tick_time)
+            return;
+
+        delete oldest->second.image;
+        textCache.erase(oldest);
+    }
+
+} // namespace
+
+void TextRenderer::renderText(gcn::Graphics *graphics,
+                              const std::string &text,
+                              int x, int y,
+                              gcn::Graphics::Alignment align,
+                              const gcn::Color &color,
+                              gcn::Font *font,
+                              bool outline, bool shadow, int alpha)
+{
+    Graphics *g = dynamic_cast<Graphics*>(graphics);
+    TrueTypeFont *ttf = dynamic_cast<TrueTypeFont*>(font);
+
+    // Plain text is already drawn in one pass, and animated colors would
+    // compose a new image every frame
+    if (!g || !ttf || (!outline && !shadow) || alpha <= 0 ||
+        guiPalette->isAnimated(color) ||
+        (outline && guiPalette->isAnimated(Palette::OUTLINE)) ||
+        (shadow && guiPalette->isAnimated(Palette::SHADOW)))
+    {
+        drawText(graphics, text, x, y, align, color, font,
+                 outline, shadow, alpha);
+        return;
+    }
+
+    // The fill is drawn with its own alpha when drawing the text several
+    // times, so it's kept relative to the alpha of the whole text
+    const int fillAlpha = std::min(255, color.a * 255 / alpha);
+
+    Image *image = getTextImage(text, color, ttf, outline, shadow, fillAlpha);
+    if (!image)
+    {
+        drawText(graphics, text, x, y, align, color, font,
+                 outline, shadow, alpha);
+        return;
+    }
+
+    switch (align)
+    {
+        case gcn::Graphics::LEFT:
+            break;
+        case gcn::Graphics::CENTER:
+            x -= ttf->getWidth(text) / 2;
+            break;
+        case gcn::Graphics::RIGHT:
+            x -= ttf->getWidth(text);
+            break;
+    }
+
+    g->drawImage(image, x - PADDING_BEFORE, y - PADDING_BEFORE,
+                 alpha / 255.0f);
+}
+
+void TextRenderer::clearCache()
+{
+    for (TextCache::iterator i = textCache.begin(); i != textCache.end(); ++i)
+        delete i->second.image;
+
+    textCache.clear();
+}
+
+void TextRenderer::drawText(gcn::Graphics *graphics,
+                            const std::string &text,
+                            int x, int y,
+                            gcn::Graphics::Alignment align,
+                            const gcn::Color &color,
+                            gcn::Font *font,
+                            bool outline, bool shadow, int alpha)
+{
+    graphics->setFont(font);
+
+    // Text shadow
+    if (shadow)
+    {
+        graphics->setColor(guiPalette->getColor(Palette::SHADOW,
+                                                alpha / 2));
+        if (outline)
+        {
+            graphics->drawText(text, x + 2, y + 2, align);
+        }
+        else
+        {
+            graphics->drawText(text, x + 1, y + 1, align);
+        }
+    }
+
+    if (outline) {
+/*        graphics->setColor(guiPalette->getColor(Palette::OUTLINE,
+                alpha/4));
+        // TODO: Reanable when we can draw it nicely in software mode
+        graphics->drawText(text, x + 2, y + 2, align);
+        graphics->drawText(text, x + 1, y + 2, align);
+        graphics->drawText(text, x + 2, y + 1, align);*/
+
+        // Text outline
+        graphics->setColor(guiPalette->getColor(Palette::OUTLINE, alpha));
+        graphics->drawText(text, x + 1, y, align);
+        graphics->drawText(text, x - 1, y, align);
+        graphics->drawText(text, x, y + 1, align);
+        graphics->drawText(text, x, y - 1, align);
+    }
+
+    graphics->setColor(color);
+    graphics->drawText(text, x, y, align);
+}
+
+Image *TextRenderer::getTextImage(const std::string &text,
+                                  const gcn::Color &color,
+                                  TrueTypeFont *font,
+                                  bool outline, bool shadow, int fillAlpha)
+{
+    const gcn::Color &outlineColor = guiPalette->getColor(Palette::OUTLINE);
+    const gcn::Color &shadowColor = guiPalette->getColor(Palette::SHADOW);
+
+    TextKey key;
+    key.text = text;
+    key.font = font;
+    key.fill = packColor(color, fillAlpha);
+    key.outline = outline ? packColor(outlineColor, 255) : 0;
+    key.shadow = shadow ? packColor(shadowColor, 255) : 0;
+    key.effects = (outline ? 1 : 0) | (shadow ? 2 : 0);
+
+    TextCache::iterator i = textCache.find(key);
+    if (i != textCache.end())
+    {
+        i->second.lastUsed = tick_time;
+        return i->second.image;
+    }
+
+    if (textCache.size() >= MAX_CACHED_TEXTS)
+        freeOldestText();
+
+    CachedText &cached = textCache[key];
+    cached.image = 0;
+    cached.lastUsed = tick_time;
+
+    const int width = font->getWidth(text) + PADDING_BEFORE + PADDING_AFTER;
+    const int height = font->getHeight() + PADDING_BEFORE + PADDING_AFTER;
+
+    Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0xff000000;
+    gmask = 0x00ff0000;
+    bmask = 0x0000ff00;
+    amask = 0x000000ff;
+#else
+    rmask = 0x000000ff;
+    gmask = 0x0000ff00;
+    bmask = 0x00ff0000;
+    amask = 0xff000000;
+#endif
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                                32, rmask, gmask, bmask, amask);
+    if (!surface)
+        return 0;
+
+    SDL_FillRect(surface, NULL, 0);
+
+    // The layers are composed in the order they used to be drawn in, with
+    // the shadow at half the opacity of the text
+    const int x = PADDING_BEFORE;
+    const int y = PADDING_BEFORE;
+
+    if (shadow)
+    {
+        const int offset = outline ? 2 : 1;
+        font->blendString(surface, text, x + offset, y + offset,
+                          gcn::Color(shadowColor.r, shadowColor.g,
+                                     shadowColor.b, 127));
+    }
+
+    if (outline)
+    {
+        const gcn::Color col(outlineColor.r, outlineColor.g,
+                             outlineColor.b, 255);
+        font->blendString(surface, text, x + 1, y, col);
+        font->blendString(surface, text, x - 1, y, col);
+        font->blendString(surface, text, x, y + 1, col);
+        font->blendString(surface, text, x, y - 1, col);
+    }
+
+    font->blendString(surface, text, x, y,
+                      gcn::Color(color.r, color.g, color.b, fillAlpha));
+
+    cached.image = Image::load(surface);
+    SDL_FreeSurface(surface);
+
+    return cached.image;
+}
@@ -25,9 +25,16 @@
 #include "graphics.h"
 #include "palette.h"
 
+class Image;
+class TrueTypeFont;
+
 /**
  * Class for text rendering. Used by the TextParticle, the Text and FlashText
  * objects and the Preview in the color dialog.
+ *
+ * Text drawn with an outline or shadow in a TrueType font is composed into a
+ * single image once, which is kept in a cache and drawn with a single blit
+ * afterwards instead of up to six text draws per frame.
  */
 class TextRenderer
 {
@@ -35,51 +42,41 @@ class TextRenderer
     /**
      * Renders a specified text.
      */
-    static inline void renderText(gcn::Graphics *graphics,
-                                  const std::string &text,
-                                  int x, int y,
-                                  gcn::Graphics::Alignment align,
-                                  const gcn::Color &color,
-                                  gcn::Font *font,
-                                  bool outline = false,
-                                  bool shadow = false, int alpha = 255)
-    {
-        graphics->setFont(font);
-
-        // Text shadow
-        if (shadow)
-        {
-            graphics->setColor(guiPalette->getColor(Palette::SHADOW,
-                                                    alpha / 2));
-            if (outline)
-            {
-                graphics->drawText(text, x + 2, y + 2, align);
-            }
-            else
-            {
-                graphics->drawText(text, x + 1, y + 1, align);
-            }
-        }
+    static void renderText(gcn::Graphics *graphics,
+                           const std::string &text,
+                           int x, int y,
+                           gcn::Graphics::Alignment align,
+                           const gcn::Color &color,
+                           gcn::Font *font,
+                           bool outline = false,
+                           bool shadow = false, int alpha = 255);
 
-        if (outline) {
-/*            graphics->setColor(guiPalette->getColor(Palette::OUTLINE,
-                    alpha/4));
-            // TODO: Reanable when we can draw it nicely in software mode
-            graphics->drawText(text, x + 2, y + 2, align);
-            graphics->drawText(text, x + 1, y + 2, align);
-            graphics->drawText(text, x + 2, y + 1, align);*/
+    /**
+     * Frees the cached text images. Needs to be called when the fonts are
+     * deleted, and is called when the palette colors change.
+     */
+    static void clearCache();
 
-            // Text outline
-            graphics->setColor(guiPalette->getColor(Palette::OUTLINE, alpha));
-            graphics->drawText(text, x + 1, y, align);
-            graphics->drawText(text, x - 1, y, align);
-            graphics->drawText(text, x, y + 1, align);
-            graphics->drawText(text, x, y - 1, align);
-        }
+    private:
+    /**
+     * Renders the text with its effects by drawing it several times.
+     */
+    static void drawText(gcn::Graphics *graphics,
+                         const std::string &text,
+                         int x, int y,
+                         gcn::Graphics::Alignment align,
+                         const gcn::Color &color,
+                         gcn::Font *font,
+                         bool outline, bool shadow, int alpha);
 
-        graphics->setColor(color);
-        graphics->drawText(text, x, y, align);
-    }
+    /**
+     * Returns the image of the text with its effects, composing it when it
+     * isn't cached. Returns NULL when the image can't be created.
+     */
+    static Image *getTextImage(const std::string &text,
+                               const gcn::Color &color,
+                               TrueTypeFont *font,
+                               bool outline, bool shadow, int fillAlpha);
 };
 
 #endif
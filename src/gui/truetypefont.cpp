@@ -21,62 +21,103 @@
 
 #include "gui/truetypefont.h"
 
+#include "gui/palette.h"
+
 #include "graphics.h"
 #include "resources/image.h"
 
 #include <guichan/exception.hpp>
 
-#define CACHE_SIZE 256
-
-class TextChunk
-{
-    public:
-        TextChunk(const std::string &text, const gcn::Color &color) :
-            img(NULL), text(text), color(color)
-        {
-        }
+#include <algorithm>
 
-        ~TextChunk()
-        {
-            delete img;
-        }
+/**
+ * The size of the glyph pages in pixels.
+ */
+static const int PAGE_SIZE = 256;
 
-        bool operator==(const TextChunk &chunk) const
-        {
-            return (chunk.text == text && chunk.color == color);
-        }
+/**
+ * The number of colored copies of a glyph page kept around with SDL.
+ */
+static const unsigned int MAX_COLORED_PAGES = 16;
 
-        void generate(TTF_Font *font)
-        {
-            SDL_Color sdlCol;
-            sdlCol.b = color.b;
-            sdlCol.r = color.r;
-            sdlCol.g = color.g;
+/**
+ * The number of replaced page images kept around until they are freed.
+ */
+static const unsigned int MAX_RETIRED_IMAGES = 8;
 
-            SDL_Surface *surface = TTF_RenderUTF8_Blended(
-                    font, text.c_str(), sdlCol);
+/**
+ * The number of strings composed in animated colors kept around with SDL.
+ */
+static const unsigned int MAX_COMPOSED_STRINGS = 64;
 
-            if (!surface)
-            {
-                throw "Rendering font to surface failed: " +
-                    std::string(TTF_GetError());
-            }
+/**
+ * Replaces the color of the pixels of the given 32-bit surface, keeping their
+ * alpha.
+ */
+static void setSurfaceColor(SDL_Surface *surface, Uint32 rgb)
+{
+    const Uint32 colorMask = SDL_MapRGBA(surface->format,
+                                         (rgb >> 16) & 0xff,
+                                         (rgb >> 8) & 0xff,
+                                         rgb & 0xff, 0);
+    const Uint32 alphaMask = surface->format->Amask;
+
+    SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h; y++)
+    {
+        Uint32 *row = (Uint32*) ((Uint8*) surface->pixels +
+                                 y * surface->pitch);
+        for (int x = 0; x < surface->w; x++)
+            row[x] = (row[x] & alphaMask) | colorMask;
+    }
+    SDL_UnlockSurface(surface);
+}
 
-            img = Image::load(surface);
+/**
+ * Decodes the UTF-8 character at the given position and moves the position
+ * past it. Characters outside of the basic multilingual plane and invalid
+ * sequences are replaced with a question mark.
+ */
+static Uint16 nextCharacter(const std::string &text, std::string::size_type &pos)
+{
+    const unsigned char c = text[pos++];
 
-            SDL_FreeSurface(surface);
-        }
+    int length;
+    Uint32 ch;
+    if (c < 0x80)
+        return c;
+    else if ((c & 0xE0) == 0xC0)
+    {
+        length = 1;
+        ch = c & 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        length = 2;
+        ch = c & 0x0F;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        length = 3;
+        ch = c & 0x07;
+    }
+    else
+        return '?';
 
-        Image *img;
-        std::string text;
-        gcn::Color color;
-};
+    for (int i = 0; i < length; i++)
+    {
+        if (pos >= text.length() || (text[pos] & 0xC0) != 0x80)
+            return '?';
+        ch = (ch << 6) | (text[pos++] & 0x3F);
+    }
 
-typedef std::list<TextChunk>::iterator CacheIterator;
+    return ch > 0xFFFF ? '?' : (Uint16) ch;
+}
 
 static int fontCounter;
 
-TrueTypeFont::TrueTypeFont(const std::string &filename, int size, int style)
+TrueTypeFont::TrueTypeFont(const std::string &filename, int size, int style):
+    mComposedUses(0)
 {
     if (fontCounter == 0 && TTF_Init() == -1)
     {
@@ -94,10 +135,30 @@ TrueTypeFont::TrueTypeFont(const std::string &filename, int size, int style)
     }
 
     TTF_SetFontStyle(mFont, style);
+
+    // Render the printable ASCII characters up front, so that they end up
+    // on the first page
+    for (Uint16 ch = 32; ch < 127; ch++)
+        getGlyph(ch);
 }
 
 TrueTypeFont::~TrueTypeFont()
 {
+    for (std::vector<GlyphPage>::iterator i = mPages.begin();
+         i != mPages.end(); ++i)
+    {
+        retirePageImages(*i);
+        SDL_FreeSurface(i->surface);
+    }
+
+    for (std::vector<Image*>::iterator i = mRetiredImages.begin();
+         i != mRetiredImages.end(); ++i)
+        delete *i;
+
+    for (ComposedStrings::iterator i = mComposedStrings.begin();
+         i != mComposedStrings.end(); ++i)
+        delete i->second.image;
+
     TTF_CloseFont(mFont);
     --fontCounter;
 
@@ -121,52 +182,385 @@ void TrueTypeFont::drawString(gcn::Graphics *graphics,
         throw "Not a valid graphics object!";
     }
 
-    gcn::Color col = g->getColor();
+    const gcn::Color col = g->getColor();
     const float alpha = col.a / 255.0f;
 
-    /* The alpha value is ignored at string generation so avoid caching the
-     * same text with different alpha values.
-     */
-    col.a = 255;
-
-    TextChunk chunk(text, col);
+    // Animated colors change every frame, so colored copies of the pages
+    // would be made and thrown away all the time
+    bool composed = guiPalette && guiPalette->isAnimated(col) &&
+                    !(col.r == 255 && col.g == 255 && col.b == 255);
+#ifdef USE_OPENGL
+    if (Image::getLoadAsOpenGL())
+        composed = false;
+#endif
 
-    bool found = false;
+    if (composed)
+    {
+        drawComposedString(g, text, x, y, col);
+        return;
+    }
 
-    for (CacheIterator i = mCache.begin(); i != mCache.end(); ++i)
+    std::string::size_type pos = 0;
+    while (pos < text.length())
     {
-        if (chunk == (*i))
+        const Glyph &glyph = getGlyph(nextCharacter(text, pos));
+
+        if (glyph.page >= 0)
         {
-            // Raise priority: move it to front
-            mCache.splice(mCache.begin(), mCache, i);
-            found = true;
-            break;
+            Image *image = getPageImage(mPages[glyph.page], col);
+            g->drawImage(image, glyph.x, glyph.y,
+                         x + glyph.offsetX, y + glyph.offsetY,
+                         glyph.width, glyph.height, true, alpha);
         }
+
+        x += glyph.advance;
     }
+}
+
+void TrueTypeFont::blendString(SDL_Surface *target, const std::string &text,
+                               int x, int y, const gcn::Color &color) const
+{
+    SDL_LockSurface(target);
 
-    // Surface not found
-    if (!found)
+    std::string::size_type pos = 0;
+    while (pos < text.length())
     {
-        if (mCache.size() >= CACHE_SIZE)
+        const Glyph &glyph = getGlyph(nextCharacter(text, pos));
+
+        if (glyph.page < 0)
         {
-            mCache.pop_back();
+            x += glyph.advance;
+            continue;
         }
-        mCache.push_front(chunk);
-        mCache.front().generate(mFont);
+
+        const SDL_Surface *page = mPages[glyph.page].surface;
+        const int dstX = x + glyph.offsetX;
+        const int dstY = y + glyph.offsetY;
+
+        const int startX = std::max(0, -dstX);
+        const int startY = std::max(0, -dstY);
+        const int endX = std::min(glyph.width, target->w - dstX);
+        const int endY = std::min(glyph.height, target->h - dstY);
+
+        for (int gy = startY; gy < endY; gy++)
+        {
+            const Uint32 *src = (const Uint32*) ((const Uint8*) page->pixels +
+                    (glyph.y + gy) * page->pitch) + glyph.x;
+            Uint32 *dst = (Uint32*) ((Uint8*) target->pixels +
+                    (dstY + gy) * target->pitch) + dstX;
+
+            for (int gx = startX; gx < endX; gx++)
+            {
+                // The glyphs are white, so only their alpha matters
+                const int sa = ((src[gx] & page->format->Amask) >>
+                                page->format->Ashift) * color.a / 255;
+                if (sa == 0)
+                    continue;
+
+                Uint8 r, g, b, a;
+                SDL_GetRGBA(dst[gx], target->format, &r, &g, &b, &a);
+
+                // Porter-Duff over, with straight alpha
+                const int da = a * (255 - sa) / 255;
+                const int oa = sa + da;
+                dst[gx] = SDL_MapRGBA(target->format,
+                                      (color.r * sa + r * da) / oa,
+                                      (color.g * sa + g * da) / oa,
+                                      (color.b * sa + b * da) / oa,
+                                      oa);
+            }
+        }
+
+        x += glyph.advance;
     }
 
-    mCache.front().img->setAlpha(alpha);
-    g->drawImage(mCache.front().img, x, y);
+    SDL_UnlockSurface(target);
 }
 
 int TrueTypeFont::getWidth(const std::string &text) const
 {
-    int w, h;
-    TTF_SizeUTF8(mFont, text.c_str(), &w, &h);
-    return w;
+    int width = 0;
+
+    std::string::size_type pos = 0;
+    while (pos < text.length())
+        width += getGlyph(nextCharacter(text, pos)).advance;
+
+    return width;
 }
 
 int TrueTypeFont::getHeight() const
 {
     return TTF_FontHeight(mFont);
 }
+
+const TrueTypeFont::Glyph &TrueTypeFont::getGlyph(Uint16 ch) const
+{
+    std::map<Uint16, Glyph>::const_iterator i = mGlyphs.find(ch);
+    if (i != mGlyphs.end())
+        return i->second;
+
+    Glyph &glyph = mGlyphs[ch];
+    glyph.page = -1;
+    glyph.x = glyph.y = 0;
+    glyph.width = glyph.height = 0;
+    glyph.offsetX = glyph.offsetY = 0;
+    glyph.advance = 0;
+
+    int minX, maxX, minY, maxY;
+    if (TTF_GlyphMetrics(mFont, ch, &minX, &maxX, &minY, &maxY,
+                         &glyph.advance) == -1)
+        return glyph;
+
+    SDL_Color white;
+    white.r = white.g = white.b = 255;
+    SDL_Surface *surface = TTF_RenderGlyph_Blended(mFont, ch, white);
+    if (!surface)
+        return glyph;
+
+    // Glyphs that are too big to fit on a page are left empty
+    if (surface->w == 0 || surface->h == 0 ||
+        surface->w > PAGE_SIZE || surface->h > PAGE_SIZE)
+    {
+        SDL_FreeSurface(surface);
+        return glyph;
+    }
+
+    // Find room on the last page, either on its current shelf or on a new
+    // one, or start a new page
+    bool fits = false;
+    if (!mPages.empty())
+    {
+        const GlyphPage &last = mPages.back();
+        fits = (last.shelfX + surface->w <= PAGE_SIZE &&
+                last.shelfY + surface->h <= PAGE_SIZE) ||
+               last.shelfY + last.shelfHeight + surface->h <= PAGE_SIZE;
+    }
+
+    if (!fits)
+    {
+        Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        rmask = 0xff000000;
+        gmask = 0x00ff0000;
+        bmask = 0x0000ff00;
+        amask = 0x000000ff;
+#else
+        rmask = 0x000000ff;
+        gmask = 0x0000ff00;
+        bmask = 0x00ff0000;
+        amask = 0xff000000;
+#endif
+
+        GlyphPage page;
+        page.surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+                                            PAGE_SIZE, PAGE_SIZE, 32,
+                                            rmask, gmask, bmask, amask);
+        page.image = 0;
+        page.shelfX = page.shelfY = page.shelfHeight = 0;
+
+        if (!page.surface)
+        {
+            SDL_FreeSurface(surface);
+            return glyph;
+        }
+
+        SDL_FillRect(page.surface, NULL, 0);
+        mPages.push_back(page);
+    }
+
+    GlyphPage &page = mPages.back();
+    if (page.shelfX + surface->w > PAGE_SIZE ||
+        page.shelfY + surface->h > PAGE_SIZE)
+    {
+        page.shelfX = 0;
+        page.shelfY += page.shelfHeight;
+        page.shelfHeight = 0;
+    }
+
+    // Copy the glyph including its alpha channel
+    SDL_SetAlpha(surface, 0, SDL_ALPHA_OPAQUE);
+    SDL_Rect dst;
+    dst.x = page.shelfX;
+    dst.y = page.shelfY;
+    SDL_BlitSurface(surface, NULL, page.surface, &dst);
+    addToPageImages(page, surface, page.shelfX, page.shelfY);
+
+    glyph.page = mPages.size() - 1;
+    glyph.x = page.shelfX;
+    glyph.y = page.shelfY;
+    glyph.width = surface->w;
+    glyph.height = surface->h;
+    glyph.offsetX = minX;
+    glyph.offsetY = TTF_FontAscent(mFont) - maxY;
+
+    page.shelfX += surface->w;
+    page.shelfHeight = std::max(page.shelfHeight, surface->h);
+
+    SDL_FreeSurface(surface);
+
+    return glyph;
+}
+
+void TrueTypeFont::drawComposedString(Graphics *graphics,
+                                      const std::string &text,
+                                      int x, int y,
+                                      const gcn::Color &color) const
+{
+    const ComposedKey key(text, (color.r << 16) | (color.g << 8) | color.b);
+    ComposedStrings::iterator i = mComposedStrings.find(key);
+    if (i != mComposedStrings.end())
+    {
+        i->second.lastUsed = ++mComposedUses;
+        graphics->drawImage(i->second.image, x, y, color.a / 255.0f);
+        return;
+    }
+
+    Image *image = composeString(text, color);
+    if (!image)
+        return;
+
+    // Forget the least recently drawn string to make room
+    if (mComposedStrings.size() >= MAX_COMPOSED_STRINGS)
+    {
+        ComposedStrings::iterator oldest = mComposedStrings.begin();
+        for (i = mComposedStrings.begin(); i != mComposedStrings.end(); ++i)
+        {
+            if (i->second.lastUsed < oldest->second.lastUsed)
+                oldest = i;
+        }
+
+        // The blits hold on to the surface when they are only recorded, so
+        // the image can be freed right away
+        delete oldest->second.image;
+        mComposedStrings.erase(oldest);
+    }
+
+    ComposedString &composed = mComposedStrings[key];
+    composed.image = image;
+    composed.lastUsed = ++mComposedUses;
+
+    graphics->drawImage(image, x, y, color.a / 255.0f);
+}
+
+Image *TrueTypeFont::composeString(const std::string &text,
+                                   const gcn::Color &color) const
+{
+    const int width = getWidth(text);
+    const int height = getHeight();
+    if (width <= 0 || height <= 0)
+        return 0;
+
+    Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0xff000000;
+    gmask = 0x00ff0000;
+    bmask = 0x0000ff00;
+    amask = 0x000000ff;
+#else
+    rmask = 0x000000ff;
+    gmask = 0x0000ff00;
+    bmask = 0x00ff0000;
+    amask = 0xff000000;
+#endif
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                                32, rmask, gmask, bmask, amask);
+    if (!surface)
+        return 0;
+
+    SDL_FillRect(surface, NULL, 0);
+    blendString(surface, text, 0, 0,
+                gcn::Color(color.r, color.g, color.b, 255));
+
+    Image *image = Image::load(surface);
+    SDL_FreeSurface(surface);
+
+    return image;
+}
+
+Image *TrueTypeFont::getPageImage(GlyphPage &page, const gcn::Color &color)
+{
+    if (!page.image)
+        page.image = Image::load(page.surface);
+
+#ifdef USE_OPENGL
+    // OpenGL colors the white glyphs when drawing them
+    if (Image::getLoadAsOpenGL())
+        return page.image;
+#endif
+
+    if (color.r == 255 && color.g == 255 && color.b == 255)
+        return page.image;
+
+    const Uint32 key = (color.r << 16) | (color.g << 8) | color.b;
+    std::map<Uint32, Image*>::iterator i = page.colored.find(key);
+    if (i != page.colored.end())
+        return i->second;
+
+    if (page.colored.size() >= MAX_COLORED_PAGES)
+    {
+        for (i = page.colored.begin(); i != page.colored.end(); ++i)
+            mRetiredImages.push_back(i->second);
+        page.colored.clear();
+    }
+
+    // Make a copy of the page with the color of the glyphs replaced
+    SDL_Surface *surface = SDL_ConvertSurface(page.surface,
+                                              page.surface->format,
+                                              SDL_SWSURFACE);
+    if (!surface)
+        return page.image;
+
+    setSurfaceColor(surface, key);
+
+    Image *image = Image::load(surface);
+    SDL_FreeSurface(surface);
+
+    page.colored[key] = image;
+    return image;
+}
+
+void TrueTypeFont::addToPageImages(GlyphPage &page, SDL_Surface *glyph,
+                                   int x, int y) const
+{
+    bool updated = !page.image || page.image->update(glyph, x, y);
+
+    for (std::map<Uint32, Image*>::iterator i = page.colored.begin();
+         updated && i != page.colored.end(); ++i)
+    {
+        SDL_Surface *colored = SDL_ConvertSurface(glyph, page.surface->format,
+                                                  SDL_SWSURFACE);
+        if (!colored)
+        {
+            updated = false;
+            break;
+        }
+
+        setSurfaceColor(colored, i->first);
+        updated = i->second->update(colored, x, y);
+        SDL_FreeSurface(colored);
+    }
+
+    // Images that couldn't be updated are made again when needed
+    if (!updated)
+        retirePageImages(page);
+}
+
+void TrueTypeFont::retirePageImages(GlyphPage &page) const
+{
+    if (page.image)
+        mRetiredImages.push_back(page.image);
+
+    for (std::map<Uint32, Image*>::iterator i = page.colored.begin();
+         i != page.colored.end(); ++i)
+        mRetiredImages.push_back(i->second);
+
+    page.image = 0;
+    page.colored.clear();
+
+    while (mRetiredImages.size() > MAX_RETIRED_IMAGES)
+    {
+        delete mRetiredImages.front();
+        mRetiredImages.erase(mRetiredImages.begin());
+    }
+}
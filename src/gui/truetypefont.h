@@ -22,8 +22,9 @@
 #ifndef TRUETYPEFONT_H
 #define TRUETYPEFONT_H
 
-#include <list>
+#include <map>
 #include <string>
+#include <vector>
 
 #include <guichan/font.hpp>
 #ifdef __APPLE__
@@ -36,11 +37,18 @@
 #endif
 #endif
 
-class TextChunk;
+class Graphics;
+class Image;
 
 /**
  * A wrapper around SDL_ttf for allowing the use of TrueType fonts.
  *
+ * Each character is rendered once in white into a glyph page, and strings
+ * are drawn as runs of glyphs from these pages, colored when drawn. The
+ * glyphs are placed by their advance only. Kerning is not supported, since
+ * the SDL_ttf versions for SDL 1.2 can't tell the kerning between two
+ * characters.
+ *
  * <b>NOTE:</b> This class initializes SDL_ttf as necessary.
  */
 class TrueTypeFont : public gcn::Font
@@ -70,11 +78,98 @@ class TrueTypeFont : public gcn::Font
                         const std::string &text,
                         int x, int y);
 
+        /**
+         * Blends the given text in the given color onto a 32-bit surface with
+         * an alpha channel. Used to compose text images with effects.
+         */
+        void blendString(SDL_Surface *target, const std::string &text,
+                         int x, int y, const gcn::Color &color) const;
+
     private:
+        /**
+         * A character rendered into one of the glyph pages.
+         */
+        struct Glyph
+        {
+            int page;               /**< Index of the page, -1 if empty */
+            int x, y;               /**< Position on the page */
+            int width, height;
+            int offsetX, offsetY;   /**< Offset from the pen position */
+            int advance;            /**< Distance to the next character */
+        };
+
+        /**
+         * An image holding rendered glyphs in white. With SDL, the glyphs
+         * can't be colored when drawn, so colored copies are kept as well.
+         */
+        struct GlyphPage
+        {
+            SDL_Surface *surface;   /**< The glyphs rendered so far */
+            Image *image;           /**< NULL until first drawn */
+            std::map<Uint32, Image*> colored;
+            int shelfX, shelfY;     /**< Where the next glyph goes */
+            int shelfHeight;
+        };
+
+        /**
+         * Returns the glyph of the given character, rendering it when it
+         * wasn't needed before.
+         */
+        const Glyph &getGlyph(Uint16 ch) const;
+
+        /**
+         * A string composed into an image of its own.
+         */
+        struct ComposedString
+        {
+            Image *image;
+            int lastUsed;
+        };
+
+        typedef std::pair<std::string, Uint32> ComposedKey;
+        typedef std::map<ComposedKey, ComposedString> ComposedStrings;
+
+        /**
+         * Draws the given text from an image of its own, composed when the
+         * text is first drawn in the given color. Used with SDL for colors
+         * that change every frame, for which colored copies of the pages
+         * would be replaced all the time.
+         */
+        void drawComposedString(Graphics *graphics, const std::string &text,
+                                int x, int y, const gcn::Color &color) const;
+
+        /**
+         * Composes the given text in the given color into a new image.
+         */
+        Image *composeString(const std::string &text,
+                             const gcn::Color &color) const;
+
+        /**
+         * Returns the image of the given page to draw it in the given color.
+         */
+        Image *getPageImage(GlyphPage &page, const gcn::Color &color);
+
+        /**
+         * Adds the given glyph, just copied onto the surface of the page, to
+         * the images of the page. Images that can't be updated in place are
+         * retired.
+         */
+        void addToPageImages(GlyphPage &page, SDL_Surface *glyph,
+                             int x, int y) const;
+
+        /**
+         * Frees the images of the given page. They are kept around for a few
+         * more updates, since draws using them may not have been done yet.
+         */
+        void retirePageImages(GlyphPage &page) const;
+
         TTF_Font *mFont;
 
-        // Word surfaces cache
-        std::list<TextChunk> mCache;
+        mutable std::map<Uint16, Glyph> mGlyphs;
+        mutable std::vector<GlyphPage> mPages;
+        mutable std::vector<Image*> mRetiredImages;
+        mutable ComposedStrings mComposedStrings;
+        mutable int mComposedUses;  /**< Counter telling the last used string */
 };
 
 #endif
@@ -40,12 +40,14 @@
 #include "resources/monsterinfo.h"
 #include "resources/resourcemanager.h"
 
+#include "utils/gettext.h"
 #include "utils/stringutils.h"
 
 extern volatile int tick_time;
 
 Viewport::Viewport():
     mMap(0),
+    mLoadingProgress(-1.0f),
     mMouseX(0),
     mMouseY(0),
     mPixelViewX(0.0f),
@@ -87,19 +89,57 @@ Viewport::~Viewport()
 void Viewport::setMap(Map *map)
 {
     mMap = map;
+    requestRedraw();
+}
+
+void Viewport::scrollBy(float x, float y)
+{
+    mPixelViewX += x;
+    mPixelViewY += y;
+    requestRedraw();
+}
+
+void Viewport::setLoadingProgress(float progress)
+{
+    if (progress == mLoadingProgress)
+        return;
+
+    mLoadingProgress = progress;
+    requestRedraw();
 }
 
 extern MiniStatusWindow *miniStatusWindow;
 
 void Viewport::draw(gcn::Graphics *gcnGraphics)
 {
-    static int lastTick = tick_time;
-
     if (!mMap || !player_node)
     {
         gcnGraphics->setColor(gcn::Color(64, 64, 64));
         gcnGraphics->fillRectangle(
                 gcn::Rectangle(0, 0, getWidth(), getHeight()));
+
+        if (mLoadingProgress >= 0.0f)
+        {
+            const int barWidth = 200;
+            const int barHeight = 8;
+            const int x = (getWidth() - barWidth) / 2;
+            const int y = getHeight() / 2;
+
+            gcnGraphics->setFont(boldFont);
+            gcnGraphics->setColor(gcn::Color(255, 255, 255));
+            gcnGraphics->drawText(_("Loading map..."), getWidth() / 2,
+                                  y - boldFont->getHeight() - 4,
+                                  gcn::Graphics::CENTER);
+
+            gcnGraphics->setColor(gcn::Color(32, 32, 32));
+            gcnGraphics->fillRectangle(
+                    gcn::Rectangle(x, y, barWidth, barHeight));
+            gcnGraphics->setColor(gcn::Color(200, 200, 200));
+            gcnGraphics->fillRectangle(
+                    gcn::Rectangle(x, y,
+                                   (int) (barWidth * mLoadingProgress),
+                                   barHeight));
+        }
         return;
     }
 
@@ -109,6 +149,51 @@ void Viewport::draw(gcn::Graphics *gcnGraphics)
     // is dependent on a map.
     player_node->mMapInitialized = true;
 
+    // Draw tiles and sprites
+    if (mMap)
+    {
+        mMap->draw(graphics, (int) mPixelViewX, (int) mPixelViewY);
+
+        if (mShowDebugPath) {
+            mMap->drawCollision(graphics,
+                                (int) mPixelViewX,
+                                (int) mPixelViewY);
+            drawDebugPath(graphics);
+        }
+    }
+
+    if (player_node->mUpdateName)
+    {
+        player_node->mUpdateName = false;
+        player_node->setName(player_node->getName());
+    }
+
+    // Draw text
+    if (textManager)
+    {
+        textManager->draw(graphics, (int) mPixelViewX, (int) mPixelViewY);
+    }
+
+    // Draw player names, speech, and emotion sprite as needed
+    const Beings &beings = beingManager->getAll();
+    for (Beings::const_iterator i = beings.begin(), i_end = beings.end();
+         i != i_end; ++i)
+    {
+        (*i)->drawSpeech((int) mPixelViewX, (int) mPixelViewY);
+        (*i)->drawEmotion(graphics, (int) mPixelViewX, (int) mPixelViewY);
+    }
+
+    if (miniStatusWindow)
+        miniStatusWindow->drawIcons(graphics);
+
+    // Draw contained widgets
+    WindowContainer::draw(gcnGraphics);
+}
+
+void Viewport::updateCamera()
+{
+    static int lastTick = tick_time;
+
     // Avoid freaking out when tick_time overflows
     if (tick_time < lastTick)
     {
@@ -126,6 +211,9 @@ void Viewport::draw(gcn::Graphics *gcnGraphics)
     if (mScrollLaziness < 1)
         mScrollLaziness = 1; // Avoids division by zero
 
+    const int oldViewX = (int) mPixelViewX;
+    const int oldViewY = (int) mPixelViewY;
+
     // Apply lazy scrolling
     while (lastTick < tick_time)
     {
@@ -180,48 +268,12 @@ void Viewport::draw(gcn::Graphics *gcnGraphics)
             mPixelViewY = viewYmax;
     }
 
+    // Scrolling moves everything on the map
+    if ((int) mPixelViewX != oldViewX || (int) mPixelViewY != oldViewY)
+        requestRedraw();
+
     mTileViewX = (int) (mPixelViewX + 16) / 32;
     mTileViewY = (int) (mPixelViewY + 16) / 32;
-
-    // Draw tiles and sprites
-    if (mMap)
-    {
-        mMap->draw(graphics, (int) mPixelViewX, (int) mPixelViewY);
-
-        if (mShowDebugPath) {
-            mMap->drawCollision(graphics,
-                                (int) mPixelViewX,
-                                (int) mPixelViewY);
-            drawDebugPath(graphics);
-        }
-    }
-
-    if (player_node->mUpdateName)
-    {
-        player_node->mUpdateName = false;
-        player_node->setName(player_node->getName());
-    }
-
-    // Draw text
-    if (textManager)
-    {
-        textManager->draw(graphics, (int) mPixelViewX, (int) mPixelViewY);
-    }
-
-    // Draw player names, speech, and emotion sprite as needed
-    const Beings &beings = beingManager->getAll();
-    for (Beings::const_iterator i = beings.begin(), i_end = beings.end();
-         i != i_end; ++i)
-    {
-        (*i)->drawSpeech((int) mPixelViewX, (int) mPixelViewY);
-        (*i)->drawEmotion(graphics, (int) mPixelViewX, (int) mPixelViewY);
-    }
-
-    if (miniStatusWindow)
-        miniStatusWindow->drawIcons(graphics);
-
-    // Draw contained widgets
-    WindowContainer::draw(gcnGraphics);
 }
 
 void Viewport::logic()
@@ -231,6 +283,8 @@ void Viewport::logic()
     if (!mMap || !player_node)
         return;
 
+    updateCamera();
+
 #ifdef EATHENA_SUPPORT
     Uint8 button = SDL_GetMouseState(&mMouseX, &mMouseY);
 
@@ -271,7 +325,7 @@ void Viewport::drawPath(Graphics *graphics, const Path &path)
 
         graphics->fillRectangle(gcn::Rectangle(squareX, squareY, 8, 8));
         graphics->drawText(
-                toString(mMap->getMetaTile(i->x, i->y)->Gcost),
+                toString(mMap->getPathCost(i->x, i->y)),
                 squareX + 4, squareY + 12, gcn::Graphics::CENTER);
     }
 }
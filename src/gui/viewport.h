@@ -67,6 +67,13 @@ class Viewport : public WindowContainer, public gcn::MouseListener,
          */
         void setMap(Map *map);
 
+        /**
+         * Sets how far loading the next map has progressed, between 0 and 1.
+         * A loading indicator is drawn while there is no map and the
+         * progress isn't negative.
+         */
+        void setLoadingProgress(float progress);
+
         /**
          * Draws the viewport.
          */
@@ -142,9 +149,14 @@ class Viewport : public WindowContainer, public gcn::MouseListener,
         /**
          * Changes viewpoint by relative pixel coordinates.
          */
-        void scrollBy(float x, float y) { mPixelViewX += x; mPixelViewY += y; }
+        void scrollBy(float x, float y);
 
     private:
+        /**
+         * Moves the camera towards the player, lazily.
+         */
+        void updateCamera();
+
         /**
          * Finds a path from the player to the mouse, and draws it. This is for
          * debug purposes.
@@ -157,6 +169,7 @@ class Viewport : public WindowContainer, public gcn::MouseListener,
         void drawPath(Graphics *graphics, const Path &path);
 
         Map *mMap;                   /**< The current map. */
+        float mLoadingProgress;      /**< Negative when not loading. */
 
         int mScrollRadius;
         int mScrollLaziness;
@@ -20,6 +20,7 @@
  */
 
 #include "gui/widgets/browserbox.h"
+#include "gui/widgets/window.h"
 
 #include "gui/linkhandler.h"
 #include "gui/palette.h"
@@ -27,15 +28,17 @@
 #include <guichan/graphics.hpp>
 #include <guichan/font.hpp>
 
-#include <algorithm>
-
 BrowserBox::BrowserBox(unsigned int mode, bool opaque):
     gcn::Widget(),
+    mLinkHandler(0),
     mMode(mode), mHighMode(UNDERLINE | BACKGROUND),
     mOpaque(opaque),
     mUseLinksAndUserColors(true),
+    mSelectedRow(-1),
     mSelectedLink(-1),
-    mMaxRows(0)
+    mMaxRows(0),
+    mRowsTop(0),
+    mLayoutWidth(0)
 {
     setFocusable(true);
     addMouseListener(this);
@@ -73,6 +76,9 @@ void BrowserBox::addRow(const std::string &row)
     std::string::size_type idx1, idx2, idx3;
     gcn::Font *font = getFont();
 
+    mTextRows.push_back(TextRow());
+    TextRow &textRow = mTextRows.back();
+
     // Use links and user defined colors
     if (mUseLinksAndUserColors)
     {
@@ -87,23 +93,12 @@ void BrowserBox::addRow(const std::string &row)
                 break;
             bLink.link = tmp.substr(idx1 + 2, idx2 - (idx1 + 2));
             bLink.caption = tmp.substr(idx2 + 1, idx3 - (idx2 + 1));
-            bLink.y1 = mTextRows.size() * font->getHeight();
-            bLink.y2 = bLink.y1 + font->getHeight();
 
-            newRow += tmp.substr(0, idx1);
-
-            std::string tmp2 = newRow;
-            idx1 = tmp2.find("##");
-            while (idx1 != std::string::npos)
-            {
-                tmp2.erase(idx1, 3);
-                idx1 = tmp2.find("##");
-            }
-            bLink.x1 = font->getWidth(tmp2) - 1;
-            bLink.x2 = bLink.x1 + font->getWidth(bLink.caption) + 1;
-
-            mLinks.push_back(bLink);
+            // The position of the link is determined by the layout
+            bLink.x1 = bLink.x2 = bLink.y1 = bLink.y2 = 0;
+            textRow.links.push_back(bLink);
 
+            newRow += tmp.substr(0, idx1);
             newRow += "##<" + bLink.caption;
 
             tmp.erase(0, idx3 + 2);
@@ -122,24 +117,7 @@ void BrowserBox::addRow(const std::string &row)
         newRow = row;
     }
 
-    mTextRows.push_back(newRow);
-
-    //discard older rows when a row limit has been set
-    if (mMaxRows > 0)
-    {
-        while (mTextRows.size() > mMaxRows)
-        {
-            mTextRows.pop_front();
-            for (unsigned int i = 0; i < mLinks.size(); i++)
-            {
-                mLinks[i].y1 -= font->getHeight();
-                mLinks[i].y2 -= font->getHeight();
-
-                if (mLinks[i].y1 < 0)
-                    mLinks.erase(mLinks.begin() + i);
-            }
-        }
-    }
+    textRow.text = newRow;
 
     // Auto size mode
     if (mMode == AUTO_SIZE)
@@ -154,100 +132,83 @@ void BrowserBox::addRow(const std::string &row)
             setWidth(w);
     }
 
-    if (mMode == AUTO_WRAP)
+    // Only the new row needs to be laid out, unless the width changed
+    if (mMode == AUTO_WRAP && mLayoutWidth != getWidth())
     {
-        unsigned int y = 0;
-        unsigned int nextChar;
-        const char *hyphen = "~";
-        int hyphenWidth = font->getWidth(hyphen);
-        int x = 0;
-
-        for (TextRowIterator i = mTextRows.begin(); i != mTextRows.end(); i++)
+        layoutRows();
+    }
+    else
+    {
+        if (mTextRows.size() > 1)
         {
-            std::string row = *i;
-            for (unsigned int j = 0; j < row.size(); j++)
-            {
-                std::string character = row.substr(j, 1);
-                x += font->getWidth(character);
-                nextChar = j + 1;
-
-                // Wraping between words (at blank spaces)
-                if ((nextChar < row.size()) && (row.at(nextChar) == ' '))
-                {
-                    int nextSpacePos = row.find(" ", (nextChar + 1));
-                    if (nextSpacePos <= 0)
-                    {
-                        nextSpacePos = row.size() - 1;
-                    }
-                    int nextWordWidth = font->getWidth(
-                            row.substr(nextChar,
-                                (nextSpacePos - nextChar)));
-
-                    if ((x + nextWordWidth + 10) > getWidth())
-                    {
-                        x = 15; // Ident in new line
-                        y += 1;
-                        j++;
-                    }
-                }
-                // Wrapping looong lines (brutal force)
-                else if ((x + 2 * hyphenWidth) > getWidth())
-                {
-                    x = 15; // Ident in new line
-                    y += 1;
-                }
-            }
+            const TextRow &previous = mTextRows[mTextRows.size() - 2];
+            textRow.y = previous.y + previous.height;
         }
-
-        setHeight(font->getHeight() * (mTextRows.size() + y));
+        else
+        {
+            textRow.y = mRowsTop;
+        }
+        layoutRow(textRow);
     }
-    else
+
+    //discard older rows when a row limit has been set
+    if (mMaxRows > 0)
     {
-        setHeight(font->getHeight() * mTextRows.size());
+        while (mTextRows.size() > mMaxRows)
+        {
+            mTextRows.pop_front();
+            mRowsTop = mTextRows.front().y;
+
+            if (mSelectedRow >= 0 && --mSelectedRow < 0)
+                mSelectedLink = -1;
+        }
     }
+
+    updateHeight();
+    Window::contentChanged(this);
 }
 
 void BrowserBox::clearRows()
 {
     mTextRows.clear();
-    mLinks.clear();
     setWidth(0);
     setHeight(0);
+    mSelectedRow = -1;
     mSelectedLink = -1;
+    mRowsTop = 0;
+    Window::contentChanged(this);
 }
 
-struct MouseOverLink
-{
-    MouseOverLink(int x, int y) : mX(x),mY(y) { }
-    bool operator() (BROWSER_LINK &link)
-    {
-        return (mX >= link.x1 && mX < link.x2 &&
-                mY >= link.y1 && mY < link.y2);
-    }
-    int mX, mY;
-};
-
 void BrowserBox::mousePressed(gcn::MouseEvent &event)
 {
     if (!mLinkHandler) return;
-    LinkIterator i = find_if(mLinks.begin(), mLinks.end(),
-            MouseOverLink(event.getX(), event.getY()));
 
-    if (i != mLinks.end()) {
-        mLinkHandler->handleLink(i->link);
+    int row, link;
+    if (getLinkAt(event.getX(), event.getY(), row, link))
+    {
+        // The handler may change the rows
+        const std::string target = mTextRows[row].links[link].link;
+        mLinkHandler->handleLink(target);
     }
 }
 
 void BrowserBox::mouseMoved(gcn::MouseEvent &event)
 {
-    LinkIterator i = find_if(mLinks.begin(), mLinks.end(),
-            MouseOverLink(event.getX(), event.getY()));
-
-    mSelectedLink = (i != mLinks.end()) ? (i - mLinks.begin()) : -1;
+    if (!getLinkAt(event.getX(), event.getY(), mSelectedRow, mSelectedLink))
+    {
+        mSelectedRow = -1;
+        mSelectedLink = -1;
+    }
 }
 
 void BrowserBox::draw(gcn::Graphics *graphics)
 {
+    if (mMode == AUTO_WRAP && mLayoutWidth != getWidth())
+    {
+        layoutRows();
+        updateHeight();
+    }
+
     if (mOpaque)
     {
         graphics->setColor(guiPalette->getColor(Palette::BACKGROUND));
@@ -256,14 +217,17 @@ void BrowserBox::draw(gcn::Graphics *graphics)
 
     if (mSelectedLink >= 0)
     {
+        const BROWSER_LINK &link = mTextRows[mSelectedRow].links[mSelectedLink];
+        const int rowY = mTextRows[mSelectedRow].y - mRowsTop;
+
         if ((mHighMode & BACKGROUND))
         {
             graphics->setColor(guiPalette->getColor(Palette::HIGHLIGHT));
             graphics->fillRectangle(gcn::Rectangle(
-                        mLinks[mSelectedLink].x1,
-                        mLinks[mSelectedLink].y1,
-                        mLinks[mSelectedLink].x2 - mLinks[mSelectedLink].x1,
-                        mLinks[mSelectedLink].y2 - mLinks[mSelectedLink].y1
+                        link.x1,
+                        rowY + link.y1,
+                        link.x2 - link.x1,
+                        link.y2 - link.y1
                         ));
         }
 
@@ -271,170 +235,276 @@ void BrowserBox::draw(gcn::Graphics *graphics)
         {
             graphics->setColor(guiPalette->getColor(Palette::HYPERLINK));
             graphics->drawLine(
-                    mLinks[mSelectedLink].x1,
-                    mLinks[mSelectedLink].y2,
-                    mLinks[mSelectedLink].x2,
-                    mLinks[mSelectedLink].y2);
+                    link.x1,
+                    rowY + link.y2,
+                    link.x2,
+                    rowY + link.y2);
         }
     }
 
-    int x = 0, y = 0;
-    int wrappedLines = 0;
-    int link = 0;
+    // Only draw the rows that are within the clip area
+    const gcn::ClipRectangle &clip = graphics->getCurrentClipArea();
+    const int top = clip.y - clip.yOffset + mRowsTop;
+    const int bottom = top + clip.height;
+
     gcn::Font *font = getFont();
 
-    graphics->setColor(guiPalette->getColor(Palette::TEXT));
     for (TextRowIterator i = mTextRows.begin(); i != mTextRows.end(); i++)
     {
-        const gcn::Color textColor = guiPalette->getColor(Palette::TEXT);
-        gcn::Color selColor = textColor;
-        gcn::Color prevColor = selColor;
-        const std::string row = *(i);
-        bool wrapped = false;
-        x = 0;
+        const TextRow &row = *i;
+        if (row.y + row.height <= top)
+            continue;
+        if (row.y >= bottom)
+            break;
+
+        const int y = row.y - mRowsTop;
 
         // Check for separator lines
-        if (row.find("---", 0) == 0)
+        if (row.text.find("---", 0) == 0)
         {
+            graphics->setColor(guiPalette->getColor(Palette::TEXT));
             const int dashWidth = font->getWidth("-");
-            for (x = 0; x < getWidth(); x++)
+            for (int x = 0; x < getWidth(); x++)
             {
                 font->drawString(graphics, "-", x, y);
                 x += dashWidth - 2;
             }
-            y += font->getHeight();
             continue;
         }
 
-        // TODO: Check if we must take texture size limits into account here
-        // TODO: Check if some of the O(n) calls can be removed
-        for (std::string::size_type start = 0, end = std::string::npos;
-                start != std::string::npos;
-                start = end, end = std::string::npos)
+        for (std::vector<LinePart>::const_iterator part = row.parts.begin();
+             part != row.parts.end(); ++part)
         {
-            // Wrapped line continuation shall be indented
-            if (wrapped)
-            {
-                y += font->getHeight();
-                x = 15;
-            }
+            graphics->setColor(getColor(part->color));
+            font->drawString(graphics, part->text, part->x, y + part->y);
+        }
+    }
+}
+
+void BrowserBox::layoutRow(TextRow &row)
+{
+    gcn::Font *font = getFont();
+    const std::string &text = row.text;
+    const int fontHeight = font->getHeight();
+
+    row.parts.clear();
+    row.height = fontHeight;
+
+    // Separator lines are drawn over the whole width
+    if (text.find("---", 0) == 0)
+        return;
+
+    int x = 0, y = 0;
+    unsigned int link = 0;
+    char color = '0';
+    char prevColor = color;
+    bool wrapped = false;
+
+    // TODO: Check if we must take texture size limits into account here
+    for (std::string::size_type start = 0, end = std::string::npos;
+            start != std::string::npos;
+            start = end, end = std::string::npos)
+    {
+        // Wrapped line continuation shall be indented
+        if (wrapped)
+        {
+            y += fontHeight;
+            x = 15;
+            wrapped = false;
+        }
 
-            // "Tokenize" the string at control sequences
-            if (mUseLinksAndUserColors)
-                end = row.find("##", start + 1);
+        // "Tokenize" the string at control sequences
+        if (mUseLinksAndUserColors)
+            end = text.find("##", start + 1);
 
-            if (mUseLinksAndUserColors ||
-                    (!mUseLinksAndUserColors && (start == 0)))
+        if (mUseLinksAndUserColors ||
+                (!mUseLinksAndUserColors && (start == 0)))
+        {
+            // Check for color change in format "##x", x = [L,P,0..9]
+            if (text.find("##", start) == start && text.size() > start + 2)
             {
-                // Check for color change in format "##x", x = [L,P,0..9]
-                if (row.find("##", start) == start && row.size() > start + 2)
-                {
-                    const char c = row.at(start + 2);
-                    bool valid;
-                    const gcn::Color col = guiPalette->getColor(c, valid);
+                const char c = text.at(start + 2);
 
-                    if (c == '>')
-                    {
-                        selColor = prevColor;
-                    }
-                    else if (c == '<')
+                if (c == '>')
+                {
+                    color = prevColor;
+                }
+                else if (c == '<')
+                {
+                    if (link < row.links.size())
                     {
-                        const int size = mLinks[link].x2 - mLinks[link].x1;
-                        mLinks[link].x1 = x;
-                        mLinks[link].y1 = y;
-                        mLinks[link].x2 = mLinks[link].x1 + size;
-                        mLinks[link].y2 = y + font->getHeight() - 1;
+                        BROWSER_LINK &bLink = row.links[link];
+                        bLink.x1 = x;
+                        bLink.y1 = y;
+                        bLink.x2 = x + font->getWidth(bLink.caption) + 1;
+                        bLink.y2 = y + fontHeight - 1;
                         link++;
-                        prevColor = selColor;
-                        selColor = col;
-                    }
-                    else if (valid)
-                    {
-                        selColor = col;
                     }
-                    else
-                    {
-                        switch (c)
-                        {
-                            case '1': selColor = RED; break;
-                            case '2': selColor = GREEN; break;
-                            case '3': selColor = BLUE; break;
-                            case '4': selColor = ORANGE; break;
-                            case '5': selColor = YELLOW; break;
-                            case '6': selColor = PINK; break;
-                            case '7': selColor = PURPLE; break;
-                            case '8': selColor = GRAY; break;
-                            case '9': selColor = BROWN; break;
-                            case '0':
-                            default:
-                                selColor = textColor;
-                        }
-                    }
-                    start += 3;
+                    prevColor = color;
+                    color = c;
+                }
+                else
+                {
+                    color = c;
+                }
+                start += 3;
 
-                    if (start == row.size())
-                    {
-                        break;
-                    }
+                if (start == text.size())
+                {
+                    break;
                 }
-                graphics->setColor(selColor);
             }
+        }
 
-            std::string::size_type len =
-                end == std::string::npos ? end : end - start;
-            std::string part = row.substr(start, len);
+        std::string::size_type len =
+            end == std::string::npos ? end : end - start;
+        std::string part = text.substr(start, len);
 
-            // Auto wrap mode
-            if (mMode == AUTO_WRAP &&
-                    (x + font->getWidth(part) + 10) > getWidth())
+        // Auto wrap mode
+        if (mMode == AUTO_WRAP &&
+                (x + font->getWidth(part) + 10) > getWidth())
+        {
+            bool forced = false;
+            char const *hyphen = "~";
+            int hyphenWidth = font->getWidth(hyphen);
+
+            /* FIXME: This code layout makes it easy to crash remote
+               clients by talking garbage. Forged long utf-8 characters
+               will cause either a buffer underflow in substr or an
+               infinite loop in the main loop. */
+            do
             {
-                bool forced = false;
-                char const *hyphen = "~";
-                int hyphenWidth = font->getWidth(hyphen);
-
-                /* FIXME: This code layout makes it easy to crash remote
-                   clients by talking garbage. Forged long utf-8 characters
-                   will cause either a buffer underflow in substr or an
-                   infinite loop in the main loop. */
-                do
+                if (!forced)
+                    end = text.rfind(' ', end);
+
+                // Check if we have to (stupidly) force-wrap
+                if (end == std::string::npos || end <= start)
                 {
-                    if (!forced)
-                        end = row.rfind(' ', end);
+                    forced = true;
+                    end = text.size();
+                    x += hyphenWidth; // Account for the wrap-notifier
+                    continue;
+                }
 
-                    // Check if we have to (stupidly) force-wrap
-                    if (end == std::string::npos || end <= start)
-                    {
-                        forced = true;
-                        end = row.size();
-                        x += hyphenWidth; // Account for the wrap-notifier
-                        continue;
-                    }
+                // Skip to the start of the current character
+                while ((text[end] & 192) == 128)
+                    end--;
+                end--; // And then to the last byte of the previous one
 
-                    // Skip to the start of the current character
-                    while ((row[end] & 192) == 128)
-                        end--;
-                    end--; // And then to the last byte of the previous one
+                part = text.substr(start, end - start + 1);
+            } while (end > start && (x + font->getWidth(part) + 10) > getWidth());
 
-                    part = row.substr(start, end - start + 1);
-                } while (end > start && (x + font->getWidth(part) + 10) > getWidth());
+            if (forced)
+            {
+                x -= hyphenWidth; // Remove the wrap-notifier accounting
 
-                if (forced)
-                {
-                    x -= hyphenWidth; // Remove the wrap-notifier accounting
-                    font->drawString(graphics, hyphen,
-                            getWidth() - hyphenWidth, y);
-                    end++; // Skip to the next character
-                }
-                else
-                    end += 2; // Skip to after the space
+                LinePart notifier;
+                notifier.x = getWidth() - hyphenWidth;
+                notifier.y = y;
+                notifier.color = color;
+                notifier.text = hyphen;
+                row.parts.push_back(notifier);
 
-                wrapped = true;
-                wrappedLines++;
+                end++; // Skip to the next character
             }
-            font->drawString(graphics, part, x, y);
-            x += font->getWidth(part);
+            else
+                end += 2; // Skip to after the space
+
+            wrapped = true;
+        }
+
+        if (!part.empty())
+        {
+            LinePart linePart;
+            linePart.x = x;
+            linePart.y = y;
+            linePart.color = color;
+            linePart.text = part;
+            row.parts.push_back(linePart);
         }
-        y += font->getHeight();
-        setHeight((mTextRows.size() + wrappedLines) * font->getHeight());
+        x += font->getWidth(part);
+    }
+
+    row.height = y + fontHeight;
+}
+
+void BrowserBox::layoutRows()
+{
+    mLayoutWidth = getWidth();
+    mRowsTop = 0;
+
+    int y = 0;
+    for (TextRowIterator i = mTextRows.begin(); i != mTextRows.end(); i++)
+    {
+        i->y = y;
+        layoutRow(*i);
+        y += i->height;
+    }
+}
+
+void BrowserBox::updateHeight()
+{
+    if (mTextRows.empty())
+        setHeight(0);
+    else
+        setHeight(mTextRows.back().y + mTextRows.back().height - mRowsTop);
+}
+
+bool BrowserBox::getLinkAt(int x, int y, int &row, int &link) const
+{
+    // Find the last row starting at or above the given position
+    const int rowsY = y + mRowsTop;
+    int first = 0;
+    int last = mTextRows.size();
+    while (first < last)
+    {
+        const int middle = (first + last) / 2;
+        if (mTextRows[middle].y <= rowsY)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    if (first == 0)
+        return false;
+
+    const TextRow &textRow = mTextRows[first - 1];
+    const int rowY = rowsY - textRow.y;
+    for (unsigned int j = 0; j < textRow.links.size(); j++)
+    {
+        const BROWSER_LINK &bLink = textRow.links[j];
+        if (x >= bLink.x1 && x < bLink.x2 &&
+            rowY >= bLink.y1 && rowY < bLink.y2)
+        {
+            row = first - 1;
+            link = j;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+gcn::Color BrowserBox::getColor(char c)
+{
+    bool valid;
+    const gcn::Color col = guiPalette->getColor(c, valid);
+    if (valid)
+        return col;
+
+    switch (c)
+    {
+        case '1': return RED;
+        case '2': return GREEN;
+        case '3': return BLUE;
+        case '4': return ORANGE;
+        case '5': return YELLOW;
+        case '6': return PINK;
+        case '7': return PURPLE;
+        case '8': return GRAY;
+        case '9': return BROWN;
+        case '0':
+        default:
+            return guiPalette->getColor(Palette::TEXT);
     }
 }
@@ -22,7 +22,8 @@
 #ifndef BROWSERBOX_H
 #define BROWSERBOX_H
 
-#include <list>
+#include <deque>
+#include <string>
 #include <vector>
 
 #include <guichan/mouselistener.hpp>
@@ -31,7 +32,7 @@
 class LinkHandler;
 
 struct BROWSER_LINK {
-    int x1, x2, y1, y2;     /**< Where link is placed */
+    int x1, x2, y1, y2;     /**< Where link is placed, within its row */
     std::string link;
     std::string caption;
 };
@@ -39,6 +40,9 @@ struct BROWSER_LINK {
 /**
  * A simple browser box able to handle links and forward events to the
  * parent conteiner.
+ *
+ * Each row is laid out once when it is added, and again only when the width
+ * of the box changes. Only the rows within the clip area are drawn.
  */
 class BrowserBox : public gcn::Widget, public gcn::MouseListener
 {
@@ -139,21 +143,70 @@ class BrowserBox : public gcn::Widget, public gcn::MouseListener
         };
 
     private:
-        typedef std::list<std::string> TextRows;
+        /**
+         * A piece of a row that is drawn in a single color.
+         */
+        struct LinePart
+        {
+            int x, y;               /**< Position within the row */
+            char color;             /**< Color code, see getColor() */
+            std::string text;
+        };
+
+        /**
+         * A text row, along with its layout for the current width.
+         */
+        struct TextRow
+        {
+            std::string text;       /**< Text including control sequences */
+            std::vector<LinePart> parts;
+            std::vector<BROWSER_LINK> links;
+            int y;                  /**< Top of the row, offset by mRowsTop */
+            int height;
+        };
+
+        /**
+         * Lays out the given row for the current width of the box.
+         */
+        void layoutRow(TextRow &row);
+
+        /**
+         * Lays out all rows again, after the width of the box changed.
+         */
+        void layoutRows();
+
+        /**
+         * Sets the height of the box to the height of the rows.
+         */
+        void updateHeight();
+
+        /**
+         * Finds the link at the given position.
+         *
+         * @return <code>true</code> if a link was found, <code>false</code>
+         *         otherwise.
+         */
+        bool getLinkAt(int x, int y, int &row, int &link) const;
+
+        /**
+         * Returns the color of the given color code, as used in "##x".
+         */
+        static gcn::Color getColor(char c);
+
+        typedef std::deque<TextRow> TextRows;
         typedef TextRows::iterator TextRowIterator;
         TextRows mTextRows;
 
-        typedef std::vector<BROWSER_LINK> Links;
-        typedef Links::iterator LinkIterator;
-        Links mLinks;
-
         LinkHandler *mLinkHandler;
         unsigned int mMode;
         unsigned int mHighMode;
         bool mOpaque;
         bool mUseLinksAndUserColors;
+        int mSelectedRow;
         int mSelectedLink;
         unsigned int mMaxRows;
+        int mRowsTop;               /**< The top of the first row */
+        int mLayoutWidth;           /**< The width the rows are laid out for */
 };
 
 #endif
@@ -30,6 +30,8 @@
 #include "resources/resourcemanager.h"
 #include "gui/skin.h"
 
+#include "gui/widgets/window.h"
+
 #include "utils/dtor.h"
 
 #include <guichan/exception.hpp>
@@ -125,6 +127,24 @@ Button::~Button()
     }
 }
 
+void Button::setCaption(const std::string &caption)
+{
+    if (caption == getCaption())
+        return;
+
+    gcn::Button::setCaption(caption);
+    Window::contentChanged(this);
+}
+
+void Button::setEnabled(bool enabled)
+{
+    if (enabled == isEnabled())
+        return;
+
+    gcn::Button::setEnabled(enabled);
+    Window::contentChanged(this);
+}
+
 void Button::updateAlpha()
 {
     float alpha = std::max(config.getValue("guialpha", 0.8f),
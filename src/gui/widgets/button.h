@@ -51,6 +51,18 @@ class Button : public gcn::Button
          */
         ~Button();
 
+        /**
+         * Sets the caption of the button, letting its window know when it
+         * changed.
+         */
+        void setCaption(const std::string &caption);
+
+        /**
+         * Enables or disables the button, letting its window know when it
+         * changed.
+         */
+        void setEnabled(bool enabled);
+
         /**
          * Draws the button.
          */
@@ -21,6 +21,8 @@
 
 #include "gui/widgets/container.h"
 
+#include "gui/widgets/window.h"
+
 Container::Container()
 {
     setOpaque(false);
@@ -31,3 +33,27 @@ Container::~Container()
     while (!mWidgets.empty())
         delete mWidgets.front();
 }
+
+void Container::add(gcn::Widget *widget)
+{
+    gcn::Container::add(widget);
+    Window::contentChanged(this);
+}
+
+void Container::add(gcn::Widget *widget, int x, int y)
+{
+    gcn::Container::add(widget, x, y);
+    Window::contentChanged(this);
+}
+
+void Container::remove(gcn::Widget *widget)
+{
+    gcn::Container::remove(widget);
+    Window::contentChanged(this);
+}
+
+void Container::clear()
+{
+    gcn::Container::clear();
+    Window::contentChanged(this);
+}
@@ -31,13 +31,22 @@
  * that childs added to this container are automatically deleted when the
  * container is deleted.
  *
- * This container is also non-opaque by default.
+ * This container is also non-opaque by default, and lets its window know when
+ * widgets are added or removed.
  */
 class Container : public gcn::Container
 {
     public:
         Container();
         ~Container();
+
+        void add(gcn::Widget *widget);
+
+        void add(gcn::Widget *widget, int x, int y);
+
+        void remove(gcn::Widget *widget);
+
+        void clear();
 };
 
 #endif
@@ -0,0 +1,120 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "gui/widgets/frametimegraph.h"
+
+#include "profiler.h"
+
+#include <guichan/font.hpp>
+#include <guichan/graphics.hpp>
+
+#include <algorithm>
+
+/**
+ * The frame time shown at the top of the graph, in milliseconds.
+ */
+static const float MAX_FRAME_TIME = 50.0f;
+
+/**
+ * The frame time of the reference line, in milliseconds (60 FPS).
+ */
+static const float TARGET_FRAME_TIME = 1000.0f / 60;
+
+/**
+ * The colors of the sections. The time spent idle isn't drawn.
+ */
+static const gcn::Color SECTION_COLORS[Profiler::SECTION_COUNT] = {
+    gcn::Color(160, 160, 160, 200),     // Other
+    gcn::Color(230, 80, 80, 200),       // Beings
+    gcn::Color(230, 160, 40, 200),      // Particles
+    gcn::Color(80, 190, 80, 200),       // Map
+    gcn::Color(80, 130, 230, 200),      // GUI
+    gcn::Color(180, 90, 220, 200),      // Screen
+    gcn::Color(60, 200, 200, 200),      // Network
+    gcn::Color(0, 0, 0, 0)              // Idle
+};
+
+FrameTimeGraph::FrameTimeGraph()
+{
+    setHeight(100);
+}
+
+void FrameTimeGraph::draw(gcn::Graphics *graphics)
+{
+    const int width = getWidth();
+    const int height = getHeight();
+    const float scale = height / MAX_FRAME_TIME;
+
+    graphics->setColor(gcn::Color(0, 0, 0, 128));
+    graphics->fillRectangle(gcn::Rectangle(0, 0, width, height));
+
+    // One column per frame, with the newest frame on the right
+    const int count = std::min(width, Profiler::getSampleCount());
+    const int first = Profiler::getSampleCount() - count;
+    for (int i = 0; i < count; i++)
+    {
+        const Profiler::Sample &sample = Profiler::getSample(first + i);
+        const int x = width - count + i;
+        float bottom = 0.0f;
+
+        for (int j = 0; j < Profiler::SECTION_COUNT; j++)
+        {
+            if (j == Profiler::IDLE)
+                continue;
+
+            const float top = bottom + sample.sections[j] * scale;
+            const int y1 = height - (int) top;
+            const int y2 = height - (int) bottom;
+            if (y2 > y1)
+            {
+                graphics->setColor(SECTION_COLORS[j]);
+                graphics->fillRectangle(gcn::Rectangle(x, y1, 1, y2 - y1));
+            }
+            bottom = top;
+        }
+    }
+
+    const int targetY = height - (int) (TARGET_FRAME_TIME * scale);
+    graphics->setColor(gcn::Color(255, 255, 255, 160));
+    graphics->drawLine(0, targetY, width - 1, targetY);
+
+    // The legend
+    gcn::Font *font = getFont();
+    graphics->setFont(font);
+    int x = 2;
+    for (int j = 0; j < Profiler::SECTION_COUNT; j++)
+    {
+        if (j == Profiler::IDLE)
+            continue;
+
+        const char *name =
+            Profiler::getSectionName((Profiler::Section) j);
+        const int size = font->getHeight() / 2;
+
+        graphics->setColor(SECTION_COLORS[j]);
+        graphics->fillRectangle(gcn::Rectangle(x, 2 + size / 2, size, size));
+        x += size + 2;
+
+        graphics->setColor(gcn::Color(255, 255, 255));
+        graphics->drawText(name, x, 2);
+        x += font->getWidth(name) + 6;
+    }
+}
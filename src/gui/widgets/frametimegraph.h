@@ -0,0 +1,47 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef FRAMETIMEGRAPH_H
+#define FRAMETIMEGRAPH_H
+
+#include <guichan/widget.hpp>
+
+/**
+ * A graph of the time spent on the last frames, with one column per frame
+ * split up by the subsystems the time was spent on.
+ *
+ * \ingroup GUI
+ */
+class FrameTimeGraph : public gcn::Widget
+{
+    public:
+        /**
+         * Constructor.
+         */
+        FrameTimeGraph();
+
+        /**
+         * Draws the graph.
+         */
+        void draw(gcn::Graphics *graphics);
+};
+
+#endif
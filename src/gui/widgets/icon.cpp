@@ -23,6 +23,8 @@
 
 #include "graphics.h"
 
+#include "gui/widgets/window.h"
+
 #include "resources/image.h"
 #include "resources/resourcemanager.h"
 
@@ -44,6 +46,7 @@ void Icon::setImage(Image *image)
 {
     mImage = image;
     setSize(mImage->getWidth(), mImage->getHeight());
+    Window::contentChanged(this);
 }
 
 void Icon::draw(gcn::Graphics *g)
@@ -23,6 +23,8 @@
 
 #include "gui/palette.h"
 
+#include "gui/widgets/window.h"
+
 Label::Label()
 {
 }
@@ -32,6 +34,15 @@ Label::Label(const std::string &caption) :
 {
 }
 
+void Label::setCaption(const std::string &caption)
+{
+    if (caption == getCaption())
+        return;
+
+    gcn::Label::setCaption(caption);
+    Window::contentChanged(this);
+}
+
 void Label::draw(gcn::Graphics *graphics)
 {
     setForegroundColor(guiPalette->getColor(Palette::TEXT));
@@ -44,6 +44,12 @@ class Label : public gcn::Label
          */
         Label(const std::string &caption);
 
+        /**
+         * Sets the caption of the label, letting its window know when it
+         * changed.
+         */
+        void setCaption(const std::string &caption);
+
         /**
          * Draws the label.
          */
@@ -25,6 +25,8 @@
 #include "gui/palette.h"
 #include "gui/textrenderer.h"
 
+#include "gui/widgets/window.h"
+
 #include "configuration.h"
 #include "graphics.h"
 
@@ -94,6 +96,9 @@ ProgressBar::~ProgressBar()
 
 void ProgressBar::logic()
 {
+    const gcn::Color oldColor = mColor;
+    const float oldProgress = mProgress;
+
     if (mSmoothColorChange)
     {
         // Smoothly changing the color for a nicer effect.
@@ -113,12 +118,17 @@ void ProgressBar::logic()
 
     if (mSmoothProgress)
     {
-        // Smoothly showing the progressbar changes.
+        // Smoothly showing the progressbar changes, stopping at the target
         if (mProgressToGo > mProgress)
-            mProgress = std::min(1.0f, mProgress + 0.005f);
+            mProgress = std::min(mProgressToGo, mProgress + 0.005f);
         if (mProgressToGo < mProgress)
-            mProgress = std::max(0.0f, mProgress - 0.005f);
+            mProgress = std::max(mProgressToGo, mProgress - 0.005f);
     }
+
+    // Windows drawn from an image need to know the bar is moving
+    if (mProgress != oldProgress || mColor.r != oldColor.r ||
+        mColor.g != oldColor.g || mColor.b != oldColor.b)
+        Window::contentChanged(this);
 }
 
 void ProgressBar::updateAlpha()
@@ -173,8 +183,11 @@ void ProgressBar::setProgress(float progress)
     const float p = std::min(1.0f, std::max(0.0f, progress));
     mProgressToGo = p;
 
-    if (!mSmoothProgress)
+    if (!mSmoothProgress && mProgress != p)
+    {
         mProgress = p;
+        Window::contentChanged(this);
+    }
 }
 
 void ProgressBar::setColor(const gcn::Color &color)
@@ -182,5 +195,21 @@ void ProgressBar::setColor(const gcn::Color &color)
     mColorToGo = color;
 
     if (!mSmoothColorChange)
+    {
+        const bool changed = mColor.r != color.r || mColor.g != color.g ||
+                             mColor.b != color.b;
         mColor = color;
+
+        if (changed)
+            Window::contentChanged(this);
+    }
+}
+
+void ProgressBar::setText(const std::string &text)
+{
+    if (mText == text)
+        return;
+
+    mText = text;
+    Window::contentChanged(this);
 }
@@ -91,8 +91,7 @@ class ProgressBar : public gcn::Widget
         /**
          * Sets the text shown on the progress bar.
          */
-        void setText(const std::string &text)
-        { mText = text; }
+        void setText(const std::string &text);
 
         /**
          * Returns the text shown on the progress bar.
@@ -21,6 +21,7 @@
 
 #include "gui/widgets/tabbedarea.h"
 #include "gui/widgets/tab.h"
+#include "gui/widgets/window.h"
 
 #include <guichan/widgets/container.hpp>
 
@@ -30,6 +31,8 @@ TabbedArea::TabbedArea() : gcn::TabbedArea()
     addWidgetListener(this);
 
     widgetResized(NULL);
+
+    Window::contentChanged(this);
 }
 
 int TabbedArea::getNumberOfTabs() const
@@ -89,6 +92,8 @@ void TabbedArea::addTab(gcn::Tab* tab, gcn::Widget* widget)
     int width = getWidth() - 2 * getFrameSize();
     int height = getHeight() - 2 * getFrameSize() - mTabContainer->getHeight();
     widget->setSize(width, height);
+
+    Window::contentChanged(this);
 }
 
 void TabbedArea::addTab(const std::string &caption, gcn::Widget *widget)
@@ -148,6 +153,8 @@ void TabbedArea::removeTab(Tab *tab)
 
     adjustSize();
     adjustTabPositions();
+
+    Window::contentChanged(this);
 }
 
 void TabbedArea::logic()
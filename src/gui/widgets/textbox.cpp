@@ -23,6 +23,8 @@
 
 #include "gui/palette.h"
 
+#include "gui/widgets/window.h"
+
 #include <guichan/font.hpp>
 
 #include <sstream>
@@ -145,5 +147,11 @@ void TextBox::setTextWrapped(const std::string &text, int minDimension)
 
     mMinWidth = minWidth;
 
-    gcn::TextBox::setText(wrappedStream.str());
+    setText(wrappedStream.str());
+}
+
+void TextBox::setText(const std::string &text)
+{
+    gcn::TextBox::setText(text);
+    Window::contentChanged(this);
 }
@@ -47,6 +47,12 @@ class TextBox : public gcn::TextBox
          */
         void setTextWrapped(const std::string &text, int minDimension);
 
+        /**
+         * Sets the text, letting the window of the text box know about the
+         * change.
+         */
+        void setText(const std::string &text);
+
         /**
          * Get the minimum text width for the text box.
          */
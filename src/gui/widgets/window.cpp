@@ -30,14 +30,22 @@
 #include "gui/skin.h"
 
 #include "configuration.h"
+#include "game.h"
 #include "log.h"
 
 #include "resources/image.h"
 
 #include <guichan/exception.hpp>
+#include <guichan/focushandler.hpp>
+
+#include <SDL.h>
+
+#include <algorithm>
 
 int Window::instances = 0;
 int Window::mouseResize = 0;
+std::list<Window*> Window::mCachedWindows;
+Graphics *Window::mContentGraphics = 0;
 
 Window::Window(const std::string &caption, bool modal, Window *parent,
                const std::string &skin):
@@ -57,7 +65,12 @@ Window::Window(const std::string &caption, bool modal, Window *parent,
     mMinWinWidth(100),
     mMinWinHeight(40),
     mMaxWinWidth(graphics->getWidth()),
-    mMaxWinHeight(graphics->getHeight())
+    mMaxWinHeight(graphics->getHeight()),
+    mCached(false),
+    mContentValid(false),
+    mContentImage(0),
+    mContentAlpha(1.0f),
+    mRedrawCount(0)
 {
     logger->log("Window::Window(\"%s\")", caption.c_str());
 
@@ -101,6 +114,8 @@ Window::~Window()
 
     removeWidgetListener(this);
 
+    setCached(false);
+
     instances--;
 
     mSkin->instances--;
@@ -112,6 +127,239 @@ void Window::setWindowContainer(WindowContainer *wc)
 }
 
 void Window::draw(gcn::Graphics *graphics)
+{
+    if (mCached && canDrawContentImage())
+    {
+        const float alpha =
+            mSkin->getBorder().grid[ImageRect::CENTER]->getAlpha();
+
+        if (!mContentValid || alpha != mContentAlpha || !mContentImage ||
+            mContentImage->getWidth() != getWidth() ||
+            mContentImage->getHeight() != getHeight())
+        {
+            mContentAlpha = alpha;
+            updateContentImage();
+        }
+
+        if (mContentImage)
+        {
+            static_cast<Graphics*>(graphics)->drawImage(mContentImage, 0, 0);
+            return;
+        }
+    }
+
+    // Whatever is drawn now may differ from the image
+    mContentValid = false;
+    mRedrawCount++;
+
+    drawContent(graphics);
+}
+
+void Window::setCached(bool cached)
+{
+    if (mCached == cached)
+        return;
+
+    mCached = cached;
+
+    if (mCached)
+    {
+        mCachedWindows.push_back(this);
+    }
+    else
+    {
+        mCachedWindows.remove(this);
+        delete mContentImage;
+        mContentImage = 0;
+
+        if (mCachedWindows.empty())
+        {
+            delete mContentGraphics;
+            mContentGraphics = 0;
+        }
+    }
+    mContentValid = false;
+}
+
+/**
+ * Tells that the given widget is to be drawn again.
+ */
+static void requestWidgetRedraw(gcn::Widget *widget)
+{
+    int x, y;
+    widget->getAbsolutePosition(x, y);
+    requestRedraw(gcn::Rectangle(x, y, widget->getWidth(),
+                                 widget->getHeight()));
+}
+
+void Window::invalidate()
+{
+    mContentValid = false;
+    requestWidgetRedraw(this);
+}
+
+void Window::contentChanged(gcn::Widget *widget)
+{
+    for (gcn::Widget *w = widget; w; w = w->getParent())
+    {
+        if (Window *window = dynamic_cast<Window*>(w))
+        {
+            window->mContentValid = false;
+            break;
+        }
+    }
+
+    // The widget may have changed its size too, so the whole window or
+    // popup it is part of is drawn again
+    gcn::Widget *outer = widget;
+    while (outer->getParent() && outer->getParent()->getParent())
+        outer = outer->getParent();
+
+    if (outer->getParent())
+        requestWidgetRedraw(outer);
+    else if (gui && outer == gui->getTop())
+        requestRedraw();
+}
+
+bool Window::canDrawContentImage() const
+{
+#ifdef USE_OPENGL
+    // The images can't be drawn onto another surface with OpenGL
+    if (Image::getLoadAsOpenGL())
+        return false;
+#endif
+
+    if (mouseResize)
+        return false;
+
+    // Hovered widgets are highlighted
+    int mouseX, mouseY, x, y;
+    SDL_GetMouseState(&mouseX, &mouseY);
+    getAbsolutePosition(x, y);
+    if (mouseX >= x && mouseX < x + getWidth() &&
+        mouseY >= y && mouseY < y + getHeight())
+        return false;
+
+    // The focused widget may change by itself, like a blinking caret
+    gcn::FocusHandler *focusHandler =
+        const_cast<Window*>(this)->_getFocusHandler();
+    if (focusHandler)
+    {
+        for (gcn::Widget *w = focusHandler->getFocused(); w; w = w->getParent())
+        {
+            if (w == this)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void Window::updateContentImage()
+{
+    delete mContentImage;
+    mContentImage = 0;
+
+    const int width = getWidth();
+    const int height = getHeight();
+    if (width <= 0 || height <= 0)
+        return;
+
+    // SDL blits don't combine the alpha values of what is drawn, so the
+    // window is drawn over black and over white, and the alpha is recovered
+    // from the difference between both
+    SDL_Surface *black = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                              32, 0xff0000, 0x00ff00,
+                                              0x0000ff, 0);
+    SDL_Surface *white = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                              32, 0xff0000, 0x00ff00,
+                                              0x0000ff, 0);
+    Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0xff000000;
+    gmask = 0x00ff0000;
+    bmask = 0x0000ff00;
+    amask = 0x000000ff;
+#else
+    rmask = 0x000000ff;
+    gmask = 0x0000ff00;
+    bmask = 0x00ff0000;
+    amask = 0xff000000;
+#endif
+    SDL_Surface *result = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+                                               32, rmask, gmask, bmask, amask);
+
+    if (black && white && result)
+    {
+        SDL_FillRect(black, NULL, SDL_MapRGB(black->format, 0, 0, 0));
+        SDL_FillRect(white, NULL, SDL_MapRGB(white->format, 255, 255, 255));
+
+        drawContentOnto(black);
+        drawContentOnto(white);
+        mRedrawCount++;
+
+        SDL_LockSurface(result);
+        for (int y = 0; y < height; y++)
+        {
+            const Uint32 *blackRow = (const Uint32*)
+                ((const Uint8*) black->pixels + y * black->pitch);
+            const Uint32 *whiteRow = (const Uint32*)
+                ((const Uint8*) white->pixels + y * white->pitch);
+            Uint32 *row = (Uint32*) ((Uint8*) result->pixels +
+                                     y * result->pitch);
+
+            for (int x = 0; x < width; x++)
+            {
+                Uint8 br, bg, bb, wr, wg, wb;
+                SDL_GetRGB(blackRow[x], black->format, &br, &bg, &bb);
+                SDL_GetRGB(whiteRow[x], white->format, &wr, &wg, &wb);
+
+                // What shows through of the background is the transparency
+                const int shown = ((wr - br) + (wg - bg) + (wb - bb)) / 3;
+                const int a = std::max(0, std::min(255, 255 - shown));
+
+                if (a == 0)
+                {
+                    row[x] = 0;
+                    continue;
+                }
+
+                // Over black, the colors were multiplied by the alpha
+                row[x] = SDL_MapRGBA(result->format,
+                                     std::min(255, br * 255 / a),
+                                     std::min(255, bg * 255 / a),
+                                     std::min(255, bb * 255 / a),
+                                     a);
+            }
+        }
+        SDL_UnlockSurface(result);
+
+        mContentImage = Image::load(result);
+        mContentValid = mContentImage != 0;
+    }
+
+    SDL_FreeSurface(black);
+    SDL_FreeSurface(white);
+    SDL_FreeSurface(result);
+}
+
+void Window::drawContentOnto(SDL_Surface *surface)
+{
+    // The same graphics is used for all windows, so the window frames it
+    // composes are kept. The clip area pushed for a surface is popped when
+    // drawing onto the next one, or when the graphics is destroyed.
+    if (!mContentGraphics)
+        mContentGraphics = new Graphics;
+    else
+        mContentGraphics->_endDraw();
+
+    mContentGraphics->setTargetSurface(surface);
+    mContentGraphics->_beginDraw();
+
+    drawContent(mContentGraphics);
+}
+
+void Window::drawContent(gcn::Graphics *graphics)
 {
     Graphics *g = static_cast<Graphics*>(graphics);
 
@@ -311,6 +559,7 @@ void Window::setVisible(bool visible, bool forceSticky)
         checkIfIsOffScreen();
 
     gcn::Window::setVisible((!forceSticky && isSticky()) || visible);
+    requestWidgetRedraw(this);
 }
 
 void Window::scheduleDelete()
@@ -29,6 +29,8 @@
 
 #include <guichan/widgets/window.hpp>
 
+#include <list>
+
 class ContainerPlacer;
 class Layout;
 class LayoutCell;
@@ -74,6 +76,37 @@ class Window : public gcn::Window, gcn::WidgetListener
          */
         void draw(gcn::Graphics *graphics);
 
+        /**
+         * Sets whether the window keeps an image of itself, which is drawn
+         * instead of its widgets for as long as they don't change. The
+         * widgets report their changes through contentChanged(). Only has an
+         * effect with the SDL backend.
+         */
+        void setCached(bool cached);
+
+        /**
+         * Tells the window that its widgets changed and need to be drawn
+         * again.
+         */
+        void invalidate();
+
+        /**
+         * Invalidates the window the given widget is part of, if any. Called
+         * by widgets when what they show changes.
+         */
+        static void contentChanged(gcn::Widget *widget);
+
+        /**
+         * Returns the number of times the widgets of this window were drawn.
+         */
+        int getRedrawCount() const { return mRedrawCount; }
+
+        /**
+         * Returns the windows that keep an image of themselves.
+         */
+        static const std::list<Window*> &getCachedWindows()
+        { return mCachedWindows; }
+
         /**
          * Sets the size of this window.
          */
@@ -362,6 +395,27 @@ class Window : public gcn::Window, gcn::WidgetListener
          */
         int getResizeHandles(gcn::MouseEvent &event);
 
+        /**
+         * Draws the frame and the widgets of the window.
+         */
+        void drawContent(gcn::Graphics *graphics);
+
+        /**
+         * Tells whether the image of the window can be drawn instead of its
+         * widgets, which isn't the case while the user interacts with it.
+         */
+        bool canDrawContentImage() const;
+
+        /**
+         * Draws the window into a new image of itself.
+         */
+        void updateContentImage();
+
+        /**
+         * Draws the window onto the given surface.
+         */
+        void drawContentOnto(SDL_Surface *surface);
+
         ResizeGrip *mGrip;            /**< Resize grip */
         Window *mParent;              /**< The parent window */
         Layout *mLayout;              /**< Layout handler */
@@ -388,6 +442,15 @@ class Window : public gcn::Window, gcn::WidgetListener
 
         Skin *mSkin;                  /**< Skin in use by this window */
 
+        bool mCached;                 /**< Window keeps an image of itself */
+        bool mContentValid;           /**< The image is up to date */
+        Image *mContentImage;         /**< The image of the window */
+        float mContentAlpha;          /**< Skin alpha the image was drawn at */
+        int mRedrawCount;             /**< Times the widgets were drawn */
+
+        static std::list<Window*> mCachedWindows;
+        static Graphics *mContentGraphics;  /**< Draws the window images */
+
         /**
          * The width of the resize border. Is independent of the actual window
          * border width, and determines mostly the size of the corner area
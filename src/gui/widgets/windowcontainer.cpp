@@ -21,12 +21,18 @@
 
 #include "gui/widgets/windowcontainer.h"
 
+#include "game.h"
+
 #include "utils/dtor.h"
 
 WindowContainer *windowContainer = NULL;
 
 void WindowContainer::logic()
 {
+    // What the deleted windows covered is uncovered
+    if (!mDeathList.empty())
+        requestRedraw();
+
     delete_all(mDeathList);
     mDeathList.clear();
 
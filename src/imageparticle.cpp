@@ -19,6 +19,8 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <guichan/rectangle.hpp>
+
 #include "imageparticle.h"
 
 #include "graphics.h"
@@ -39,6 +41,19 @@ ImageParticle::~ImageParticle()
         mImage->decRef();
 }
 
+bool ImageParticle::getBounds(gcn::Rectangle &bounds) const
+{
+    // Without an image, nothing is drawn
+    if (!mImage)
+        return Particle::getBounds(bounds);
+
+    bounds.x = (int) mPos.x - mImage->getWidth() / 2;
+    bounds.y = (int) mPos.y - (int) mPos.z - mImage->getHeight() / 2;
+    bounds.width = mImage->getWidth();
+    bounds.height = mImage->getHeight();
+    return true;
+}
+
 void ImageParticle::draw(Graphics *graphics, int offsetX, int offsetY) const
 {
     if (!mAlive || !mImage)
@@ -64,6 +79,5 @@ void ImageParticle::draw(Graphics *graphics, int offsetX, int offsetY) const
     if (mLifetimePast < mFadeIn)
         alphafactor *= (float) mLifetimePast / (float) mFadeIn;
 
-    mImage->setAlpha(alphafactor);
-    graphics->drawImage(mImage, screenX, screenY);
+    graphics->drawImage(mImage, screenX, screenY, alphafactor);
 }
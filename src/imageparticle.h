@@ -51,6 +51,11 @@ class ImageParticle : public Particle
          */
         virtual void draw(Graphics *graphics, int offsetX, int offsetY) const;
 
+        /**
+         * @see Sprite::getBounds()
+         */
+        virtual bool getBounds(gcn::Rectangle &bounds) const;
+
     protected:
         Image *mImage;   /**< The image used for this particle. */
 };
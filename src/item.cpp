@@ -21,12 +21,15 @@
 
 #include "item.h"
 
+#include "game.h"
+
 #include "resources/image.h"
 #include "resources/iteminfo.h"
 #include "resources/resourcemanager.h"
 
 Item::Item(int id, int quantity, bool equipment, bool equipped):
     mImage(0),
+    mImageHandle(0),
     mQuantity(quantity),
     mEquipment(equipment), mEquipped(equipped), mInEquipment(false)
 {
@@ -35,6 +38,8 @@ Item::Item(int id, int quantity, bool equipment, bool equipped):
 
 Item::~Item()
 {
+    if (mImageHandle)
+        mImageHandle->release();
     if (mImage)
         mImage->decRef();
 }
@@ -46,14 +51,32 @@ void Item::setId(int id)
     // Types 0 and 1 are not equippable items.
     mEquipment = id && getInfo().getType() >= 2;
 
-    // Load the associated image
+    // Load the associated image, showing the unknown item image until it
+    // is ready or when it can't be loaded
+    if (mImageHandle)
+        mImageHandle->release();
     if (mImage)
         mImage->decRef();
 
     ResourceManager *resman = ResourceManager::getInstance();
+    mImage = resman->getImage("graphics/gui/unknown-item.png");
+
     std::string imagePath = "graphics/items/" + getInfo().getImageName();
-    mImage = resman->getImage(imagePath);
+    mImageHandle = resman->getImageAsync(imagePath, imageLoaded, this);
+}
+
+void Item::imageLoaded(ResourceHandle *handle, void *data)
+{
+    Item *item = static_cast<Item*>(data);
+    Image *image = static_cast<Image*>(handle->getResource());
+
+    if (!image)
+        return;
+
+    image->incRef();
+    if (item->mImage)
+        item->mImage->decRef();
+    item->mImage = image;
 
-    if (!mImage)
-        mImage = resman->getImage("graphics/gui/unknown-item.png");
+    requestRedraw();
 }
@@ -25,6 +25,7 @@
 #include "resources/itemdb.h"
 
 class Image;
+class ResourceHandle;
 
 /**
  * Represents one or more instances of a certain item type.
@@ -54,7 +55,8 @@ class Item
         int getId() const { return mId; }
 
         /**
-         * Returns the item image.
+         * Returns the item image. This is a placeholder until the image of
+         * the item has been loaded.
          */
         Image *getImage() { return mImage; }
 
@@ -119,8 +121,15 @@ class Item
         const ItemInfo &getInfo() const { return ItemDB::get(mId); }
 
     protected:
+        /**
+         * Called by the resource manager when the item image has been
+         * loaded.
+         */
+        static void imageLoaded(ResourceHandle *handle, void *data);
+
         int mId;              /**< Item type id. */
         Image *mImage;        /**< Item image. */
+        ResourceHandle *mImageHandle; /**< Item image being loaded. */
         int mQuantity;        /**< Number of items. */
         bool mEquipment;      /**< Item is equipment. */
         bool mEquipped;       /**< Item is equipped. */
@@ -34,9 +34,13 @@
 
 #include "gui/widgets/chattab.h"
 
+#include <SDL_thread.h>
+
 Logger::Logger():
     mLogToStandardOut(false),
-    mChatWindow(NULL)
+    mChatWindow(NULL),
+    mMutex(SDL_CreateMutex()),
+    mMainThread(SDL_ThreadID())
 {
 }
 
@@ -46,6 +50,8 @@ Logger::~Logger()
     {
         mLogFile.close();
     }
+
+    SDL_DestroyMutex(mMutex);
 }
 
 void Logger::setLogFile(const std::string &logFilename)
@@ -94,6 +100,8 @@ void Logger::log(const char *log_text, ...)
         << (int)((tv.tv_usec / 10000) % 100)
         << "] ";
 
+    SDL_mutexP(mMutex);
+
     mLogFile << timeStr.str() << buf << std::endl;
 
     if (mLogToStandardOut)
@@ -101,7 +109,10 @@ void Logger::log(const char *log_text, ...)
         std::cout << timeStr.str() << buf << std::endl;
     }
 
-    if (mChatWindow)
+    SDL_mutexV(mMutex);
+
+    // The chat window can only be used from the main thread
+    if (mChatWindow && SDL_ThreadID() == mMainThread)
     {
         localChatTab->chatLog(buf, BY_LOGGER);
     }
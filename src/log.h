@@ -22,12 +22,18 @@
 #ifndef _LOG_H
 #define _LOG_H
 
+#include <SDL_types.h>
+
 #include <fstream>
 
 class ChatWindow;
+struct SDL_mutex;
 
 /**
  * The Log Class : Useful to write debug or info messages
+ *
+ * Messages may be logged from any thread. Only the messages logged from the
+ * thread that created the logger are shown in the chat window.
  */
 class Logger
 {
@@ -76,6 +82,9 @@ class Logger
         std::ofstream mLogFile;
         bool mLogToStandardOut;
         ChatWindow *mChatWindow;
+
+        SDL_mutex *mMutex;      /**< Guards the log file and output */
+        Uint32 mMainThread;     /**< The thread that may use the GUI */
 };
 
 extern Logger *logger;
@@ -21,6 +21,7 @@
 
 #include "main.h"
 
+#include "compositorgraphics.h"
 #include "configuration.h"
 #include "emoteshortcut.h"
 #include "game.h"
@@ -30,12 +31,14 @@
 #include "localplayer.h"
 #include "lockedarray.h"
 #include "log.h"
+#include "nullgraphics.h"
 #ifdef USE_OPENGL
 #include "openglgraphics.h"
 #endif
 #include "playerrelations.h"
 #include "sound.h"
 #include "statuseffect.h"
+#include "tracer.h"
 #include "units.h"
 
 #include "gui/widgets/button.h"
@@ -188,6 +191,8 @@ struct Options
         skipUpdate(false),
         chooseDefault(false),
         noOpenGL(false),
+        headless(false),
+        checksum(false),
         serverPort(0)
     {}
 
@@ -196,6 +201,8 @@ struct Options
     bool skipUpdate;
     bool chooseDefault;
     bool noOpenGL;
+    bool headless;
+    bool checksum;
     std::string username;
     std::string password;
     std::string character;
@@ -379,6 +386,10 @@ static void initConfiguration(const Options &options)
  */
 static void initEngine(const Options &options)
 {
+    // Without a display, SDL pretends to have one
+    if (options.headless)
+        SDL_putenv(const_cast<char*>("SDL_VIDEODRIVER=dummy"));
+
     // Initialize SDL
     logger->log("Initializing SDL...");
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0) {
@@ -441,17 +452,37 @@ static void initEngine(const Options &options)
     }
 #endif
 
+    const bool useCompositor = (config.getValue("compositor", 0) == 1);
+    const int compositorBands = (int) config.getValue("compositorbands", 4);
+
 #ifdef USE_OPENGL
-    bool useOpenGL = !options.noOpenGL && (config.getValue("opengl", 0) == 1);
+    bool useOpenGL = !options.noOpenGL && !options.headless &&
+                     (config.getValue("opengl", 0) == 1);
 
     // Setup image loading for the right image format
     Image::setLoadAsOpenGL(useOpenGL);
 
     // Create the graphics context
-    graphics = useOpenGL ? new OpenGLGraphics : new Graphics;
+    if (options.headless)
+        graphics = new NullGraphics(options.checksum);
+    else if (useOpenGL)
+    {
+        OpenGLGraphics *openGLGraphics = new OpenGLGraphics;
+        openGLGraphics->setSync(config.getValue("vsync", 0) == 1);
+        graphics = openGLGraphics;
+    }
+    else if (useCompositor)
+        graphics = new CompositorGraphics(compositorBands);
+    else
+        graphics = new Graphics;
 #else
     // Create the graphics context
-    graphics = new Graphics;
+    if (options.headless)
+        graphics = new NullGraphics(options.checksum);
+    else if (useCompositor)
+        graphics = new CompositorGraphics(compositorBands);
+    else
+        graphics = new Graphics;
 #endif
 
     const int width = (int) config.getValue("screenwidth", defaultScreenWidth);
@@ -467,6 +498,10 @@ static void initEngine(const Options &options)
             width, height, bpp, SDL_GetError()));
     }
 
+    // Only draw the changed parts of the screen when asked to
+    graphics->setDirtyRects((int) config.getValue("dirtyrects", 0) == 1,
+                            (int) config.getValue("dirtyrectscheck", 0) == 1);
+
     // Initialize for drawing
     graphics->_beginDraw();
 
@@ -514,6 +549,7 @@ static void exitEngine()
 
     delete gui;
     delete graphics;
+    graphics = 0;
 
     // Shutdown libxml
     xmlCleanupParser();
@@ -546,6 +582,9 @@ static void printHelp()
         << _("  -D --default     : Choose default character server and "
                                   "character") << endl
         << _("  -h --help        : Display this help") << endl
+        << _("  -n --headless    : Run without a display, drawing nothing") << endl
+        << _("  -k --checksum    : Run without a display, logging a "
+                                  "checksum of each frame") << endl
         << _("  -S --home-dir    : Directory to use as home directory") << endl
         << _("  -H --update-host : Use this update host") << endl
         << _("  -P --password    : Login with this password") << endl
@@ -567,7 +606,7 @@ static void printVersion()
 
 static void parseOptions(int argc, char *argv[], Options &options)
 {
-    const char *optstring = "hvud:U:P:Dc:s:p:C:H:S:O";
+    const char *optstring = "hvud:U:P:Dc:s:p:C:H:S:Onk";
 
     const struct option long_options[] = {
         { "config-file", required_argument, 0, 'C' },
@@ -576,6 +615,8 @@ static void parseOptions(int argc, char *argv[], Options &options)
         { "password",    required_argument, 0, 'P' },
         { "character",   required_argument, 0, 'c' },
         { "help",        no_argument,       0, 'h' },
+        { "headless",    no_argument,       0, 'n' },
+        { "checksum",    no_argument,       0, 'k' },
         { "home-dir",    required_argument, 0, 'S' },
         { "update-host", required_argument, 0, 'H' },
         { "port",        required_argument, 0, 'p' },
@@ -640,6 +681,13 @@ static void parseOptions(int argc, char *argv[], Options &options)
             case 'O':
                 options.noOpenGL = true;
                 break;
+            case 'n':
+                options.headless = true;
+                break;
+            case 'k':
+                options.headless = true;
+                options.checksum = true;
+                break;
         }
     }
 }
@@ -790,6 +838,8 @@ int main(int argc, char *argv[])
     // Log the tmw version
     logger->log("The Mana World %s", FULL_VERSION);
 
+    Tracer::setThreadName("main");
+
     initConfiguration(options);
     logger->setLogToStandardOut(config.getValue("logToStandardOut", 0));
 
@@ -886,6 +936,7 @@ int main(int argc, char *argv[])
             Net::getGeneralHandler()->flushNetwork();
             Net::getGeneralHandler()->tick();
         }
+        ResourceManager::getInstance()->processAsyncLoads();
         gui->logic();
 
         if (progressBar && progressBar->isVisible())
@@ -895,6 +946,8 @@ int main(int argc, char *argv[])
                 progressBar->setProgress(0.0f);
         }
 
+        // The dialogs outside of the game don't report what changed
+        requestRedraw();
         gui->draw();
         graphics->updateScreen();
 
@@ -1298,6 +1351,7 @@ int main(int argc, char *argv[])
 #endif*/
 
     logger->log("Quitting");
+    Tracer::stop();
     exitEngine();
     PHYSFS_deinit();
     delete logger;
@@ -19,14 +19,18 @@
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
 #include <queue>
 
+#include <guichan/rectangle.hpp>
+
 #include "beingmanager.h"
 #include "configuration.h"
 #include "game.h"
 #include "graphics.h"
 #include "map.h"
 #include "particle.h"
+#include "profiler.h"
 #include "simpleanimation.h"
 #include "sprite.h"
 #include "tileset.h"
@@ -45,6 +49,64 @@ extern volatile int tick_time;
  */
 const int DEFAULT_TILE_SIDE_LENGTH = 32;
 
+/**
+ * The side-length in tiles of the pre-rendered chunks of map layers.
+ */
+static const int CHUNK_SIZE = 16;
+
+/**
+ * The number of bytes used by a full pre-rendered chunk, approximately the
+ * display surface and the copy of the alpha channel.
+ */
+static const int FULL_CHUNK_BYTES = CHUNK_SIZE * 32 * CHUNK_SIZE * 32 * 5;
+
+/**
+ * The number of bytes the pre-rendered chunks may use together. Set when
+ * drawing the map, to fit the chunks covering the screen and the ring of
+ * chunks around them. Chunks that weren't drawn for the longest time are
+ * freed first.
+ */
+static int chunkBudget = 0;
+
+/**
+ * Counts the frames drawn, to find out which chunks were used recently.
+ */
+static int frameCount = 0;
+
+int MapLayer::mChunkBytes = 0;
+
+/**
+ * The pathfinding data of a location on a tile map. It is only needed while
+ * searching for a path, so rather than being stored with each map, it is
+ * kept in a table that is reused by all searches.
+ */
+struct PathNode
+{
+    /**
+     * Constructor.
+     */
+    PathNode(): Gcost(0), whichList(0) {}
+
+    int Gcost;               /**< Cost from start to this location */
+    int Hcost;               /**< Estimated cost to goal */
+    int whichList;           /**< No list, open list or closed list */
+    int parent;              /**< Index of the parent location */
+};
+
+/**
+ * The pathfinding data, indexed by x + y * width of the map being searched.
+ * Grows to the size of the largest map searched.
+ */
+static std::vector<PathNode> pathNodes;
+
+/**
+ * The values of PathNode::whichList meaning that a location is on the closed
+ * or on the open list. Incremented after each search, so that the table
+ * doesn't need to be cleared in between searches.
+ */
+static int onClosedList = 1;
+static int onOpenList = 2;
+
 /**
  * A location on a tile map. Used for pathfinding, open list.
  */
@@ -53,8 +115,8 @@ struct Location
     /**
      * Constructor.
      */
-    Location(int px, int py, MetaTile *ptile):
-        x(px), y(py), tile(ptile)
+    Location(int px, int py, int pFcost):
+        x(px), y(py), Fcost(pFcost)
     {}
 
     /**
@@ -62,15 +124,17 @@ struct Location
      */
     bool operator< (const Location &loc) const
     {
-        return tile->Fcost > loc.tile->Fcost;
+        return Fcost > loc.Fcost;
     }
 
     int x, y;
-    MetaTile *tile;
+    int Fcost;               /**< Estimation of total path cost */
 };
 
-TileAnimation::TileAnimation(Animation *ani):
-    mLastImage(NULL)
+TileAnimation::TileAnimation(Animation *ani, Map *map, int tile):
+    mLastImage(NULL),
+    mMap(map),
+    mTile(tile)
 {
     mAnimation = new SimpleAnimation(ani);
 }
@@ -92,43 +156,116 @@ void TileAnimation::update(int ticks)
     Image *img = mAnimation->getCurrentImage();
     if (img != mLastImage)
     {
+        mMap->setTileImage(mTile, img);
+
         for (std::list<std::pair<MapLayer*, int> >::iterator i =
              mAffected.begin(); i != mAffected.end(); i++)
         {
-            i->first->setTile(i->second, img);
+            i->first->tileChanged(i->second);
         }
         mLastImage = img;
     }
 }
 
-MapLayer::MapLayer(int x, int y, int width, int height, bool isFringeLayer):
+MapLayer::MapLayer(int x, int y, int width, int height, bool isFringeLayer,
+                   const Map *map):
     mX(x), mY(y),
     mWidth(width), mHeight(height),
-    mIsFringeLayer(isFringeLayer)
+    mIsFringeLayer(isFringeLayer),
+    mMap(map),
+    mChunksX((width + CHUNK_SIZE - 1) / CHUNK_SIZE),
+    mChunksY((height + CHUNK_SIZE - 1) / CHUNK_SIZE),
+    mChunks(0)
 {
     const int size = mWidth * mHeight;
-    mTiles = new Image*[size];
-    std::fill_n(mTiles, size, (Image*) 0);
+    mTiles = new Uint16[size];
+    std::fill_n(mTiles, size, 0);
+
+    // Pre-rendering the tiles only pays off for the SDL backend, and the
+    // fringe layer needs to draw the sprites in between the tiles.
+    bool prerender = !mIsFringeLayer;
+#ifdef USE_OPENGL
+    if (Image::getLoadAsOpenGL())
+        prerender = false;
+#endif
+
+    if (prerender)
+        mChunks = new MapChunk[mChunksX * mChunksY];
+}
+
+/**
+ * Tells whether the given rectangles overlap.
+ */
+static bool intersects(const gcn::Rectangle &a, const gcn::Rectangle &b)
+{
+    return a.x < b.x + b.width && a.y < b.y + b.height &&
+           a.x + a.width > b.x && a.y + a.height > b.y;
+}
+
+/**
+ * Tells whether the given sprite may be visible within the given area.
+ */
+static bool isSpriteVisible(const Sprite *sprite, const gcn::Rectangle &area)
+{
+    gcn::Rectangle bounds;
+    return !sprite->getBounds(bounds) || intersects(bounds, area);
 }
 
 MapLayer::~MapLayer()
 {
+    if (mChunks)
+    {
+        for (int i = 0; i < mChunksX * mChunksY; i++)
+            freeChunk(mChunks[i]);
+        delete[] mChunks;
+    }
+
     delete[] mTiles;
 }
 
-void MapLayer::setTile(int x, int y, Image *img)
+void MapLayer::setTile(int x, int y, Uint16 tile)
+{
+    mTiles[x + y * mWidth] = tile;
+
+    // Tiles are only set while the map is loaded, which may be done in the
+    // background, so there is nothing to draw again
+    if (mChunks)
+        mChunks[x / CHUNK_SIZE + (y / CHUNK_SIZE) * mChunksX].dirty = true;
+}
+
+void MapLayer::tileChanged(int index)
 {
-    setTile(x + y * mWidth, img);
+    const int x = index % mWidth;
+    const int y = index / mWidth;
+
+    if (mChunks)
+        mChunks[x / CHUNK_SIZE + (y / CHUNK_SIZE) * mChunksX].dirty = true;
+
+    // Tiles are drawn upwards from the bottom of their cell
+    if (Image *img = mMap->getTileImage(mTiles[index]))
+    {
+        requestMapRedraw(gcn::Rectangle((x + mX) * 32,
+                                        (y + mY) * 32 + 32 - img->getHeight(),
+                                        img->getWidth(), img->getHeight()));
+    }
 }
 
 Image* MapLayer::getTile(int x, int y) const
 {
-    return mTiles[x + y * mWidth];
+    return mMap->getTileImage(mTiles[x + y * mWidth]);
+}
+
+int MapLayer::getMemoryUsage() const
+{
+    int bytes = sizeof(MapLayer) + mWidth * mHeight * sizeof(Uint16);
+    if (mChunks)
+        bytes += mChunksX * mChunksY * sizeof(MapChunk);
+    return bytes;
 }
 
 void MapLayer::draw(Graphics *graphics, int startX, int startY,
                     int endX, int endY, int scrollX, int scrollY,
-                    const MapSprites &sprites) const
+                    const MapSprites &sprites)
 {
     startX -= mX;
     startY -= mY;
@@ -140,19 +277,38 @@ void MapLayer::draw(Graphics *graphics, int startX, int startY,
     if (endX > mWidth) endX = mWidth;
     if (endY > mHeight) endY = mHeight;
 
+    if (mChunks)
+    {
+        drawChunks(graphics, startX, startY, endX, endY, scrollX, scrollY);
+        return;
+    }
+
+    const gcn::Rectangle area(scrollX, scrollY,
+                              graphics->getWidth(), graphics->getHeight());
     MapSprites::const_iterator si = sprites.begin();
+    int spriteRow = -1;
 
     for (int y = startY; y < endY; y++)
     {
-        // If drawing the fringe layer, make sure all sprites above this row of
-        // tiles have been drawn
+        // If drawing the fringe layer, make sure all sprites in the rows up to
+        // this row of tiles have been drawn
         if (mIsFringeLayer)
         {
-            while (si != sprites.end() && (*si)->getPixelY() <= y * 32)
+            for (; si != sprites.end(); ++si)
             {
+                if (!*si)
+                {
+                    if (spriteRow == y + mY)
+                        break;
+                    spriteRow++;
+                    continue;
+                }
+
+                if (!isSpriteVisible(*si, area))
+                    continue;
+
                 (*si)->setAlpha(1.0f);
                 (*si)->draw(graphics, -scrollX, -scrollY);
-                si++;
             }
         }
 
@@ -171,40 +327,271 @@ void MapLayer::draw(Graphics *graphics, int startX, int startY,
     // Draw any remaining sprites
     if (mIsFringeLayer)
     {
-        while (si != sprites.end())
+        for (; si != sprites.end(); ++si)
+        {
+            if (*si && isSpriteVisible(*si, area))
+            {
+                (*si)->setAlpha(1.0f);
+                (*si)->draw(graphics, -scrollX, -scrollY);
+            }
+        }
+    }
+}
+
+void MapLayer::markOccluded(Map *map) const
+{
+    for (int y = 0; y < mHeight; y++)
+    {
+        for (int x = 0; x < mWidth; x++)
+        {
+            const Image *img = getTile(x, y);
+            if (!img)
+                continue;
+
+            // Tiles are aligned to the bottom left of their location
+            const int startX = std::max(x + mX, 0);
+            const int endX = std::min(x + mX + (img->getWidth() + 31) / 32,
+                                      map->getWidth());
+            const int rows = (img->getHeight() + 31) / 32;
+            const int startY = std::max(y + mY + 1 - rows, 0);
+            const int endY = std::min(y + mY + 1, map->getHeight());
+
+            for (int ty = startY; ty < endY; ty++)
+                for (int tx = startX; tx < endX; tx++)
+                    map->setOccluded(tx, ty);
+        }
+    }
+}
+
+void MapLayer::drawTiles(Graphics *graphics, int startX, int startY,
+                         int endX, int endY, int scrollX, int scrollY) const
+{
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
+        {
+            Image *img = getTile(x, y);
+            if (img)
+            {
+                const int px = (x + mX) * 32 - scrollX;
+                const int py = (y + mY) * 32 - scrollY + 32 - img->getHeight();
+                graphics->drawImage(img, px, py);
+            }
+        }
+    }
+}
+
+void MapLayer::drawChunks(Graphics *graphics, int startX, int startY,
+                          int endX, int endY, int scrollX, int scrollY)
+{
+    if (startX >= endX || startY >= endY)
+        return;
+
+    const int startChunkX = startX / CHUNK_SIZE;
+    const int startChunkY = startY / CHUNK_SIZE;
+    const int endChunkX = (endX + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const int endChunkY = (endY + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    for (int cy = startChunkY; cy < endChunkY; cy++)
+    {
+        for (int cx = startChunkX; cx < endChunkX; cx++)
+        {
+            MapChunk &chunk = mChunks[cx + cy * mChunksX];
+
+            if (chunk.dirty)
+                buildChunk(cx, cy);
+
+            chunk.lastUsed = frameCount;
+
+            if (chunk.uncacheable)
+            {
+                // Draw the visible part tile by tile instead
+                drawTiles(graphics,
+                          std::max(startX, cx * CHUNK_SIZE),
+                          std::max(startY, cy * CHUNK_SIZE),
+                          std::min(endX, (cx + 1) * CHUNK_SIZE),
+                          std::min(endY, (cy + 1) * CHUNK_SIZE),
+                          scrollX, scrollY);
+            }
+            else if (chunk.image)
+            {
+                graphics->drawImage(chunk.image,
+                        (mX + cx * CHUNK_SIZE) * 32 - scrollX,
+                        (mY + cy * CHUNK_SIZE) * 32 - scrollY);
+            }
+        }
+    }
+
+    // Prepare one of the chunks around the visible ones, so that they are
+    // ready by the time they scroll into view.
+    for (int cy = std::max(0, startChunkY - 1);
+         cy < std::min(mChunksY, endChunkY + 1); cy++)
+    {
+        for (int cx = std::max(0, startChunkX - 1);
+             cx < std::min(mChunksX, endChunkX + 1); cx++)
+        {
+            MapChunk &chunk = mChunks[cx + cy * mChunksX];
+            if (chunk.dirty)
+            {
+                // The chunks on screen take precedence
+                if (mChunkBytes + FULL_CHUNK_BYTES > chunkBudget)
+                    return;
+
+                buildChunk(cx, cy);
+                chunk.lastUsed = frameCount;
+                return;
+            }
+        }
+    }
+}
+
+void MapLayer::buildChunk(int chunkX, int chunkY)
+{
+    MapChunk &chunk = mChunks[chunkX + chunkY * mChunksX];
+
+    freeChunk(chunk);
+    chunk.dirty = false;
+    chunk.uncacheable = false;
+
+    const int startX = chunkX * CHUNK_SIZE;
+    const int startY = chunkY * CHUNK_SIZE;
+    const int endX = std::min(mWidth, startX + CHUNK_SIZE);
+    const int endY = std::min(mHeight, startY + CHUNK_SIZE);
+
+    // Tiles sticking out of their grid cell would be cut off, or would need
+    // to be drawn in a different order.
+    bool empty = true;
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
+        {
+            Image *img = getTile(x, y);
+            if (!img)
+                continue;
+
+            empty = false;
+            if (img->getWidth() != 32 || img->getHeight() != 32)
+            {
+                chunk.uncacheable = true;
+                return;
+            }
+        }
+    }
+
+    if (empty)
+        return;
+
+    // Determine 32-bit masks based on byte order
+    Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0xff000000;
+    gmask = 0x00ff0000;
+    bmask = 0x0000ff00;
+    amask = 0x000000ff;
+#else
+    rmask = 0x000000ff;
+    gmask = 0x0000ff00;
+    bmask = 0x00ff0000;
+    amask = 0xff000000;
+#endif
+
+    const int width = (endX - startX) * 32;
+    const int height = (endY - startY) * 32;
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE,
+            width, height, 32, rmask, gmask, bmask, amask);
+
+    if (!surface)
+    {
+        chunk.uncacheable = true;
+        return;
+    }
+
+    // The surface starts out fully transparent
+    SDL_FillRect(surface, NULL, 0);
+
+    for (int y = startY; y < endY; y++)
+    {
+        for (int x = startX; x < endX; x++)
         {
-            (*si)->setAlpha(1.0f);
-            (*si)->draw(graphics, -scrollX, -scrollY);
-            si++;
+            if (Image *img = getTile(x, y))
+                img->SDLblendOnto(surface, (x - startX) * 32, (y - startY) * 32);
         }
     }
+
+    // Loading drops the alpha channel when the chunk is fully opaque
+    chunk.image = Image::load(surface);
+    SDL_FreeSurface(surface);
+
+    if (!chunk.image)
+    {
+        chunk.uncacheable = true;
+        return;
+    }
+
+    // Approximately the display surface and the copy of the alpha channel
+    mChunkBytes += width * height * 5;
+}
+
+void MapLayer::freeChunk(MapChunk &chunk)
+{
+    if (!chunk.image)
+        return;
+
+    mChunkBytes -= chunk.image->getWidth() * chunk.image->getHeight() * 5;
+    delete chunk.image;
+    chunk.image = 0;
+    chunk.dirty = true;
+}
+
+bool MapLayer::freeOldestChunk(int frame)
+{
+    if (!mChunks)
+        return false;
+
+    MapChunk *oldest = 0;
+
+    for (int i = 0; i < mChunksX * mChunksY; i++)
+    {
+        MapChunk &chunk = mChunks[i];
+        if (chunk.image && chunk.lastUsed < frame &&
+            (!oldest || chunk.lastUsed < oldest->lastUsed))
+        {
+            oldest = &chunk;
+        }
+    }
+
+    if (!oldest)
+        return false;
+
+    freeChunk(*oldest);
+    return true;
 }
 
 Map::Map(int width, int height, int tileWidth, int tileHeight):
     mWidth(width), mHeight(height),
     mTileWidth(tileWidth), mTileHeight(tileHeight),
     mMaxTileHeight(height),
-    mOnClosedList(1), mOnOpenList(2),
     mLastScrollX(0.0f), mLastScrollY(0.0f)
 {
     const int size = mWidth * mHeight;
 
-    mMetaTiles = new MetaTile[size];
-    for (int i = 0; i < NB_BLOCKTYPES; i++)
-    {
-        mOccupation[i] = new int[size];
-        memset(mOccupation[i], 0, size * sizeof(int));
-    }
+    mBlockMasks = new unsigned char[(size + 1) / 2];
+    memset(mBlockMasks, 0, (size + 1) / 2);
+    mOccluded.resize(size, false);
+
+    // Index 0 of the tile table means no tile
+    mTileImages.push_back(0);
+
+    // Sprites below the last tile row go in an extra row
+    for (int y = 0; y <= mHeight; y++)
+        mSpriteRows.push_back(mSprites.insert(mSprites.end(), (Sprite*) 0));
 }
 
 Map::~Map()
 {
     // delete metadata, layers, tilesets and overlays
-    delete[] mMetaTiles;
-    for (int i = 0; i < NB_BLOCKTYPES; i++)
-    {
-        delete[] mOccupation[i];
-    }
+    delete[] mBlockMasks;
     delete_all(mLayers);
     delete_all(mTilesets);
     delete_all(mOverlays);
@@ -243,6 +630,38 @@ void Map::addLayer(MapLayer *layer)
     mLayers.push_back(layer);
 }
 
+void Map::initializeOcclusion()
+{
+    // Only the fringe layer and the layers after it are drawn over sprites
+    bool drawnOverSprites = false;
+
+    for (Layers::const_iterator it = mLayers.begin(); it != mLayers.end(); ++it)
+    {
+        if ((*it)->isFringeLayer())
+            drawnOverSprites = true;
+
+        if (drawnOverSprites)
+            (*it)->markOccluded(this);
+    }
+}
+
+bool Map::isOccluded(const gcn::Rectangle &area) const
+{
+    const int startX = std::max(area.x / mTileWidth, 0);
+    const int startY = std::max(area.y / mTileHeight, 0);
+    const int endX = std::min((area.x + area.width + mTileWidth - 1)
+                              / mTileWidth, mWidth);
+    const int endY = std::min((area.y + area.height + mTileHeight - 1)
+                              / mTileHeight, mHeight);
+
+    for (int y = startY; y < endY; y++)
+        for (int x = startX; x < endX; x++)
+            if (mOccluded[x + y * mWidth])
+                return true;
+
+    return false;
+}
+
 void Map::addTileset(Tileset *tileset)
 {
     mTilesets.push_back(tileset);
@@ -251,11 +670,6 @@ void Map::addTileset(Tileset *tileset)
         mMaxTileHeight = tileset->getHeight();
 }
 
-bool spriteCompare(const Sprite *a, const Sprite *b)
-{
-    return a->getPixelY() < b->getPixelY();
-}
-
 void Map::update(int ticks)
 {
     //update animated tiles
@@ -265,10 +679,16 @@ void Map::update(int ticks)
     {
         iAni->second->update(ticks);
     }
+
+    // The ambient overlays drift with time
+    if (!mOverlays.empty() && config.getValue("OverlayDetail", 2) > 0)
+        requestRedraw();
 }
 
 void Map::draw(Graphics *graphics, int scrollX, int scrollY)
 {
+    ProfileScope scope(Profiler::MAP);
+
     int endPixelY = graphics->getHeight() + scrollY + mTileHeight - 1;
 
     // TODO: Do this per-layer
@@ -280,7 +700,22 @@ void Map::draw(Graphics *graphics, int scrollX, int scrollY)
     int endY = endPixelY / mTileHeight;
 
     // Make sure sprites are sorted
-    mSprites.sort(spriteCompare);
+    sortSprites();
+
+    // The chunks that may cover the screen when it is not aligned to them,
+    // plus the ring of chunks around them that is prepared ahead of time
+    const int chunkPixels = CHUNK_SIZE * 32;
+    const int chunksX = (graphics->getWidth() + chunkPixels - 1)
+                        / chunkPixels + 3;
+    const int chunksY = (graphics->getHeight() + chunkPixels - 1)
+                        / chunkPixels + 3;
+
+    int prerenderedLayers = 0;
+    for (Layers::const_iterator i = mLayers.begin(); i != mLayers.end(); ++i)
+        if ((*i)->isPrerendered())
+            prerenderedLayers++;
+
+    chunkBudget = prerenderedLayers * chunksX * chunksY * FULL_CHUNK_BYTES;
 
     // draw the game world
     Layers::const_iterator layeri = mLayers.begin();
@@ -292,21 +727,44 @@ void Map::draw(Graphics *graphics, int scrollX, int scrollY)
                         mSprites);
     }
 
+    // Keep the pre-rendered chunks within their memory budget. Chunks drawn
+    // or prepared in the last frame are kept, since they are likely to be
+    // needed again right away.
+    while (MapLayer::getChunkBytes() > chunkBudget)
+    {
+        bool freed = false;
+        for (layeri = mLayers.begin(); layeri != mLayers.end(); ++layeri)
+            freed |= (*layeri)->freeOldestChunk(frameCount - 1);
+
+        if (!freed)
+            break;
+    }
+    frameCount++;
+
     // Draws beings with a lower opacity to make them visible
     // even when covered by a wall or some other elements...
+    const gcn::Rectangle area(scrollX, scrollY,
+                              graphics->getWidth(), graphics->getHeight());
     MapSprites::const_iterator si = mSprites.begin();
     while (si != mSprites.end())
     {
-        if (Sprite *sprite = *si)
+        Sprite *sprite = *si;
+        si++;
+
+        // For now, just draw sprites with only one layer.
+        if (!sprite || sprite->getNumberOfLayers() != 1)
+            continue;
+
+        // Skip sprites that are off screen or not covered by any tiles
+        gcn::Rectangle bounds;
+        if (sprite->getBounds(bounds))
         {
-            // For now, just draw sprites with only one layer.
-            if (sprite->getNumberOfLayers() == 1)
-            {
-                sprite->setAlpha(0.3f);
-                sprite->draw(graphics, -scrollX, -scrollY);
-            }
+            if (!intersects(bounds, area) || !isOccluded(bounds))
+                continue;
         }
-        si++;
+
+        sprite->setAlpha(0.3f);
+        sprite->draw(graphics, -scrollX, -scrollY);
     }
 
     drawOverlay(graphics, scrollX, scrollY,
@@ -406,52 +864,39 @@ void Map::drawOverlay(Graphics *graphics,
     }
 }
 
-class ContainsGidFunctor
-{
-    public:
-        bool operator() (const Tileset *set) const
-        {
-            return (set->getFirstGid() <= gid &&
-                    gid - set->getFirstGid() < (int)set->size());
-        }
-        int gid;
-} containsGid;
-
-Tileset *Map::getTilesetWithGid(int gid) const
-{
-    containsGid.gid = gid;
-
-    Tilesets::const_iterator i = find_if(mTilesets.begin(), mTilesets.end(),
-            containsGid);
-
-    return (i == mTilesets.end()) ? NULL : *i;
-}
-
 void Map::blockTile(int x, int y, BlockType type)
 {
     if (type == BLOCKTYPE_NONE || !contains(x, y))
         return;
 
     const int tileNum = x + y * mWidth;
+    unsigned char mask = 0;
 
-    if ((++mOccupation[type][tileNum]) > 0)
+    switch (type)
     {
-        switch (type)
-        {
-            case BLOCKTYPE_WALL:
-                mMetaTiles[tileNum].blockmask |= BLOCKMASK_WALL;
-                break;
-            case BLOCKTYPE_CHARACTER:
-                mMetaTiles[tileNum].blockmask |= BLOCKMASK_CHARACTER;
-                break;
-            case BLOCKTYPE_MONSTER:
-                mMetaTiles[tileNum].blockmask |= BLOCKMASK_MONSTER;
-                break;
-            default:
-                // shut up!
-                break;
-        }
+        case BLOCKTYPE_WALL:
+            mask = BLOCKMASK_WALL;
+            break;
+        case BLOCKTYPE_CHARACTER:
+            mask = BLOCKMASK_CHARACTER;
+            break;
+        case BLOCKTYPE_MONSTER:
+            mask = BLOCKMASK_MONSTER;
+            break;
+        default:
+            // shut up!
+            break;
     }
+
+    mBlockMasks[tileNum >> 1] |= mask << ((tileNum & 1) * 4);
+}
+
+void Map::setTileImage(int index, Image *img)
+{
+    if (index >= (int) mTileImages.size())
+        mTileImages.resize(index + 1, 0);
+
+    mTileImages[index] = img;
 }
 
 bool Map::getWalk(int x, int y, unsigned char walkmask) const
@@ -461,7 +906,7 @@ bool Map::getWalk(int x, int y, unsigned char walkmask) const
         return false;
 
     // Check if the tile is walkable
-    return !(mMetaTiles[x + y * mWidth].blockmask & walkmask);
+    return !(getBlockMask(x + y * mWidth) & walkmask);
 }
 
 #ifdef EATHENA_SUPPORT
@@ -486,15 +931,88 @@ bool Map::contains(int x, int y) const
     return x >= 0 && y >= 0 && x < mWidth && y < mHeight;
 }
 
-MetaTile *Map::getMetaTile(int x, int y) const
+int Map::getMemoryUsage() const
 {
-    return &mMetaTiles[x + y * mWidth];
+    const int size = mWidth * mHeight;
+
+    int bytes = sizeof(Map);
+    bytes += (size + 1) / 2;                    // mBlockMasks
+    bytes += (size + 7) / 8;                    // mOccluded
+    bytes += mTileImages.capacity() * sizeof(Image*);
+
+    for (Layers::const_iterator i = mLayers.begin(); i != mLayers.end(); ++i)
+        bytes += (*i)->getMemoryUsage();
+
+    return bytes;
+}
+
+int Map::getPathfindingMemoryUsage()
+{
+    return pathNodes.capacity() * sizeof(PathNode);
+}
+
+int Map::getSpriteRow(const Sprite *sprite) const
+{
+    const int pixelY = sprite->getPixelY();
+    if (pixelY <= 0)
+        return 0;
+
+    const int row = (pixelY + mTileHeight - 1) / mTileHeight;
+    return std::min(row, mHeight);
+}
+
+void Map::placeSprite(MapSprite sprite, MapSprite rowEnd)
+{
+    const int pixelY = (*sprite)->getPixelY();
+
+    // Walk back past the sprites that are lower on the screen
+    MapSprite pos = rowEnd;
+    for (;;)
+    {
+        MapSprite prev = pos;
+        --prev;
+        if (prev == sprite || !*prev || (*prev)->getPixelY() <= pixelY)
+            break;
+        pos = prev;
+    }
+
+    if (pos != sprite)
+        mSprites.splice(pos, mSprites, sprite);
+}
+
+void Map::sortSprites()
+{
+    int row = -1;
+    MapSprite si = mSprites.begin();
+    while (si != mSprites.end())
+    {
+        const MapSprite current = si++;
+        if (!*current)
+        {
+            row++;
+            continue;
+        }
+
+        const int newRow = getSpriteRow(*current);
+        if (newRow == row)
+        {
+            placeSprite(current, current);
+        }
+        else
+        {
+            const MapSprite rowEnd = newRow < mHeight ?
+                mSpriteRows[newRow + 1] : mSprites.end();
+            placeSprite(current, rowEnd);
+        }
+    }
 }
 
 MapSprite Map::addSprite(Sprite *sprite)
 {
-    mSprites.push_front(sprite);
-    return mSprites.begin();
+    const int row = getSpriteRow(sprite);
+    const MapSprite rowEnd = row < mHeight ?
+        mSpriteRows[row + 1] : mSprites.end();
+    return mSprites.insert(rowEnd, sprite);
 }
 
 void Map::removeSprite(MapSprite iterator)
@@ -529,12 +1047,17 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
     // Return when destination not walkable
     if (!getWalk(destX, destY, walkmask)) return path;
 
+    // Make sure the pathfinding data covers this map
+    const unsigned int size = mWidth * mHeight;
+    if (pathNodes.size() < size)
+        pathNodes.resize(size);
+
     // Reset starting tile's G cost to 0
-    MetaTile *startTile = getMetaTile(startX, startY);
-    startTile->Gcost = 0;
+    PathNode &startNode = pathNodes[startX + startY * mWidth];
+    startNode.Gcost = 0;
 
     // Add the start point to the open list
-    openList.push(Location(startX, startY, startTile));
+    openList.push(Location(startX, startY, 0));
 
     bool foundPath = false;
 
@@ -545,15 +1068,18 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
         Location curr = openList.top();
         openList.pop();
 
+        const int currIndex = curr.x + curr.y * mWidth;
+        PathNode &currNode = pathNodes[currIndex];
+
         // If the tile is already on the closed list, this means it has already
         // been processed with a shorter path to the start point (lower G cost)
-        if (curr.tile->whichList == mOnClosedList)
+        if (currNode.whichList == onClosedList)
         {
             continue;
         }
 
         // Put the current tile on the closed list
-        curr.tile->whichList = mOnClosedList;
+        currNode.whichList = onClosedList;
 
         // Check the adjacent tiles
         for (int dy = -1; dy <= 1; dy++)
@@ -571,12 +1097,13 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
                     continue;
                 }
 
-                MetaTile *newTile = getMetaTile(x, y);
+                const int newIndex = x + y * mWidth;
+                PathNode &newNode = pathNodes[newIndex];
 
                 // Skip if the tile is on the closed list or is not walkable
                 // unless its the destination tile
-                if (newTile->whichList == mOnClosedList ||
-                    ((newTile->blockmask & walkmask)
+                if (newNode.whichList == onClosedList ||
+                    ((getBlockMask(newIndex) & walkmask)
                      && !(x == destX && y == destY)))
                 {
                     continue;
@@ -586,15 +1113,15 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
                 // corner.
                 if (dx != 0 && dy != 0)
                 {
-                    MetaTile *t1 = getMetaTile(curr.x, curr.y + dy);
-                    MetaTile *t2 = getMetaTile(curr.x + dx, curr.y);
+                    const int t1 = currIndex + dy * mWidth;
+                    const int t2 = currIndex + dx;
 
-                    if ((t1->blockmask | t2->blockmask) & BLOCKMASK_WALL)
+                    if ((getBlockMask(t1) | getBlockMask(t2)) & BLOCKMASK_WALL)
                         continue;
                 }
 
                 // Calculate G cost for this route, ~sqrt(2) for moving diagonal
-                int Gcost = curr.tile->Gcost +
+                int Gcost = currNode.Gcost +
                     (dx == 0 || dy == 0 ? basicCost : basicCost * 362 / 256);
 
                 /* Demote an arbitrary direction to speed pathfinding by
@@ -627,7 +1154,7 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
                     continue;
                 }
 
-                if (newTile->whichList != mOnOpenList)
+                if (newNode.whichList != onOpenList)
                 {
                     // Found a new tile (not on open nor on closed list)
 
@@ -636,41 +1163,37 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
                        real cost. In particular, using Manhattan distance is
                        forbidden here. */
                     int dx = std::abs(x - destX), dy = std::abs(y - destY);
-                    newTile->Hcost = std::abs(dx - dy) * basicCost +
+                    newNode.Hcost = std::abs(dx - dy) * basicCost +
                         std::min(dx, dy) * (basicCost * 362 / 256);
 
                     // Set the current tile as the parent of the new tile
-                    newTile->parentX = curr.x;
-                    newTile->parentY = curr.y;
+                    newNode.parent = currIndex;
 
-                    // Update Gcost and Fcost of new tile
-                    newTile->Gcost = Gcost;
-                    newTile->Fcost = Gcost + newTile->Hcost;
+                    // Update Gcost of new tile
+                    newNode.Gcost = Gcost;
 
                     if (x != destX || y != destY) {
                         // Add this tile to the open list
-                        newTile->whichList = mOnOpenList;
-                        openList.push(Location(x, y, newTile));
+                        newNode.whichList = onOpenList;
+                        openList.push(Location(x, y, Gcost + newNode.Hcost));
                     }
                     else {
                         // Target location was found
                         foundPath = true;
                     }
                 }
-                else if (Gcost < newTile->Gcost)
+                else if (Gcost < newNode.Gcost)
                 {
                     // Found a shorter route.
-                    // Update Gcost and Fcost of the new tile
-                    newTile->Gcost = Gcost;
-                    newTile->Fcost = Gcost + newTile->Hcost;
+                    // Update Gcost of the new tile
+                    newNode.Gcost = Gcost;
 
                     // Set the current tile as the parent of the new tile
-                    newTile->parentX = curr.x;
-                    newTile->parentY = curr.y;
+                    newNode.parent = currIndex;
 
                     // Add this tile to the open list (it's already
                     // there, but this instance has a lower F score)
-                    openList.push(Location(x, y, newTile));
+                    openList.push(Location(x, y, Gcost + newNode.Hcost));
                 }
             }
         }
@@ -678,8 +1201,8 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
 
     // Two new values to indicate whether a tile is on the open or closed list,
     // this way we don't have to clear all the values between each pathfinding.
-    mOnClosedList += 2;
-    mOnOpenList += 2;
+    onClosedList += 2;
+    onOpenList += 2;
 
     // If a path has been found, iterate backwards using the parent locations
     // to extract it.
@@ -694,15 +1217,21 @@ Path Map::findPath(int startX, int startY, int destX, int destY,
             path.push_front(Position(pathX, pathY));
 
             // Find out the next parent
-            MetaTile *tile = getMetaTile(pathX, pathY);
-            pathX = tile->parentX;
-            pathY = tile->parentY;
+            const int parent = pathNodes[pathX + pathY * mWidth].parent;
+            pathX = parent % mWidth;
+            pathY = parent / mWidth;
         }
     }
 
     return path;
 }
 
+int Map::getPathCost(int x, int y) const
+{
+    const unsigned int index = x + y * mWidth;
+    return index < pathNodes.size() ? pathNodes[index].Gcost : 0;
+}
+
 void Map::addParticleEffect(const std::string &effectFile, int x, int y)
 {
     ParticleEffectData newEffect;
@@ -25,6 +25,9 @@
 #include <list>
 #include <vector>
 
+#include <SDL_types.h>
+
+#include "guichanfwd.h"
 #include "position.h"
 #include "properties.h"
 
@@ -32,6 +35,7 @@ class Animation;
 class AmbientOverlay;
 class Graphics;
 class Image;
+class Map;
 class MapLayer;
 class Particle;
 class SimpleAnimation;
@@ -46,34 +50,14 @@ typedef std::vector<MapLayer*> Layers;
 extern const int DEFAULT_TILE_SIDE_LENGTH;
 
 /**
- * A meta tile stores additional information about a location on a tile map.
- * This is information that doesn't need to be repeated for each tile in each
- * layer of the map.
- */
-struct MetaTile
-{
-    /**
-     * Constructor.
-     */
-    MetaTile() : whichList(0), blockmask(0) {}
-
-    // Pathfinding members
-    int Fcost;               /**< Estimation of total path cost */
-    int Gcost;               /**< Cost from start to this location */
-    int Hcost;               /**< Estimated cost to goal */
-    int whichList;           /**< No list, open list or closed list */
-    int parentX;             /**< X coordinate of parent tile */
-    int parentY;             /**< Y coordinate of parent tile */
-    unsigned char blockmask; /**< Blocking properties of this tile */
-};
-
-/**
- * Animation cycle of a tile image which changes the map accordingly.
+ * Animation cycle of a tile image which changes the map accordingly. The
+ * animation replaces the image of its tile in the tile table of the map, and
+ * tells the layers using the tile that it changed.
  */
 class TileAnimation
 {
     public:
-        TileAnimation(Animation *ani);
+        TileAnimation(Animation *ani, Map *map, int tile);
         ~TileAnimation();
         void update(int ticks = 1);
         void addAffectedTile(MapLayer *layer, int index)
@@ -82,11 +66,30 @@ class TileAnimation
         std::list<std::pair<MapLayer*, int> > mAffected;
         SimpleAnimation *mAnimation;
         Image *mLastImage;
+        Map *mMap;
+        int mTile;              /**< Index in the tile table of the map */
+};
+
+/**
+ * A block of tiles of a map layer, pre-rendered into a single image.
+ */
+struct MapChunk
+{
+    MapChunk(): image(0), dirty(true), uncacheable(false), lastUsed(0) {}
+
+    Image *image;            /**< The tiles, NULL when empty or not built */
+    bool dirty;              /**< Needs to be built before being drawn */
+    bool uncacheable;        /**< Has tiles that don't fit the tile grid */
+    int lastUsed;            /**< The frame the chunk was last drawn in */
 };
 
 /**
  * A map layer. Stores a grid of tiles and their offset, and implements layer
- * rendering.
+ * rendering. The tiles are stored as indexes in the tile table of the map,
+ * with 0 meaning no tile.
+ *
+ * With the SDL backend, the tiles of layers that don't draw sprites are
+ * pre-rendered in chunks, so that drawing the layer takes a few blits.
  */
 class MapLayer
 {
@@ -94,9 +97,11 @@ class MapLayer
         /**
          * Constructor, taking layer origin, size and whether this layer is the
          * fringe layer. The fringe layer is the layer that draws the sprites.
-         * There can be only one fringe layer per map.
+         * There can be only one fringe layer per map. The layer looks up its
+         * tiles in the tile table of the given map.
          */
-        MapLayer(int x, int y, int width, int height, bool isFringeLayer);
+        MapLayer(int x, int y, int width, int height, bool isFringeLayer,
+                 const Map *map);
 
         /**
          * Destructor.
@@ -104,14 +109,16 @@ class MapLayer
         ~MapLayer();
 
         /**
-         * Set tile image, with x and y in layer coordinates.
+         * Set tile, with x and y in layer coordinates and the tile given as
+         * index in the tile table of the map.
          */
-        void setTile(int x, int y, Image *img);
+        void setTile(int x, int y, Uint16 tile);
 
         /**
-         * Set tile image with x + y * width already known.
+         * Tells the layer that the image of the tile at x + y * width has
+         * changed in the tile table, so that it gets drawn again.
          */
-        void setTile(int index, Image *img) { mTiles[index] = img; }
+        void tileChanged(int index);
 
         /**
          * Get tile image, with x and y in layer coordinates.
@@ -124,19 +131,89 @@ class MapLayer
          * coordinates and clipped to the layer's dimensions.
          *
          * The given sprites are only drawn when this layer is the fringe
-         * layer.
+         * layer. They are expected to be ordered by tile row, with each row
+         * preceded by a NULL entry (see Map::sortSprites).
          */
         void draw(Graphics *graphics,
                   int startX, int startY,
                   int endX, int endY,
                   int scrollX, int scrollY,
-                  const MapSprites &sprites) const;
+                  const MapSprites &sprites);
+
+        /**
+         * Returns whether this layer is the fringe layer.
+         */
+        bool isFringeLayer() const { return mIsFringeLayer; }
+
+        /**
+         * Returns whether the tiles of this layer are pre-rendered in chunks.
+         */
+        bool isPrerendered() const { return mChunks != 0; }
+
+        /**
+         * Marks the locations of the given map that are covered by the tiles
+         * of this layer as occluded.
+         */
+        void markOccluded(Map *map) const;
+
+        /**
+         * Frees the pre-rendered chunk that was drawn longest ago, as long as
+         * it wasn't drawn in the given frame.
+         *
+         * @return <code>true</code> if a chunk was freed, <code>false</code>
+         *         otherwise.
+         */
+        bool freeOldestChunk(int frame);
+
+        /**
+         * Returns the number of bytes used by the tiles of this layer, not
+         * counting the pre-rendered chunks.
+         */
+        int getMemoryUsage() const;
+
+        /**
+         * Returns the number of bytes used by the pre-rendered chunks of all
+         * layers.
+         */
+        static int getChunkBytes() { return mChunkBytes; }
 
     private:
+        /**
+         * Draws the tiles within the given range, in layer coordinates.
+         */
+        void drawTiles(Graphics *graphics,
+                       int startX, int startY,
+                       int endX, int endY,
+                       int scrollX, int scrollY) const;
+
+        /**
+         * Draws the tiles within the given range using pre-rendered chunks.
+         */
+        void drawChunks(Graphics *graphics,
+                        int startX, int startY,
+                        int endX, int endY,
+                        int scrollX, int scrollY);
+
+        /**
+         * Pre-renders the tiles of the given chunk.
+         */
+        void buildChunk(int chunkX, int chunkY);
+
+        /**
+         * Frees the image of the given chunk.
+         */
+        void freeChunk(MapChunk &chunk);
+
         int mX, mY;
         int mWidth, mHeight;
         bool mIsFringeLayer;    /**< Whether the sprites are drawn. */
-        Image **mTiles;
+        const Map *mMap;
+        Uint16 *mTiles;         /**< Indexes in the tile table of the map */
+
+        int mChunksX, mChunksY;
+        MapChunk *mChunks;      /**< NULL when not pre-rendering. */
+
+        static int mChunkBytes;
 };
 
 /**
@@ -156,7 +233,7 @@ class Map : public Properties
 
         enum BlockMask
         {
-            BLOCKMASK_WALL      = 0x80, // = bin 1000 0000
+            BLOCKMASK_WALL      = 0x04, // = bin 0000 0100
             BLOCKMASK_CHARACTER = 0x01, // = bin 0000 0001
             BLOCKMASK_MONSTER   = 0x02  // = bin 0000 0010
         };
@@ -177,6 +254,12 @@ class Map : public Properties
          */
         void initializeOverlays();
 
+        /**
+         * Determines which locations are covered by the tiles drawn over the
+         * sprites. Should be called after all the layers are added.
+         */
+        void initializeOcclusion();
+
         /**
          * Updates animations. Called as needed.
          */
@@ -208,20 +291,27 @@ class Map : public Properties
         void addTileset(Tileset *tileset);
 
         /**
-         * Finds the tile set that a tile with the given global id is part of.
+         * Sets the image of the given entry of the tile table. The layers
+         * store their tiles as indexes in this table, with 0 meaning no tile.
+         * Entries that are not set have no image.
          */
-        Tileset *getTilesetWithGid(int gid) const;
+        void setTileImage(int index, Image *img);
 
         /**
-         * Get tile reference.
+         * Returns the image of the given entry of the tile table.
          */
-        MetaTile *getMetaTile(int x, int y) const;
+        Image *getTileImage(int index) const { return mTileImages[index]; }
 
         /**
          * Marks a tile as occupied.
          */
         void blockTile(int x, int y, BlockType type);
 
+        /**
+         * Marks a location as covered by tiles drawn after the sprites.
+         */
+        void setOccluded(int x, int y) { mOccluded[x + y * mWidth] = true; }
+
         /**
          * Gets walkability for a tile with a blocking bitmask. When called
          * without walkmask, only blocks against colliding tiles.
@@ -265,6 +355,24 @@ class Map : public Properties
         Path findPath(int startX, int startY, int destX, int destY,
                       unsigned char walkmask, int maxCost = 20);
 
+        /**
+         * Returns the cost from the start to the given location, as found by
+         * the last call to findPath. Only meant for debugging.
+         */
+        int getPathCost(int x, int y) const;
+
+        /**
+         * Returns the number of bytes used by the tiles of this map, not
+         * counting the tile images and the pre-rendered chunks.
+         */
+        int getMemoryUsage() const;
+
+        /**
+         * Returns the number of bytes used by the pathfinding data, which is
+         * shared by all maps.
+         */
+        static int getPathfindingMemoryUsage();
+
         /**
          * Adds a sprite to the map.
          */
@@ -309,20 +417,47 @@ class Map : public Properties
         bool contains(int x, int y) const;
 
         /**
-         * Blockmasks for different entities
+         * Tells whether the given area in map pixel coordinates overlaps with
+         * tiles drawn over the sprites.
+         */
+        bool isOccluded(const gcn::Rectangle &area) const;
+
+        /**
+         * Returns the sprite row the given sprite belongs to. Sprites in a row
+         * are drawn before the tiles of that row on the fringe layer.
+         */
+        int getSpriteRow(const Sprite *sprite) const;
+
+        /**
+         * Moves the given sprite to its place in the row ending at the given
+         * position, keeping the row ordered by pixel Y.
+         */
+        void placeSprite(MapSprite sprite, MapSprite rowEnd);
+
+        /**
+         * Moves the sprites whose pixel Y changed to their new place. Since
+         * most sprites stay in their row between frames, this is much cheaper
+         * than sorting all sprites.
          */
-        int *mOccupation[NB_BLOCKTYPES];
+        void sortSprites();
+
+        /**
+         * Returns the blocking bitmask of the given tile. The masks of two
+         * tiles are packed in each byte, since they fit in four bits.
+         */
+        unsigned char getBlockMask(int tileNum) const
+        { return (mBlockMasks[tileNum >> 1] >> ((tileNum & 1) * 4)) & 0x0F; }
 
         int mWidth, mHeight;
         int mTileWidth, mTileHeight;
         int mMaxTileHeight;
-        MetaTile *mMetaTiles;
+        unsigned char *mBlockMasks;     /**< Blocking bits, two tiles a byte */
+        std::vector<bool> mOccluded;    /**< Covered by tiles drawn later */
+        std::vector<Image*> mTileImages;
         Layers mLayers;
         Tilesets mTilesets;
-        MapSprites mSprites;
-
-        // Pathfinding members
-        int mOnClosedList, mOnOpenList;
+        MapSprites mSprites;    /**< Ordered by row, rows start with NULL */
+        std::vector<MapSprite> mSpriteRows; /**< The start of each row */
 
         // Overlay data
         std::list<AmbientOverlay*> mOverlays;
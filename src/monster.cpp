@@ -44,7 +44,7 @@ Monster::Monster(int id, int job, Map *map):
          i != sprites.end(); i++)
     {
         std::string file = "graphics/sprites/" + *i;
-        mSprites.push_back(AnimatedSprite::load(file));
+        mSprites.push_back(AnimatedSprite::loadAsync(file));
     }
 
     // Ensure that something is shown
@@ -138,6 +138,7 @@ void Monster::setAction(Action action, int attackType)
             if (*it)
                 (*it)->play(currentAction);
         mAction = action;
+        requestMapRedraw(this);
     }
 }
 
@@ -23,6 +23,7 @@
 
 #include "log.h"
 #include "main.h"
+#include "tracer.h"
 
 #include <SDL.h>
 #include <SDL_thread.h>
@@ -167,6 +168,8 @@ int Download::downloadThread(void *ptr)
     CURLcode res;
     std::string outFilename;
 
+    Tracer::setThreadName("download");
+
     if (!d->mOptions.memoryWrite)
     {
         outFilename = d->mFileName + ".part";
@@ -211,7 +214,12 @@ int Download::downloadThread(void *ptr)
             curl_easy_setopt(d->mCurl, CURLOPT_NOSIGNAL, 1);
             curl_easy_setopt(d->mCurl, CURLOPT_CONNECTTIMEOUT, 15);
 
-            if ((res = curl_easy_perform(d->mCurl)) != 0)
+            {
+                TraceScope trace("Download", d->mUrl);
+                res = curl_easy_perform(d->mCurl);
+            }
+
+            if (res != 0)
             {
                 switch (res)
                 {
@@ -29,6 +29,7 @@
 #include "utils/stringutils.h"
 
 #include "log.h"
+#include "tracer.h"
 
 #include <assert.h>
 #include <sstream>
@@ -87,8 +88,13 @@ int networkThread(void *data)
 {
     Network *network = static_cast<Network*>(data);
 
-    if (!network->realConnect())
-        return -1;
+    Tracer::setThreadName("network");
+
+    {
+        TraceScope trace("Network::connect");
+        if (!network->realConnect())
+            return -1;
+    }
 
     network->receive();
 
@@ -218,6 +224,10 @@ void Network::dispatchMessages()
     {
         MessageIn msg = getNextMessage();
 
+        TraceScope trace("dispatch");
+        if (Tracer::isEnabled())
+            trace.setDetail(strprintf("0x%04x", msg.getId()));
+
         MessageHandlerIterator iter = mMessageHandlers.find(msg.getId());
 
         if (iter != mMessageHandlers.end())
@@ -389,6 +399,9 @@ void Network::receive()
                 break;
 
             case 1:
+            {
+                TraceScope trace("Network::receive");
+
                 // Receive data from the socket
                 SDL_mutexP(mMutex);
                 ret = SDLNet_TCP_Recv(mSocket, mInBuffer + mInSize, BUFFER_SIZE - mInSize);
@@ -423,6 +436,7 @@ void Network::receive()
                 }
                 SDL_mutexV(mMutex);
                 break;
+            }
 
             default:
                 // more than one socket is ready..
@@ -28,6 +28,9 @@
 #include "net/messagein.h"
 
 #include "log.h"
+#include "tracer.h"
+
+#include "utils/stringutils.h"
 
 #include <enet/enet.h>
 
@@ -116,6 +119,10 @@ namespace
     {
         MessageIn msg((const char *)packet->data, packet->dataLength);
 
+        TraceScope trace("dispatch");
+        if (Tracer::isEnabled())
+            trace.setDetail(strprintf("0x%04x", msg.getId()));
+
         MessageHandlerIterator iter = mMessageHandlers.find(msg.getId());
 
         if (iter != mMessageHandlers.end()) {
@@ -47,7 +47,7 @@ NPC::NPC(int id, int job, Map *map):
     {
         std::string file = "graphics/sprites/" + (*i)->sprite;
         int variant = (*i)->variant;
-        mSprites.push_back(AnimatedSprite::load(file, variant));
+        mSprites.push_back(AnimatedSprite::loadAsync(file, variant));
         mSpriteIDs.push_back(0);
         mSpriteColors.push_back("");
     }
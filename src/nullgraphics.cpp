@@ -0,0 +1,203 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <SDL.h>
+
+#include "log.h"
+#include "nullgraphics.h"
+
+/**
+ * Intersects the given rectangles, returning false when they don't overlap.
+ */
+static bool intersect(const SDL_Rect &a, const SDL_Rect &b, SDL_Rect &result)
+{
+    const int x1 = std::max<int>(a.x, b.x);
+    const int y1 = std::max<int>(a.y, b.y);
+    const int x2 = std::min<int>(a.x + a.w, b.x + b.w);
+    const int y2 = std::min<int>(a.y + a.h, b.y + b.h);
+
+    if (x2 <= x1 || y2 <= y1)
+        return false;
+
+    result.x = x1;
+    result.y = y1;
+    result.w = x2 - x1;
+    result.h = y2 - y1;
+    return true;
+}
+
+NullGraphics::NullGraphics(bool rasterize):
+    mRasterize(rasterize),
+    mDrawCount(0), mPixelCount(0),
+    mLastDrawCount(0), mLastPixelCount(0),
+    mChecksum(0),
+    mFrame(0)
+{
+    logger->log("Drawing without a display%s",
+                mRasterize ? ", into an offscreen buffer" : "");
+}
+
+bool NullGraphics::setVideoMode(int w, int h, int bpp, bool, bool)
+{
+    return Graphics::setVideoMode(w, h, bpp, false, false);
+}
+
+bool NullGraphics::blitSurface(SDL_Surface *surface,
+                               SDL_Rect *srcRect, SDL_Rect *dstRect,
+                               Image *image)
+{
+    SDL_Rect dst = *dstRect;
+    if (srcRect)
+    {
+        dst.w = srcRect->w;
+        dst.h = srcRect->h;
+    }
+    else
+    {
+        dst.w = surface->w;
+        dst.h = surface->h;
+    }
+
+    SDL_Rect visible;
+    if (!intersect(dst, mScreen->clip_rect, visible))
+        return true;
+
+    mDrawCount++;
+    mPixelCount += visible.w * visible.h;
+
+    if (mRasterize)
+        return Graphics::blitSurface(surface, srcRect, dstRect, image);
+
+    return true;
+}
+
+void NullGraphics::addFill(int x, int y, int w, int h)
+{
+    if (w <= 0 || h <= 0)
+        return;
+
+    SDL_Rect area;
+    area.x = x;
+    area.y = y;
+    area.w = w;
+    area.h = h;
+
+    SDL_Rect visible;
+    if (!intersect(area, mScreen->clip_rect, visible))
+        return;
+
+    mDrawCount++;
+    mPixelCount += visible.w * visible.h;
+}
+
+void NullGraphics::fillRectangle(const gcn::Rectangle &rectangle)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+
+    addFill(rectangle.x + top.xOffset, rectangle.y + top.yOffset,
+            rectangle.width, rectangle.height);
+
+    if (mRasterize)
+        Graphics::fillRectangle(rectangle);
+}
+
+void NullGraphics::drawRectangle(const gcn::Rectangle &rectangle)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+    const int x = rectangle.x + top.xOffset;
+    const int y = rectangle.y + top.yOffset;
+    const int w = rectangle.width;
+    const int h = rectangle.height;
+
+    addFill(x, y, w, 1);
+    addFill(x, y + h - 1, w, 1);
+    addFill(x, y + 1, 1, h - 2);
+    addFill(x + w - 1, y + 1, 1, h - 2);
+
+    if (mRasterize)
+        Graphics::drawRectangle(rectangle);
+}
+
+void NullGraphics::drawPoint(int x, int y)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+
+    addFill(x + top.xOffset, y + top.yOffset, 1, 1);
+
+    if (mRasterize)
+        Graphics::drawPoint(x, y);
+}
+
+void NullGraphics::drawLine(int x1, int y1, int x2, int y2)
+{
+    const gcn::ClipRectangle &top = mClipStack.top();
+
+    // Lines are counted by their bounding box
+    addFill(std::min(x1, x2) + top.xOffset, std::min(y1, y2) + top.yOffset,
+            std::abs(x2 - x1) + 1, std::abs(y2 - y1) + 1);
+
+    if (mRasterize)
+        Graphics::drawLine(x1, y1, x2, y2);
+}
+
+void NullGraphics::updateScreen()
+{
+    mLastDrawCount = mDrawCount;
+    mLastPixelCount = mPixelCount;
+    mDrawCount = 0;
+    mPixelCount = 0;
+    mFrame++;
+
+    if (!mRasterize)
+        return;
+
+    mChecksum = computeChecksum();
+    logger->log("Frame %d: %d draws, %d pixels, checksum %08x",
+                mFrame, mLastDrawCount, mLastPixelCount, mChecksum);
+}
+
+Uint32 NullGraphics::computeChecksum()
+{
+    if (SDL_MUSTLOCK(mScreen))
+        SDL_LockSurface(mScreen);
+
+    // FNV-1a over the visible bytes of each row
+    const int rowBytes = mScreen->w * mScreen->format->BytesPerPixel;
+    Uint32 hash = 2166136261u;
+
+    for (int y = 0; y < mScreen->h; y++)
+    {
+        const Uint8 *row = (const Uint8*) mScreen->pixels + y * mScreen->pitch;
+        for (int i = 0; i < rowBytes; i++)
+        {
+            hash ^= row[i];
+            hash *= 16777619u;
+        }
+    }
+
+    if (SDL_MUSTLOCK(mScreen))
+        SDL_UnlockSurface(mScreen);
+
+    return hash;
+}
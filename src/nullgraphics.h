@@ -0,0 +1,113 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NULLGRAPHICS_H
+#define NULLGRAPHICS_H
+
+#include "graphics.h"
+
+/**
+ * A graphics context for running the client without a display, for
+ * benchmarking and regression testing. Everything up to the actual drawing
+ * is done as usual, including clipping, but no pixels are written.
+ *
+ * Optionally, the frames are drawn into an offscreen buffer and a checksum
+ * of each frame is logged, so that runs can be compared.
+ *
+ * Needs SDL to use the "dummy" video driver, which is set up by main.
+ */
+class NullGraphics : public Graphics
+{
+    public:
+        /**
+         * Constructor, taking whether the frames are drawn into the
+         * offscreen buffer.
+         */
+        NullGraphics(bool rasterize);
+
+        /**
+         * Sets the size of the offscreen buffer. There is no full screen mode
+         * or hardware acceleration without a display.
+         */
+        bool setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel);
+
+        void fillRectangle(const gcn::Rectangle &rectangle);
+
+        void drawRectangle(const gcn::Rectangle &rectangle);
+
+        void drawPoint(int x, int y);
+
+        void drawLine(int x1, int y1, int x2, int y2);
+
+        /**
+         * Ends the frame, logging its checksum when drawing into the
+         * offscreen buffer.
+         */
+        void updateScreen();
+
+        /**
+         * Every frame is drawn entirely, so that the frames can be compared.
+         */
+        bool clipToDirtyArea() { return true; }
+
+        /**
+         * Returns the number of drawing operations of the last frame that
+         * were at least partly visible.
+         */
+        int getDrawCount() const { return mLastDrawCount; }
+
+        /**
+         * Returns the number of pixels covered by the drawing operations of
+         * the last frame.
+         */
+        int getPixelCount() const { return mLastPixelCount; }
+
+        /**
+         * Returns the checksum of the last frame, or 0 when not drawing into
+         * the offscreen buffer.
+         */
+        Uint32 getChecksum() const { return mChecksum; }
+
+    protected:
+        bool blitSurface(SDL_Surface *surface,
+                         SDL_Rect *srcRect, SDL_Rect *dstRect,
+                         Image *image = NULL);
+
+    private:
+        /**
+         * Counts filling the given area, in screen coordinates, as far as it
+         * is within the clip area.
+         */
+        void addFill(int x, int y, int w, int h);
+
+        /**
+         * Computes the checksum of the offscreen buffer.
+         */
+        Uint32 computeChecksum();
+
+        bool mRasterize;
+        int mDrawCount, mPixelCount;
+        int mLastDrawCount, mLastPixelCount;
+        Uint32 mChecksum;
+        int mFrame;
+};
+
+#endif
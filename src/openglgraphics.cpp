@@ -37,14 +37,29 @@
 #define GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB 0x84F8
 #endif
 
+/**
+ * The number of quads that can be collected before they are drawn.
+ */
+static const int MAX_QUADS = 1024;
+
 OpenGLGraphics::OpenGLGraphics():
     mAlpha(false), mTexture(false), mColorAlpha(false),
-    mSync(false)
+    mSync(false),
+    mQuadCount(0), mBatchTexture(0),
+    mBatchCount(0), mLastBatchCount(0),
+    mDrawCallCount(0), mLastDrawCallCount(0)
 {
+    mVertArray = new GLint[MAX_QUADS * 8];
+    mTexArray = new GLfloat[MAX_QUADS * 8];
+    mColorArray = new GLubyte[MAX_QUADS * 16];
+    setQuadColor(255, 255, 255, 255);
 }
 
 OpenGLGraphics::~OpenGLGraphics()
 {
+    delete[] mVertArray;
+    delete[] mTexArray;
+    delete[] mColorArray;
 }
 
 void OpenGLGraphics::setSync(bool sync)
@@ -66,6 +81,9 @@ bool OpenGLGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
         displayFlags |= SDL_FULLSCREEN;
 
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+#if SDL_VERSION_ATLEAST(1, 2, 10)
+    SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, mSync ? 1 : 0);
+#endif
 
     if (!(mScreen = SDL_SetVideoMode(w, h, bpp, displayFlags)))
         return false;
@@ -106,79 +124,101 @@ bool OpenGLGraphics::setVideoMode(int w, int h, int bpp, bool fs, bool hwaccel)
     return true;
 }
 
-static inline void drawQuad(Image *image,
-                            int srcX, int srcY, int dstX, int dstY,
-                            int width, int height)
+void OpenGLGraphics::bindTexture(GLuint texture)
 {
-    if (image->getTextureType() == GL_TEXTURE_2D)
+    if (mBatchTexture != texture)
     {
-        // Find OpenGL normalized texture coordinates.
-        float texX1 = srcX / (float) image->getTextureWidth();
-        float texY1 = srcY / (float) image->getTextureHeight();
-        float texX2 = (srcX + width) / (float) image->getTextureWidth();
-        float texY2 = (srcY + height) / (float) image->getTextureHeight();
-
-        glTexCoord2f(texX1, texY1);
-        glVertex2i(dstX, dstY);
-        glTexCoord2f(texX2, texY1);
-        glVertex2i(dstX + width, dstY);
-        glTexCoord2f(texX2, texY2);
-        glVertex2i(dstX + width, dstY + height);
-        glTexCoord2f(texX1, texY2);
-        glVertex2i(dstX, dstY + height);
-    }
-    else
-    {
-        glTexCoord2i(srcX, srcY);
-        glVertex2i(dstX, dstY);
-        glTexCoord2i(srcX + width, srcY);
-        glVertex2i(dstX + width, dstY);
-        glTexCoord2i(srcX + width, srcY + height);
-        glVertex2i(dstX + width, dstY + height);
-        glTexCoord2i(srcX, srcY + height);
-        glVertex2i(dstX, dstY + height);
+        flushQuads();
+        mBatchTexture = texture;
     }
 }
 
-static inline void drawRescaledQuad(Image *image,
-                            int srcX, int srcY, int dstX, int dstY,
-                            int width, int height,
-                            int desiredWidth, int desiredHeight)
+void OpenGLGraphics::setQuadColor(GLubyte r, GLubyte g, GLubyte b, GLubyte a)
 {
+    mQuadColor[0] = r;
+    mQuadColor[1] = g;
+    mQuadColor[2] = b;
+    mQuadColor[3] = a;
+}
+
+void OpenGLGraphics::addImageQuad(Image *image,
+                                  int srcX, int srcY, int dstX, int dstY,
+                                  int width, int height,
+                                  int desiredWidth, int desiredHeight)
+{
+    GLfloat texX1 = srcX;
+    GLfloat texY1 = srcY;
+    GLfloat texX2 = srcX + width;
+    GLfloat texY2 = srcY + height;
+
     if (image->getTextureType() == GL_TEXTURE_2D)
     {
         // Find OpenGL normalized texture coordinates.
-        float texX1 = srcX / (float) image->getTextureWidth();
-        float texY1 = srcY / (float) image->getTextureHeight();
-        float texX2 = (srcX + width) / (float) image->getTextureWidth();
-        float texY2 = (srcY + height) / (float) image->getTextureHeight();
-
-        glTexCoord2f(texX1, texY1);
-        glVertex2i(dstX, dstY);
-        glTexCoord2f(texX2, texY1);
-        glVertex2i(dstX + desiredWidth, dstY);
-        glTexCoord2f(texX2, texY2);
-        glVertex2i(dstX + desiredWidth, dstY + desiredHeight);
-        glTexCoord2f(texX1, texY2);
-        glVertex2i(dstX, dstY + desiredHeight);
-    }
-    else
-    {
-        glTexCoord2i(srcX, srcY);
-        glVertex2i(dstX, dstY);
-        glTexCoord2i(srcX + width, srcY);
-        glVertex2i(dstX + desiredWidth, dstY);
-        glTexCoord2i(srcX + width, srcY + height);
-        glVertex2i(dstX + desiredWidth, dstY + desiredHeight);
-        glTexCoord2i(srcX, srcY + height);
-        glVertex2i(dstX, dstY + desiredHeight);
+        const GLfloat texWidth = image->getTextureWidth();
+        const GLfloat texHeight = image->getTextureHeight();
+        texX1 /= texWidth;
+        texY1 /= texHeight;
+        texX2 /= texWidth;
+        texY2 /= texHeight;
     }
+
+    addQuad(texX1, texY1, texX2, texY2,
+            dstX, dstY, desiredWidth, desiredHeight);
 }
 
+void OpenGLGraphics::addQuad(GLfloat texX1, GLfloat texY1,
+                             GLfloat texX2, GLfloat texY2,
+                             int dstX, int dstY, int width, int height)
+{
+    if (mQuadCount == MAX_QUADS)
+        flushQuads();
+
+    GLint *vert = mVertArray + mQuadCount * 8;
+    GLfloat *tex = mTexArray + mQuadCount * 8;
+    GLubyte *color = mColorArray + mQuadCount * 16;
+
+    vert[0] = dstX;          vert[1] = dstY;
+    vert[2] = dstX + width;  vert[3] = dstY;
+    vert[4] = dstX + width;  vert[5] = dstY + height;
+    vert[6] = dstX;          vert[7] = dstY + height;
+
+    tex[0] = texX1;  tex[1] = texY1;
+    tex[2] = texX2;  tex[3] = texY1;
+    tex[4] = texX2;  tex[5] = texY2;
+    tex[6] = texX1;  tex[7] = texY2;
+
+    for (int i = 0; i < 16; i += 4)
+        memcpy(color + i, mQuadColor, 4);
+
+    mQuadCount++;
+}
+
+void OpenGLGraphics::flushQuads()
+{
+    if (mQuadCount == 0)
+        return;
+
+    // Loading an image may have bound another texture in the meantime
+    if (mTexture)
+        glBindTexture(Image::mTextureType, mBatchTexture);
+
+    glVertexPointer(2, GL_INT, 0, mVertArray);
+    glTexCoordPointer(2, GL_FLOAT, 0, mTexArray);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, mColorArray);
+
+    glDrawArrays(GL_QUADS, 0, mQuadCount * 4);
+
+    mQuadCount = 0;
+    mBatchCount++;
+
+    // The current color is undefined after using a color array
+    glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+}
 
 bool OpenGLGraphics::drawImage(Image *image, int srcX, int srcY,
                                int dstX, int dstY,
-                               int width, int height, bool useColor)
+                               int width, int height, bool useColor,
+                               float opacity)
 {
     if (!image)
         return false;
@@ -186,20 +226,20 @@ bool OpenGLGraphics::drawImage(Image *image, int srcX, int srcY,
     srcX += image->mBounds.x;
     srcY += image->mBounds.y;
 
-    if (!useColor)
-        glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
+    // The opacity is applied by modulating with the quad color
+    if (useColor)
+        setQuadColor(mColor.r, mColor.g, mColor.b, mColor.a);
+    else
+        setQuadColor(255, 255, 255,
+                     (GLubyte) (255 * image->mAlpha * opacity));
 
     setTexturingAndBlending(true);
+    bindTexture(image->mGLImage);
 
-    // Draw a textured quad.
-    glBegin(GL_QUADS);
-    drawQuad(image, srcX, srcY, dstX, dstY, width, height);
-    glEnd();
+    addImageQuad(image, srcX, srcY, dstX, dstY,
+                 width, height, width, height);
 
-    if (!useColor)
-        glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+    mDrawCallCount++;
 
     return true;
 }
@@ -238,42 +278,39 @@ bool OpenGLGraphics::drawRescaledImage(Image *image, int srcX, int srcY,
     srcX += image->mBounds.x;
     srcY += image->mBounds.y;
 
-    if (!useColor)
-        glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
+    if (useColor)
+        setQuadColor(mColor.r, mColor.g, mColor.b, mColor.a);
+    else
+        setQuadColor(255, 255, 255, (GLubyte) (255 * image->mAlpha));
 
     setTexturingAndBlending(true);
+    bindTexture(image->mGLImage);
 
     // Draw a textured quad.
-    glBegin(GL_QUADS);
-    drawRescaledQuad(image, srcX, srcY, dstX, dstY, width, height,
-                     desiredWidth, desiredHeight);
+    addImageQuad(image, srcX, srcY, dstX, dstY, width, height,
+                 desiredWidth, desiredHeight);
 
     if (smooth) // A basic smooth effect...
     {
-        glColor4f(1.0f, 1.0f, 1.0f, 0.2f);
-        drawRescaledQuad(image, srcX, srcY, dstX - 1, dstY - 1, width, height,
-                        desiredWidth + 1, desiredHeight + 1);
-        drawRescaledQuad(image, srcX, srcY, dstX + 1, dstY + 1, width, height,
-                        desiredWidth - 1, desiredHeight - 1);
-
-        drawRescaledQuad(image, srcX, srcY, dstX + 1, dstY, width, height,
-                        desiredWidth - 1, desiredHeight);
-        drawRescaledQuad(image, srcX, srcY, dstX, dstY + 1, width, height,
-                        desiredWidth, desiredHeight - 1);
+        setQuadColor(255, 255, 255, 51);
+        addImageQuad(image, srcX, srcY, dstX - 1, dstY - 1, width, height,
+                     desiredWidth + 1, desiredHeight + 1);
+        addImageQuad(image, srcX, srcY, dstX + 1, dstY + 1, width, height,
+                     desiredWidth - 1, desiredHeight - 1);
+
+        addImageQuad(image, srcX, srcY, dstX + 1, dstY, width, height,
+                     desiredWidth - 1, desiredHeight);
+        addImageQuad(image, srcX, srcY, dstX, dstY + 1, width, height,
+                     desiredWidth, desiredHeight - 1);
     }
 
-    glEnd();
-
-    if (!useColor)
-        glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+    mDrawCallCount++;
 
     return true;
 }
 
 /* Optimising the functions that Graphics::drawImagePattern would call,
- * so that glBegin...glEnd are outside the main loop. */
+ * so that all tiles of the pattern end up in the same batch. */
 void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
 {
     if (!image)
@@ -287,15 +324,12 @@ void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
     if (iw == 0 || ih == 0)
         return;
 
-    glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
+    setQuadColor(255, 255, 255, (GLubyte) (255 * image->mAlpha));
 
     setTexturingAndBlending(true);
+    bindTexture(image->mGLImage);
 
     // Draw a set of textured rectangles
-    glBegin(GL_QUADS);
-
     for (int py = 0; py < h; py += ih)
     {
         const int height = (py + ih >= h) ? h - py : ih;
@@ -305,13 +339,12 @@ void OpenGLGraphics::drawImagePattern(Image *image, int x, int y, int w, int h)
             int width = (px + iw >= w) ? w - px : iw;
             int dstX = x + px;
 
-            drawQuad(image, srcX, srcY, dstX, dstY, width, height);
+            addImageQuad(image, srcX, srcY, dstX, dstY,
+                         width, height, width, height);
         }
     }
 
-    glEnd();
-
-    glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+    mDrawCallCount++;
 }
 
 void OpenGLGraphics::drawRescaledImagePattern(Image *image, int x, int y,
@@ -329,15 +362,12 @@ void OpenGLGraphics::drawRescaledImagePattern(Image *image, int x, int y,
     if (iw == 0 || ih == 0)
         return;
 
-    glColor4f(1.0f, 1.0f, 1.0f, image->mAlpha);
-
-    glBindTexture(Image::mTextureType, image->mGLImage);
+    setQuadColor(255, 255, 255, (GLubyte) (255 * image->mAlpha));
 
     setTexturingAndBlending(true);
+    bindTexture(image->mGLImage);
 
     // Draw a set of textured rectangles
-    glBegin(GL_QUADS);
-
     for (int py = 0; py < h; py += ih)
     {
         const int height = (py + ih >= h) ? h - py : ih;
@@ -347,20 +377,25 @@ void OpenGLGraphics::drawRescaledImagePattern(Image *image, int x, int y,
             int width = (px + iw >= w) ? w - px : iw;
             int dstX = x + px;
 
-            drawRescaledQuad(image, srcX, srcY, dstX, dstY,
-                             width, height, scaledWidth, scaledHeight);
+            addImageQuad(image, srcX, srcY, dstX, dstY,
+                         width, height, scaledWidth, scaledHeight);
         }
     }
 
-    glEnd();
-
-    glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+    mDrawCallCount++;
 }
 
 void OpenGLGraphics::updateScreen()
 {
-    glFlush();
-    glFinish();
+    flushQuads();
+
+    mLastBatchCount = mBatchCount;
+    mLastDrawCallCount = mDrawCallCount;
+    mBatchCount = 0;
+    mDrawCallCount = 0;
+
+    // Swapping flushes the commands by itself. Waiting for them to finish
+    // here would only stall until the frame is drawn.
     SDL_GL_SwapBuffers();
 }
 
@@ -381,15 +416,23 @@ void OpenGLGraphics::_beginDraw()
 
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // Quads are collected in client side arrays, see flushQuads()
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
     pushClipArea(gcn::Rectangle(0, 0, mScreen->w, mScreen->h));
 }
 
 void OpenGLGraphics::_endDraw()
 {
+    flushQuads();
 }
 
 SDL_Surface* OpenGLGraphics::getScreenshot()
 {
+    flushQuads();
+
     int h = mScreen->h;
     int w = mScreen->w;
 
@@ -429,6 +472,8 @@ SDL_Surface* OpenGLGraphics::getScreenshot()
 
 bool OpenGLGraphics::pushClipArea(gcn::Rectangle area)
 {
+    flushQuads();
+
     int transX = 0;
     int transY = 0;
 
@@ -455,6 +500,8 @@ bool OpenGLGraphics::pushClipArea(gcn::Rectangle area)
 
 void OpenGLGraphics::popClipArea()
 {
+    flushQuads();
+
     gcn::Graphics::popClipArea();
 
     if (mClipStack.empty())
@@ -478,6 +525,7 @@ void OpenGLGraphics::setColor(const gcn::Color& color)
 void OpenGLGraphics::drawPoint(int x, int y)
 {
     setTexturingAndBlending(false);
+    flushQuads();
 
     glBegin(GL_POINTS);
     glVertex2i(x, y);
@@ -487,6 +535,7 @@ void OpenGLGraphics::drawPoint(int x, int y)
 void OpenGLGraphics::drawLine(int x1, int y1, int x2, int y2)
 {
     setTexturingAndBlending(false);
+    flushQuads();
 
     glBegin(GL_LINES);
     glVertex2f(x1 + 0.5f, y1 + 0.5f);
@@ -514,6 +563,11 @@ void OpenGLGraphics::setTargetPlane(int width, int height)
 
 void OpenGLGraphics::setTexturingAndBlending(bool enable)
 {
+    // The waiting quads need to be drawn with the current state
+    const bool blend = enable || mColorAlpha;
+    if (mTexture != enable || mAlpha != blend)
+        flushQuads();
+
     if (enable)
     {
         if (!mTexture)
@@ -551,11 +605,23 @@ void OpenGLGraphics::setTexturingAndBlending(bool enable)
 
 void OpenGLGraphics::drawRectangle(const gcn::Rectangle& rect, bool filled)
 {
-    const float offset = filled ? 0 : 0.5f;
-
     setTexturingAndBlending(false);
 
-    glBegin(filled ? GL_QUADS : GL_LINE_LOOP);
+    mDrawCallCount++;
+
+    if (filled)
+    {
+        setQuadColor(mColor.r, mColor.g, mColor.b, mColor.a);
+        addQuad(0.0f, 0.0f, 0.0f, 0.0f,
+                rect.x, rect.y, rect.width, rect.height);
+        return;
+    }
+
+    const float offset = 0.5f;
+
+    flushQuads();
+
+    glBegin(GL_LINE_LOOP);
     glVertex2f(rect.x + offset, rect.y + offset);
     glVertex2f(rect.x + rect.width - offset, rect.y + offset);
     glVertex2f(rect.x + rect.width - offset, rect.y + rect.height - offset);
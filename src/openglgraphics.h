@@ -24,6 +24,8 @@
 
 #include "graphics.h"
 
+#include "resources/image.h"
+
 class OpenGLGraphics : public Graphics
 {
     public:
@@ -33,7 +35,7 @@ class OpenGLGraphics : public Graphics
 
         /**
          * Sets whether vertical refresh syncing is enabled. Takes effect after
-         * the next call to setVideoMode(). Only implemented on MacOS for now.
+         * the next call to setVideoMode().
          */
         void setSync(bool sync);
         bool getSync() const { return mSync; }
@@ -44,7 +46,8 @@ class OpenGLGraphics : public Graphics
                        int srcX, int srcY,
                        int dstX, int dstY,
                        int width, int height,
-                       bool useColor);
+                       bool useColor,
+                       float opacity = 1.0f);
 
         /**
          * Draws a resclaled version of the image
@@ -77,6 +80,11 @@ class OpenGLGraphics : public Graphics
 
         void updateScreen();
 
+        /**
+         * Every frame is drawn entirely, since pages are swapped.
+         */
+        bool clipToDirtyArea() { return true; }
+
         void _beginDraw();
         void _endDraw();
 
@@ -102,13 +110,66 @@ class OpenGLGraphics : public Graphics
          */
         SDL_Surface *getScreenshot();
 
+        /**
+         * Returns the number of quad batches sent to OpenGL during the last
+         * frame.
+         */
+        int getBatchCount() const { return mLastBatchCount; }
+
+        /**
+         * Returns the number of draw calls made during the last frame.
+         */
+        int getDrawCallCount() const { return mLastDrawCallCount; }
+
     protected:
         void setTexturingAndBlending(bool enable);
 
     private:
+        /**
+         * Makes the given texture the one used by the quads that follow,
+         * flushing the quads using another texture.
+         */
+        void bindTexture(GLuint texture);
+
+        /**
+         * Sets the color used by the quads that follow.
+         */
+        void setQuadColor(GLubyte r, GLubyte g, GLubyte b, GLubyte a);
+
+        /**
+         * Adds a quad showing a part of the given image, stretched to the
+         * desired size.
+         */
+        void addImageQuad(Image *image,
+                          int srcX, int srcY, int dstX, int dstY,
+                          int width, int height,
+                          int desiredWidth, int desiredHeight);
+
+        /**
+         * Adds a quad to the batch.
+         */
+        void addQuad(GLfloat texX1, GLfloat texY1,
+                     GLfloat texX2, GLfloat texY2,
+                     int dstX, int dstY, int width, int height);
+
+        /**
+         * Draws the quads collected so far.
+         */
+        void flushQuads();
+
         bool mAlpha, mTexture;
         bool mColorAlpha;
         bool mSync;
+
+        GLint *mVertArray;
+        GLfloat *mTexArray;
+        GLubyte *mColorArray;
+        GLubyte mQuadColor[4];
+        int mQuadCount;                /**< Quads waiting to be drawn. */
+        GLuint mBatchTexture;          /**< Texture of the waiting quads. */
+
+        int mBatchCount, mLastBatchCount;
+        int mDrawCallCount, mLastDrawCallCount;
 };
 
 #endif
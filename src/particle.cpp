@@ -23,9 +23,11 @@
 #include <cmath>
 
 #include <guichan/color.hpp>
+#include <guichan/rectangle.hpp>
 
 #include "animationparticle.h"
 #include "configuration.h"
+#include "game.h"
 #include "imageparticle.h"
 #include "log.h"
 #include "map.h"
@@ -33,6 +35,7 @@
 #include "particleemitter.h"
 #include "rotationalparticle.h"
 #include "textparticle.h"
+#include "tracer.h"
 
 #include "resources/resourcemanager.h"
 
@@ -97,11 +100,21 @@ void Particle::draw(Graphics *, int, int) const
 {
 }
 
+bool Particle::getBounds(gcn::Rectangle &bounds) const
+{
+    bounds = gcn::Rectangle((int) mPos.x, (int) mPos.y, 0, 0);
+    return true;
+}
+
 bool Particle::update()
 {
     if (!mMap)
         return false;
 
+    const bool wasAlive = mAlive;
+    gcn::Rectangle oldBounds;
+    getBounds(oldBounds);
+
     if (mLifetimeLeft == 0)
         mAlive = false;
 
@@ -202,6 +215,17 @@ bool Particle::update()
 
     Vector change = mPos - oldPos;
 
+    // Particles that appear, fade in, move, disappear or run out of time
+    // (which may be fading out) change what is visible
+    if (wasAlive && (!mAlive || mLifetimePast == 1 ||
+                     mLifetimePast <= mFadeIn || mLifetimeLeft > 0 ||
+                     change.x != 0.0f || change.y != 0.0f || change.z != 0.0f))
+    {
+        requestMapRedraw(oldBounds);
+        if (mAlive)
+            requestMapRedraw(this);
+    }
+
     // Update child particles
 
     for (ParticleIterator p = mChildParticles.begin();
@@ -219,6 +243,7 @@ bool Particle::update()
         }
         else
         {
+            requestMapRedraw(*p);
             delete (*p);
             p = mChildParticles.erase(p);
         }
@@ -233,7 +258,19 @@ bool Particle::update()
 
 void Particle::moveBy(const Vector &change)
 {
+    if (change.x == 0.0f && change.y == 0.0f && change.z == 0.0f)
+        return;
+
+    // Particles that were not updated yet are not shown yet either
+    const bool shown = mAlive && mLifetimePast > 0;
+    if (shown)
+        requestMapRedraw(this);
+
     mPos += change;
+
+    if (shown)
+        requestMapRedraw(this);
+
     for (ParticleIterator p = mChildParticles.begin();
          p != mChildParticles.end(); p++)
     {
@@ -244,6 +281,15 @@ void Particle::moveBy(const Vector &change)
     }
 }
 
+void Particle::kill()
+{
+    if (mAlive)
+        requestMapRedraw(this);
+
+    mAlive = false;
+    mAutoDelete = true;
+}
+
 void Particle::moveTo(float x, float y)
 {
     moveTo(Vector(x, y, mPos.z));
@@ -252,6 +298,8 @@ void Particle::moveTo(float x, float y)
 Particle *Particle::addEffect(const std::string &particleEffectFile,
                               int pixelX, int pixelY, int rotation)
 {
+    TraceScope trace("Particle::addEffect", particleEffectFile);
+
     Particle *newParticle = NULL;
 
     XML::Document doc(particleEffectFile);
@@ -90,6 +90,13 @@ class Particle : public Sprite
         virtual int getPixelY() const
         { return (int) (mPos.y + mPos.z) - 64; }
 
+        /**
+         * A plain particle draws nothing, so it covers no area.
+         *
+         * @see Sprite::getBounds()
+         */
+        virtual bool getBounds(gcn::Rectangle &bounds) const;
+
         /**
          * Sets the map the particle is on.
          */
@@ -254,8 +261,7 @@ class Particle : public Sprite
         /**
          * Manually marks the particle for deletion.
          */
-        void kill()
-        { mAlive = false; mAutoDelete = true; }
+        void kill();
 
         /**
          * After calling this function the particle will only request
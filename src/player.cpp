@@ -156,6 +156,9 @@ void Player::setSprite(unsigned int slot, int id, const std::string &color)
 {
     assert(slot >= BASE_SPRITE && slot < VECTOREND_SPRITE);
 
+    // The new sprite may cover less than the old one
+    requestMapRedraw(this);
+
     // id = 0 means unequip
     if (id == 0)
     {
@@ -177,8 +180,8 @@ void Player::setSprite(unsigned int slot, int id, const std::string &color)
             if (!color.empty())
                 filename += "|" + color;
 
-            equipmentSprite = AnimatedSprite::load("graphics/sprites/" +
-                                                   filename);
+            equipmentSprite = AnimatedSprite::loadAsync("graphics/sprites/" +
+                                                        filename);
         }
 
         if (equipmentSprite)
@@ -197,6 +200,8 @@ void Player::setSprite(unsigned int slot, int id, const std::string &color)
 
     mSpriteIDs[slot] = id;
     mSpriteColors[slot] = color;
+
+    requestMapRedraw(this);
 }
 
 void Player::setSpriteID(unsigned int slot, int id)
@@ -0,0 +1,159 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "profiler.h"
+
+#include "utils/clock.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+static const char *const SECTION_NAMES[Profiler::SECTION_COUNT] = {
+    "other",
+    "beings",
+    "particles",
+    "map",
+    "gui",
+    "screen",
+    "network",
+    "idle"
+};
+
+Profiler::Section Profiler::mCurrent = Profiler::OTHER;
+Uint64 Profiler::mLastSwitch = 0;
+Uint64 Profiler::mTimes[Profiler::SECTION_COUNT];
+Uint64 Profiler::mFrameStart = 0;
+
+Profiler::Sample Profiler::mSamples[Profiler::SAMPLE_COUNT];
+int Profiler::mSampleCount = 0;
+int Profiler::mNextSample = 0;
+
+Uint64 Profiler::account()
+{
+    const Uint64 now = getMicroseconds();
+    mTimes[mCurrent] += now - mLastSwitch;
+    mLastSwitch = now;
+    return now;
+}
+
+Profiler::Section Profiler::enter(Section section)
+{
+    account();
+
+    const Section previous = mCurrent;
+    mCurrent = section;
+    return previous;
+}
+
+void Profiler::leave(Section previous)
+{
+    account();
+    mCurrent = previous;
+}
+
+void Profiler::endFrame()
+{
+    const Uint64 now = account();
+
+    Sample &sample = mSamples[mNextSample];
+    sample.end = now;
+    sample.total = (now - mFrameStart) / 1000.0f;
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        sample.sections[i] = mTimes[i] / 1000.0f;
+        mTimes[i] = 0;
+    }
+
+    mFrameStart = now;
+    mNextSample = (mNextSample + 1) % SAMPLE_COUNT;
+    if (mSampleCount < SAMPLE_COUNT)
+        mSampleCount++;
+}
+
+void Profiler::reset()
+{
+    mSampleCount = 0;
+    mNextSample = 0;
+    std::fill(mTimes, mTimes + SECTION_COUNT, 0);
+    mFrameStart = mLastSwitch = getMicroseconds();
+}
+
+const Profiler::Sample &Profiler::getSample(int index)
+{
+    const int first = mNextSample - mSampleCount + SAMPLE_COUNT;
+    return mSamples[(first + index) % SAMPLE_COUNT];
+}
+
+float Profiler::getPercentile(float fraction)
+{
+    if (mSampleCount == 0)
+        return 0.0f;
+
+    std::vector<float> totals(mSampleCount);
+    for (int i = 0; i < mSampleCount; i++)
+        totals[i] = mSamples[i].total;
+
+    const int index = std::min(mSampleCount - 1,
+                               (int) (fraction * mSampleCount));
+    std::nth_element(totals.begin(), totals.begin() + index, totals.end());
+    return totals[index];
+}
+
+float Profiler::getAverage(Section section)
+{
+    if (mSampleCount == 0)
+        return 0.0f;
+
+    float sum = 0.0f;
+    for (int i = 0; i < mSampleCount; i++)
+        sum += mSamples[i].sections[section];
+
+    return sum / mSampleCount;
+}
+
+const char *Profiler::getSectionName(Section section)
+{
+    return SECTION_NAMES[section];
+}
+
+bool Profiler::dump(const std::string &fileName)
+{
+    std::ofstream file(fileName.c_str());
+    if (!file.is_open())
+        return false;
+
+    file << "end_us,total_ms";
+    for (int i = 0; i < SECTION_COUNT; i++)
+        file << ',' << SECTION_NAMES[i] << "_ms";
+    file << '\n';
+
+    for (int i = 0; i < mSampleCount; i++)
+    {
+        const Sample &sample = getSample(i);
+        file << sample.end << ',' << sample.total;
+        for (int j = 0; j < SECTION_COUNT; j++)
+            file << ',' << sample.sections[j];
+        file << '\n';
+    }
+
+    return file.good();
+}
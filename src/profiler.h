@@ -0,0 +1,164 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "tracer.h"
+
+#include <SDL_types.h>
+
+#include <string>
+
+/**
+ * Measures how the time of each frame is spent on the subsystems of the
+ * main loop, and keeps the measurements of the last frames.
+ *
+ * Time is attributed to the innermost section being profiled, so a section
+ * nested in another one doesn't count towards the outer one. Only meant to
+ * be used from the main thread.
+ */
+class Profiler
+{
+    public:
+        enum Section
+        {
+            OTHER,              /**< Time not spent in any other section */
+            BEINGS,
+            PARTICLES,
+            MAP,
+            GUI,
+            SCREEN,
+            NETWORK,
+            IDLE,
+            SECTION_COUNT
+        };
+
+        /**
+         * The time spent on a frame, in milliseconds.
+         */
+        struct Sample
+        {
+            Uint64 end;         /**< When the frame ended, in microseconds */
+            float total;
+            float sections[SECTION_COUNT];
+        };
+
+        /**
+         * The number of frames that are kept.
+         */
+        static const int SAMPLE_COUNT = 512;
+
+        /**
+         * Starts attributing time to the given section.
+         *
+         * @return the section that was being profiled before.
+         */
+        static Section enter(Section section);
+
+        /**
+         * Stops attributing time to the current section, and goes back to
+         * the given one.
+         */
+        static void leave(Section previous);
+
+        /**
+         * Ends the current frame, storing the time spent on it.
+         */
+        static void endFrame();
+
+        /**
+         * Forgets about all stored frames, and starts a new one.
+         */
+        static void reset();
+
+        /**
+         * Returns the number of stored frames.
+         */
+        static int getSampleCount() { return mSampleCount; }
+
+        /**
+         * Returns a stored frame, with 0 being the oldest one.
+         */
+        static const Sample &getSample(int index);
+
+        /**
+         * Returns the frame time below which the given fraction of the stored
+         * frames fall, in milliseconds.
+         */
+        static float getPercentile(float fraction);
+
+        /**
+         * Returns the average time spent on the given section per frame, in
+         * milliseconds.
+         */
+        static float getAverage(Section section);
+
+        /**
+         * Returns the name of the given section.
+         */
+        static const char *getSectionName(Section section);
+
+        /**
+         * Writes the stored frames to the given file, as comma separated
+         * values.
+         *
+         * @return <code>true</code> on success, <code>false</code> otherwise.
+         */
+        static bool dump(const std::string &fileName);
+
+    private:
+        /**
+         * Attributes the time since the last switch to the current section.
+         */
+        static Uint64 account();
+
+        static Section mCurrent;
+        static Uint64 mLastSwitch;
+        static Uint64 mTimes[SECTION_COUNT];
+        static Uint64 mFrameStart;
+
+        static Sample mSamples[SAMPLE_COUNT];
+        static int mSampleCount;
+        static int mNextSample;
+};
+
+/**
+ * Attributes the time until the end of the scope to the given section. The
+ * scope is also traced when tracing is enabled.
+ */
+class ProfileScope
+{
+    public:
+        ProfileScope(Profiler::Section section):
+            mTrace(Profiler::getSectionName(section)),
+            mPrevious(Profiler::enter(section))
+        {}
+
+        ~ProfileScope()
+        { Profiler::leave(mPrevious); }
+
+    private:
+        TraceScope mTrace;
+        Profiler::Section mPrevious;
+};
+
+#endif
@@ -32,6 +32,8 @@
 class Properties
 {
     public:
+        typedef std::map<std::string, std::string> PropertyMap;
+
         /**
          * Destructor.
          */
@@ -118,8 +120,13 @@ class Properties
             mProperties[name] = value;
         }
 
+        /**
+         * Returns all properties, by name.
+         */
+        const PropertyMap &getProperties() const
+        { return mProperties; }
+
     private:
-        typedef std::map<std::string, std::string> PropertyMap;
         PropertyMap mProperties;
 };
 
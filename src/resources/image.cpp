@@ -22,12 +22,64 @@
 #include "resources/image.h"
 
 #include "resources/dye.h"
+#include "resources/textureatlas.h"
 
+#include "graphics.h"
 #include "log.h"
 
 #include <SDL_image.h>
 #include "resources/sdlrescalefacility.h"
 
+#include <list>
+
+/**
+ * The number of alpha levels translucent SDL surfaces are created for.
+ */
+static const int ALPHA_LEVELS = 32;
+
+/**
+ * The number of bytes the cached scaled images may use together.
+ */
+static const int SCALED_CACHE_SIZE = 16 * 1024 * 1024;
+
+namespace {
+    /**
+     * A scaled image kept by SDLgetCachedScaledImage().
+     */
+    struct ScaledImage
+    {
+        Image *source;
+        int width, height;
+        Image *image;
+        int bytes;
+    };
+
+    typedef std::list<ScaledImage> ScaledImages;
+    typedef std::pair<Image*, std::pair<int, int> > ScaledImageKey;
+    typedef std::map<ScaledImageKey, ScaledImages::iterator> ScaledImageIndex;
+
+    ScaledImages scaledImages;         /**< Most recently used first */
+    ScaledImageIndex scaledImageIndex;
+    int scaledImageBytes = 0;
+
+    ScaledImageKey scaledImageKey(Image *source, int width, int height)
+    {
+        return std::make_pair(source, std::make_pair(width, height));
+    }
+
+    /**
+     * Removes a scaled image from the cache and deletes it.
+     */
+    void removeScaledImage(ScaledImages::iterator i)
+    {
+        Image *image = i->image;
+        scaledImageIndex.erase(scaledImageKey(i->source, i->width, i->height));
+        scaledImageBytes -= i->bytes;
+        scaledImages.erase(i);
+        delete image;
+    }
+}
+
 #ifdef USE_OPENGL
 bool Image::mUseOpenGL = false;
 int Image::mTextureType = 0;
@@ -42,6 +94,7 @@ Image::Image(SDL_Surface *image, bool hasAlphaChannel, Uint8 *alphaChannel):
 {
 #ifdef USE_OPENGL
     mGLImage = 0;
+    mAtlas = NULL;
 #endif
 
     mBounds.x = 0;
@@ -69,7 +122,8 @@ Image::Image(GLuint glimage, int width, int height, int texWidth, int texHeight)
     mAlphaChannel(0),
     mGLImage(glimage),
     mTexWidth(texWidth),
-    mTexHeight(texHeight)
+    mTexHeight(texHeight),
+    mAtlas(NULL)
 {
     mBounds.x = 0;
     mBounds.y = 0;
@@ -94,17 +148,11 @@ Image::~Image()
 
 Resource *Image::load(void *buffer, unsigned bufferSize)
 {
-    // Load the raw file data from the buffer in an RWops structure
-    SDL_RWops *rw = SDL_RWFromMem(buffer, bufferSize);
-    SDL_Surface *tmpImage = IMG_Load_RW(rw, 1);
-
+    SDL_Surface *tmpImage = decode(buffer, bufferSize);
     if (!tmpImage)
-    {
-        logger->log("Error, image load failed: %s", IMG_GetError());
         return NULL;
-    }
 
-    Image *image = load(tmpImage);
+    Image *image = _loadPacked(tmpImage);
 
     SDL_FreeSurface(tmpImage);
     return image;
@@ -112,6 +160,18 @@ Resource *Image::load(void *buffer, unsigned bufferSize)
 
 Resource *Image::load(void *buffer, unsigned bufferSize, Dye const &dye)
 {
+    SDL_Surface *surf = decode(buffer, bufferSize, &dye);
+    if (!surf)
+        return NULL;
+
+    Image *image = _loadPacked(surf);
+    SDL_FreeSurface(surf);
+    return image;
+}
+
+SDL_Surface *Image::decode(void *buffer, unsigned bufferSize, const Dye *dye)
+{
+    // Load the raw file data from the buffer in an RWops structure
     SDL_RWops *rw = SDL_RWFromMem(buffer, bufferSize);
     SDL_Surface *tmpImage = IMG_Load_RW(rw, 1);
 
@@ -121,6 +181,9 @@ Resource *Image::load(void *buffer, unsigned bufferSize, Dye const &dye)
         return NULL;
     }
 
+    if (!dye)
+        return tmpImage;
+
     SDL_PixelFormat rgba;
     rgba.palette = NULL;
     rgba.BitsPerPixel = 32;
@@ -135,6 +198,9 @@ Resource *Image::load(void *buffer, unsigned bufferSize, Dye const &dye)
     SDL_Surface *surf = SDL_ConvertSurface(tmpImage, &rgba, SDL_SWSURFACE);
     SDL_FreeSurface(tmpImage);
 
+    if (!surf)
+        return NULL;
+
     Uint32 *pixels = static_cast< Uint32 * >(surf->pixels);
     for (Uint32 *p_end = pixels + surf->w * surf->h; pixels != p_end; ++pixels)
     {
@@ -144,13 +210,16 @@ Resource *Image::load(void *buffer, unsigned bufferSize, Dye const &dye)
         v[0] = (*pixels >> 24) & 255;
         v[1] = (*pixels >> 16) & 255;
         v[2] = (*pixels >> 8 ) & 255;
-        dye.update(v);
+        dye->update(v);
         *pixels = (v[0] << 24) | (v[1] << 16) | (v[2] << 8) | alpha;
     }
 
-    Image *image = load(surf);
-    SDL_FreeSurface(surf);
-    return image;
+    return surf;
+}
+
+Image *Image::loadDecoded(SDL_Surface *surface)
+{
+    return _loadPacked(surface);
 }
 
 Image *Image::load(SDL_Surface *tmpImage)
@@ -162,10 +231,39 @@ Image *Image::load(SDL_Surface *tmpImage)
     return _SDLload(tmpImage);
 }
 
+Image *Image::_loadPacked(SDL_Surface *tmpImage)
+{
+#ifdef USE_OPENGL
+    if (mUseOpenGL)
+    {
+        if (Image *image = TextureAtlas::load(tmpImage))
+            return image;
+    }
+#endif
+    return load(tmpImage);
+}
+
 void Image::unload()
 {
     mLoaded = false;
 
+    // Composed rectangles made from this image would be drawn for another
+    // image loaded at the same address
+    Graphics::imageUnloaded(this);
+
+    // Forget the scaled versions of this image
+    if (!scaledImages.empty())
+    {
+        ScaledImages::iterator i = scaledImages.begin();
+        while (i != scaledImages.end())
+        {
+            if (i->source == this)
+                removeScaledImage(i++);
+            else
+                ++i;
+        }
+    }
+
     if (mSDLSurface)
     {
         // Free the image surface.
@@ -176,8 +274,22 @@ void Image::unload()
         mAlphaChannel = NULL;
     }
 
+    for (std::map<int, SDL_Surface*>::iterator i = mAlphaSurfaces.begin();
+         i != mAlphaSurfaces.end(); ++i)
+    {
+        SDL_FreeSurface(i->second);
+    }
+    mAlphaSurfaces.clear();
+
 #ifdef USE_OPENGL
-    if (mGLImage)
+    if (mAtlas)
+    {
+        // The texture is shared with the other images in the atlas
+        TextureAtlas::release(mAtlas, mBounds.w, mBounds.h);
+        mAtlas = NULL;
+        mGLImage = 0;
+    }
+    else if (mGLImage)
     {
         glDeleteTextures(1, &mGLImage);
         mGLImage = 0;
@@ -261,6 +373,277 @@ void Image::setAlpha(float alpha)
     }
 }
 
+SDL_Surface *Image::SDLgetAlphaSurface(float alpha)
+{
+    if (!mSDLSurface)
+        return NULL;
+
+    int level = (int) (alpha * ALPHA_LEVELS + 0.5f);
+    if (level < 1)
+        level = 1;
+    else if (level > ALPHA_LEVELS)
+        level = ALPHA_LEVELS;
+
+    std::map<int, SDL_Surface*>::iterator i = mAlphaSurfaces.find(level);
+    if (i != mAlphaSurfaces.end())
+        return i->second;
+
+    SDL_Surface *surface = SDL_ConvertSurface(mSDLSurface,
+                                              mSDLSurface->format,
+                                              mSDLSurface->flags);
+    if (!surface)
+        return NULL;
+
+    if (!mHasAlphaChannel || !mAlphaChannel)
+    {
+        // Per-surface alpha is enough when there is no alpha channel
+        SDL_SetAlpha(surface, SDL_SRCALPHA, 255 * level / ALPHA_LEVELS);
+    }
+    else
+    {
+        if (SDL_MUSTLOCK(surface))
+            SDL_LockSurface(surface);
+
+        Uint32 *pixels = (Uint32*) surface->pixels;
+        const int size = surface->w * surface->h;
+
+        for (int i = 0; i < size; i++)
+        {
+            // Scale the alpha the pixel had at load time
+            const Uint8 sourceAlpha = mAlphaChannel[i];
+            if (sourceAlpha > 0)
+            {
+                Uint8 r, g, b, a;
+                SDL_GetRGBA(pixels[i], surface->format, &r, &g, &b, &a);
+                a = (Uint8) (sourceAlpha * level / ALPHA_LEVELS);
+                pixels[i] = SDL_MapRGBA(surface->format, r, g, b, a);
+            }
+        }
+
+        if (SDL_MUSTLOCK(surface))
+            SDL_UnlockSurface(surface);
+    }
+
+    mAlphaSurfaces[level] = surface;
+    return surface;
+}
+
+bool Image::update(SDL_Surface *source, int x, int y)
+{
+    if (x < 0 || y < 0 ||
+        x + source->w > mBounds.w || y + source->h > mBounds.h)
+        return false;
+
+#ifdef USE_OPENGL
+    if (mGLImage)
+    {
+        Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        rmask = 0xff000000;
+        gmask = 0x00ff0000;
+        bmask = 0x0000ff00;
+        amask = 0x000000ff;
+#else
+        rmask = 0x000000ff;
+        gmask = 0x0000ff00;
+        bmask = 0x00ff0000;
+        amask = 0xff000000;
+#endif
+
+        SDL_Surface *rgba = SDL_CreateRGBSurface(SDL_SWSURFACE,
+                                                 source->w, source->h, 32,
+                                                 rmask, gmask, bmask, amask);
+        if (!rgba)
+            return false;
+
+        // Copy the alpha channel instead of blending with it
+        const Uint32 flags = source->flags & (SDL_SRCALPHA | SDL_RLEACCELOK);
+        const Uint8 alpha = source->format->alpha;
+        SDL_SetAlpha(source, 0, SDL_ALPHA_OPAQUE);
+        SDL_BlitSurface(source, NULL, rgba, NULL);
+        SDL_SetAlpha(source, flags, alpha);
+
+        glBindTexture(mTextureType, mGLImage);
+
+        if (SDL_MUSTLOCK(rgba))
+            SDL_LockSurface(rgba);
+
+        // Images in an atlas are at their bounds on the texture
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(mTextureType, 0, mBounds.x + x, mBounds.y + y,
+                        rgba->w, rgba->h,
+                        GL_RGBA, GL_UNSIGNED_BYTE, rgba->pixels);
+
+        if (SDL_MUSTLOCK(rgba))
+            SDL_UnlockSurface(rgba);
+
+        SDL_FreeSurface(rgba);
+        return true;
+    }
+#endif
+
+    // Sub images cover only part of the surface of their parent
+    if (!mSDLSurface || !mAlphaChannel ||
+        mBounds.w != mSDLSurface->w || mBounds.h != mSDLSurface->h)
+        return false;
+
+    if (SDL_MUSTLOCK(source))
+        SDL_LockSurface(source);
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_LockSurface(mSDLSurface);
+
+    for (int sy = 0; sy < source->h; sy++)
+    {
+        const Uint32 *row = (const Uint32*) ((const Uint8*) source->pixels +
+                                             sy * source->pitch);
+
+        for (int sx = 0; sx < source->w; sx++)
+        {
+            const int i = (y + sy) * mSDLSurface->w + x + sx;
+
+            Uint8 r, g, b, a;
+            SDL_GetRGBA(row[sx], source->format, &r, &g, &b, &a);
+
+            // Drawn at the alpha of the image, like the rest of it
+            mAlphaChannel[i] = a;
+            ((Uint32*) mSDLSurface->pixels)[i] =
+                SDL_MapRGBA(mSDLSurface->format, r, g, b,
+                            (Uint8) (a * mAlpha));
+        }
+    }
+
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_UnlockSurface(mSDLSurface);
+    if (SDL_MUSTLOCK(source))
+        SDL_UnlockSurface(source);
+
+    // The translucent and scaled copies and the rectangles composed from
+    // this image no longer match it
+    for (std::map<int, SDL_Surface*>::iterator i = mAlphaSurfaces.begin();
+         i != mAlphaSurfaces.end(); ++i)
+    {
+        SDL_FreeSurface(i->second);
+    }
+    mAlphaSurfaces.clear();
+
+    ScaledImages::iterator i = scaledImages.begin();
+    while (i != scaledImages.end())
+    {
+        if (i->source == this)
+            removeScaledImage(i++);
+        else
+            ++i;
+    }
+
+    Graphics::imageUnloaded(this);
+
+    return true;
+}
+
+void Image::SDLblendOnto(SDL_Surface *target, int x, int y) const
+{
+    SDLblendOnto(target, x, y, mBounds.w, mBounds.h);
+}
+
+void Image::SDLblendOnto(SDL_Surface *target, int x, int y,
+                         int width, int height) const
+{
+    if (!mSDLSurface || !target || target->format->BytesPerPixel != 4)
+        return;
+
+    const SDL_PixelFormat *srcFormat = mSDLSurface->format;
+    SDL_PixelFormat *dstFormat = target->format;
+    const int bpp = srcFormat->BytesPerPixel;
+    const bool colorKey = mSDLSurface->flags & SDL_SRCCOLORKEY;
+    const int surfaceAlpha =
+        (!mHasAlphaChannel && (mSDLSurface->flags & SDL_SRCALPHA)) ?
+        srcFormat->alpha : 255;
+
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_LockSurface(mSDLSurface);
+    if (SDL_MUSTLOCK(target))
+        SDL_LockSurface(target);
+
+    width = std::min(width, (int) mBounds.w);
+    height = std::min(height, (int) mBounds.h);
+
+    for (int sy = 0; sy < height; sy++)
+    {
+        const int ty = y + sy;
+        if (ty < 0 || ty >= target->h)
+            continue;
+
+        const Uint8 *srcRow = (Uint8*) mSDLSurface->pixels +
+            (mBounds.y + sy) * mSDLSurface->pitch;
+        Uint32 *dstRow = (Uint32*) ((Uint8*) target->pixels +
+            ty * target->pitch);
+
+        for (int sx = 0; sx < width; sx++)
+        {
+            const int tx = x + sx;
+            if (tx < 0 || tx >= target->w)
+                continue;
+
+            const Uint8 *p = srcRow + (mBounds.x + sx) * bpp;
+            Uint32 pixel;
+
+            switch (bpp)
+            {
+                case 1:
+                    pixel = *p;
+                    break;
+                case 2:
+                    pixel = *(const Uint16*) p;
+                    break;
+                case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+                    pixel = p[0] << 16 | p[1] << 8 | p[2];
+#else
+                    pixel = p[0] | p[1] << 8 | p[2] << 16;
+#endif
+                    break;
+                default:
+                    pixel = *(const Uint32*) p;
+                    break;
+            }
+
+            if (colorKey && pixel == srcFormat->colorkey)
+                continue;
+
+            Uint8 r, g, b, a;
+            SDL_GetRGBA(pixel, mSDLSurface->format, &r, &g, &b, &a);
+            a = a * surfaceAlpha / 255;
+
+            if (a == 0)
+                continue;
+
+            if (a == 255)
+            {
+                dstRow[tx] = SDL_MapRGBA(dstFormat, r, g, b, a);
+                continue;
+            }
+
+            // Blend with what is already there
+            Uint8 dr, dg, db, da;
+            SDL_GetRGBA(dstRow[tx], dstFormat, &dr, &dg, &db, &da);
+
+            const int keep = da * (255 - a) / 255;
+            const int outA = a + keep;
+
+            dstRow[tx] = SDL_MapRGBA(dstFormat,
+                                     (r * a + dr * keep) / outA,
+                                     (g * a + dg * keep) / outA,
+                                     (b * a + db * keep) / outA,
+                                     outA);
+        }
+    }
+
+    if (SDL_MUSTLOCK(target))
+        SDL_UnlockSurface(target);
+    if (SDL_MUSTLOCK(mSDLSurface))
+        SDL_UnlockSurface(mSDLSurface);
+}
+
 Image* Image::SDLmerge(Image *image, int x, int y)
 {
     if (!mSDLSurface)
@@ -359,14 +742,65 @@ Image* Image::SDLgetScaledImage(int width, int height)
                     (double) height / getHeight(),
                     1);
 
-        // The load function takes of the SDL<->OpenGL implementation
-        // and about freeing the given SDL_surface*.
+        // The load function takes of the SDL<->OpenGL implementation,
+        // but leaves the given SDL_surface* to us.
         if (scaledSurface)
+        {
             scaledImage = load(scaledSurface);
+            SDL_FreeSurface(scaledSurface);
+        }
     }
     return scaledImage;
 }
 
+Image *Image::SDLgetCachedScaledImage(int width, int height)
+{
+    if (width == getWidth() && height == getHeight())
+        return this;
+
+    const ScaledImageKey key = scaledImageKey(this, width, height);
+    ScaledImageIndex::iterator found = scaledImageIndex.find(key);
+
+    if (found != scaledImageIndex.end())
+    {
+        // Mark it as most recently used
+        scaledImages.splice(scaledImages.begin(), scaledImages, found->second);
+        return found->second->image;
+    }
+
+    Image *image = SDLgetScaledImage(width, height);
+    if (!image || !image->mSDLSurface)
+    {
+        delete image;
+        return NULL;
+    }
+
+    ScaledImage scaled;
+    scaled.source = this;
+    scaled.width = width;
+    scaled.height = height;
+    scaled.image = image;
+    scaled.bytes = image->mSDLSurface->pitch * image->mSDLSurface->h;
+    if (image->mAlphaChannel)
+        scaled.bytes += image->mSDLSurface->w * image->mSDLSurface->h;
+
+    scaledImages.push_front(scaled);
+    scaledImageIndex[key] = scaledImages.begin();
+    scaledImageBytes += scaled.bytes;
+
+    // Evict the least recently used images, but keep the new one
+    while (scaledImageBytes > SCALED_CACHE_SIZE && scaledImages.size() > 1)
+        removeScaledImage(--scaledImages.end());
+
+    return image;
+}
+
+void Image::SDLclearScaledImageCache()
+{
+    while (!scaledImages.empty())
+        removeScaledImage(scaledImages.begin());
+}
+
 Image *Image::_SDLload(SDL_Surface *tmpImage)
 {
     if (!tmpImage)
@@ -547,7 +981,11 @@ int Image::powerOfTwo(int input)
 
 Image *Image::getSubImage(int x, int y, int width, int height)
 {
-    // Create a new clipped sub-image
+    // Create a new clipped sub-image, images packed into an atlas don't
+    // start at the origin of their texture.
+    x += mBounds.x;
+    y += mBounds.y;
+
 #ifdef USE_OPENGL
     if (mUseOpenGL)
         return new SubImage(this, mGLImage, x, y, width, height,
@@ -609,5 +1047,18 @@ SubImage::~SubImage()
 
 Image *SubImage::getSubImage(int x, int y, int w, int h)
 {
-    return mParent->getSubImage(mBounds.x + x, mBounds.y + y, w, h);
+    // The bounds already include the position of the parent
+#ifdef USE_OPENGL
+    if (mUseOpenGL)
+        return new SubImage(mParent, mGLImage, mBounds.x + x, mBounds.y + y,
+                            w, h, mTexWidth, mTexHeight);
+#endif
+
+    return new SubImage(mParent, mSDLSurface, mBounds.x + x, mBounds.y + y,
+                        w, h);
+}
+
+SDL_Surface *SubImage::SDLgetAlphaSurface(float alpha)
+{
+    return mParent->SDLgetAlphaSurface(alpha);
 }
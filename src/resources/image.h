@@ -28,6 +28,8 @@
 
 #include <SDL.h>
 
+#include <map>
+
 #ifdef USE_OPENGL
 
 /* The definition of OpenGL extensions by SDL is giving problems with recent
@@ -41,6 +43,7 @@
 
 class Dye;
 class Position;
+class TextureAtlas;
 
 /**
  * Defines a class for loading and storing images.
@@ -50,6 +53,7 @@ class Image : public Resource
     friend class Graphics;
 #ifdef USE_OPENGL
     friend class OpenGLGraphics;
+    friend class TextureAtlas;
 #endif
 
     public:
@@ -87,6 +91,24 @@ class Image : public Resource
          */
         static Image *load(SDL_Surface *);
 
+        /**
+         * Decodes an image from a buffer in memory, recoloring it when a dye
+         * is given. Doesn't touch the display, so unlike the loading
+         * functions it may be called from any thread. The returned surface
+         * is expected to be freed by the caller using SDL_FreeSurface.
+         *
+         * @return <code>NULL</code> if an error occurred, a valid pointer
+         *         otherwise.
+         */
+        static SDL_Surface *decode(void *buffer, unsigned bufferSize,
+                                   const Dye *dye = NULL);
+
+        /**
+         * Loads an image from a surface returned by decode(). The surface is
+         * not freed.
+         */
+        static Image *loadDecoded(SDL_Surface *surface);
+
         /**
          * Frees the resources created by SDL.
          */
@@ -133,6 +155,16 @@ class Image : public Resource
         float getAlpha() const
         { return mAlpha; }
 
+        /**
+         * Replaces the part of this image at the given position with the
+         * given surface, copying its alpha channel. Used to add to an image
+         * without loading it again. With SDL, this only works for whole
+         * images that were loaded with an alpha channel.
+         *
+         * @return <code>true</code> if the image was updated.
+         */
+        bool update(SDL_Surface *source, int x, int y);
+
         /**
          * Creates a new image with the desired clipping rectangle.
          *
@@ -154,6 +186,22 @@ class Image : public Resource
          */
         Image* SDLgetScaledImage(int width, int height);
 
+        /**
+         * Gets a scaled instance of an image from a cache shared by all
+         * images, scaling it only when it isn't cached yet. The returned
+         * image is owned by the cache and should only be used until the next
+         * call, since it may be evicted then.
+         *
+         * @return The image itself when no scaling is needed.
+         */
+        Image *SDLgetCachedScaledImage(int width, int height);
+
+        /**
+         * Deletes all cached scaled images. Called when the video mode
+         * changes, since they are stored in the display format.
+         */
+        static void SDLclearScaledImageCache();
+
         /**
          * Merges two image SDL_Surfaces together. This is for SDL use only, as
          * reducing the number of surfaces that SDL has to render can cut down
@@ -163,6 +211,27 @@ class Image : public Resource
          */
         Image *SDLmerge(Image *image, int x, int y);
 
+        /**
+         * Blends this image onto the given 32-bit surface at the given
+         * position. Unlike an SDL blit, this combines the alpha values, so
+         * the result can be drawn as a single image later on.
+         */
+        void SDLblendOnto(SDL_Surface *target, int x, int y) const;
+
+        /**
+         * Blends the given top left part of this image onto the given
+         * 32-bit surface at the given position.
+         */
+        void SDLblendOnto(SDL_Surface *target, int x, int y,
+                          int width, int height) const;
+
+        /**
+         * Returns a copy of the SDL surface to be drawn with the given alpha
+         * instead of the alpha of this image. Copies are created on first
+         * use and kept per quantized alpha level until the image is unloaded.
+         */
+        virtual SDL_Surface *SDLgetAlphaSurface(float alpha);
+
         /**
          * Get the alpha Channel of a SDL surface.
          */
@@ -208,11 +277,20 @@ class Image : public Resource
         /** SDL_Surface to SDL_Surface Image loader */
         static Image *_SDLload(SDL_Surface *tmpImage);
 
+        /**
+         * Loads an image from an SDL surface like load(), but packs it into
+         * a texture atlas when using OpenGL.
+         */
+        static Image *_loadPacked(SDL_Surface *tmpImage);
+
         SDL_Surface *mSDLSurface;
 
         /** Alpha Channel pointer used for 32bit based SDL surfaces */
         Uint8 *mAlphaChannel;
 
+        /** Translucent copies of the SDL surface, by alpha level */
+        std::map<int, SDL_Surface*> mAlphaSurfaces;
+
       // -----------------------
       // OpenGL protected members
       // -----------------------
@@ -233,6 +311,9 @@ class Image : public Resource
         GLuint mGLImage;
         int mTexWidth, mTexHeight;
 
+        /** The atlas the texture is part of, if any. */
+        TextureAtlas *mAtlas;
+
         static bool mUseOpenGL;
         static int mTextureType;
         static int mTextureSize;
@@ -268,6 +349,12 @@ class SubImage : public Image
          */
         Image *getSubImage(int x, int y, int width, int height);
 
+        /**
+         * Shares the translucent surfaces of the parent image, since they
+         * contain the whole surface anyway.
+         */
+        SDL_Surface *SDLgetAlphaSurface(float alpha);
+
     private:
         Image *mParent;
 };
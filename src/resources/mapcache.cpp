@@ -0,0 +1,392 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "resources/mapcache.h"
+
+#include "resources/mapreader.h"
+#include "resources/resourcemanager.h"
+
+#include "log.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <physfs.h>
+
+/**
+ * The directory in the home directory where cached maps are stored.
+ */
+static const char *const CACHE_DIR = "mapcache";
+
+/**
+ * Identifies cached map files. The version needs to be increased whenever
+ * the format changes, which invalidates all cached maps.
+ */
+static const char CACHE_MAGIC[4] = { 'T', 'M', 'W', 'M' };
+static const int CACHE_VERSION = 1;
+
+namespace {
+
+    /**
+     * Returns the path of the cache file of the given map file.
+     */
+    std::string getCachePath(const std::string &fileName)
+    {
+        std::string name = fileName;
+        for (std::string::iterator i = name.begin(); i != name.end(); ++i)
+        {
+            if (*i == '/' || *i == '\\')
+                *i = '_';
+        }
+        return std::string(CACHE_DIR) + "/" + name + ".bin";
+    }
+
+    /**
+     * Builds the contents of a cache file. Numbers are stored as 32-bit
+     * little endian values.
+     */
+    class CacheWriter
+    {
+        public:
+            void writeInt(int value)
+            {
+                const unsigned int v = value;
+                mData += (char) (v & 0xff);
+                mData += (char) ((v >> 8) & 0xff);
+                mData += (char) ((v >> 16) & 0xff);
+                mData += (char) ((v >> 24) & 0xff);
+            }
+
+            void writeString(const std::string &value)
+            {
+                writeInt(value.length());
+                mData += value;
+            }
+
+            void writeBytes(const char *data, int length)
+            { mData.append(data, length); }
+
+            const std::string &getData() const
+            { return mData; }
+
+        private:
+            std::string mData;
+    };
+
+    /**
+     * Reads back what was written by a CacheWriter. Reading beyond the end
+     * of the data sets the error flag instead.
+     */
+    class CacheReader
+    {
+        public:
+            CacheReader(const unsigned char *data, int length):
+                mPos(data),
+                mEnd(data + length),
+                mError(false)
+            {}
+
+            int readInt()
+            {
+                if (mEnd - mPos < 4)
+                {
+                    mError = true;
+                    return 0;
+                }
+
+                const unsigned int v = mPos[0] | mPos[1] << 8 |
+                                       mPos[2] << 16 | mPos[3] << 24;
+                mPos += 4;
+                return (int) v;
+            }
+
+            /**
+             * Reads a count, which shouldn't be larger than the remaining
+             * data when each element takes at least the given size.
+             */
+            int readCount(int elementSize)
+            {
+                const int count = readInt();
+                if (count < 0 || count > (mEnd - mPos) / elementSize)
+                {
+                    mError = true;
+                    return 0;
+                }
+                return count;
+            }
+
+            std::string readString()
+            {
+                const int length = readCount(1);
+                std::string value((const char*) mPos, length);
+                mPos += length;
+                return value;
+            }
+
+            bool readBytes(char *data, int length)
+            {
+                if (mEnd - mPos < length)
+                {
+                    mError = true;
+                    return false;
+                }
+
+                std::copy(mPos, mPos + length, data);
+                mPos += length;
+                return true;
+            }
+
+            bool hasError() const { return mError; }
+
+            bool atEnd() const { return mPos == mEnd; }
+
+        private:
+            const unsigned char *mPos;
+            const unsigned char *mEnd;
+            bool mError;
+    };
+
+    MapData *readMapData(CacheReader &reader)
+    {
+        MapData *data = new MapData;
+
+        data->width = reader.readInt();
+        data->height = reader.readInt();
+        data->tileWidth = reader.readInt();
+        data->tileHeight = reader.readInt();
+
+        for (int i = reader.readCount(8); i > 0; i--)
+        {
+            const std::string name = reader.readString();
+            data->setProperty(name, reader.readString());
+        }
+
+        for (int i = reader.readCount(20); i > 0; i--)
+        {
+            data->tilesets.push_back(MapData::TilesetInfo());
+            MapData::TilesetInfo &set = data->tilesets.back();
+            set.image = reader.readString();
+            set.firstGid = reader.readInt();
+            set.tileWidth = reader.readInt();
+            set.tileHeight = reader.readInt();
+
+            for (int j = reader.readCount(8); j > 0; j--)
+            {
+                set.animations.push_back(MapData::TileAnimationInfo());
+                MapData::TileAnimationInfo &ani = set.animations.back();
+                ani.gid = reader.readInt();
+
+                for (int k = reader.readCount(8); k > 0; k--)
+                {
+                    const int index = reader.readInt();
+                    const int delay = reader.readInt();
+                    ani.frames.push_back(MapData::AnimationFrame(index, delay));
+                }
+            }
+        }
+
+        for (int i = reader.readCount(24); i > 0; i--)
+        {
+            data->layers.push_back(MapData::LayerInfo());
+            MapData::LayerInfo &layer = data->layers.back();
+            layer.x = reader.readInt();
+            layer.y = reader.readInt();
+            layer.width = reader.readInt();
+            layer.height = reader.readInt();
+
+            const int flags = reader.readInt();
+            layer.fringe = flags & 1;
+            layer.collision = flags & 2;
+
+            const int count = reader.readCount(4);
+            if (count != layer.width * layer.height)
+            {
+                delete data;
+                return NULL;
+            }
+
+            layer.gids.resize(count);
+            for (int j = 0; j < count; j++)
+                layer.gids[j] = reader.readInt();
+        }
+
+        for (int i = reader.readCount(12); i > 0; i--)
+        {
+            MapData::ParticleEffectInfo effect;
+            effect.file = reader.readString();
+            effect.x = reader.readInt();
+            effect.y = reader.readInt();
+            data->particleEffects.push_back(effect);
+        }
+
+        if (reader.hasError() || !reader.atEnd())
+        {
+            delete data;
+            return NULL;
+        }
+
+        return data;
+    }
+
+    void writeMapData(CacheWriter &writer, const MapData &data)
+    {
+        writer.writeInt(data.width);
+        writer.writeInt(data.height);
+        writer.writeInt(data.tileWidth);
+        writer.writeInt(data.tileHeight);
+
+        const Properties::PropertyMap &properties = data.getProperties();
+        writer.writeInt(properties.size());
+        for (Properties::PropertyMap::const_iterator i = properties.begin();
+             i != properties.end(); ++i)
+        {
+            writer.writeString(i->first);
+            writer.writeString(i->second);
+        }
+
+        writer.writeInt(data.tilesets.size());
+        for (std::vector<MapData::TilesetInfo>::const_iterator i =
+                 data.tilesets.begin(); i != data.tilesets.end(); ++i)
+        {
+            writer.writeString(i->image);
+            writer.writeInt(i->firstGid);
+            writer.writeInt(i->tileWidth);
+            writer.writeInt(i->tileHeight);
+
+            writer.writeInt(i->animations.size());
+            for (std::vector<MapData::TileAnimationInfo>::const_iterator j =
+                     i->animations.begin(); j != i->animations.end(); ++j)
+            {
+                writer.writeInt(j->gid);
+                writer.writeInt(j->frames.size());
+                for (std::vector<MapData::AnimationFrame>::const_iterator k =
+                         j->frames.begin(); k != j->frames.end(); ++k)
+                {
+                    writer.writeInt(k->first);
+                    writer.writeInt(k->second);
+                }
+            }
+        }
+
+        writer.writeInt(data.layers.size());
+        for (std::vector<MapData::LayerInfo>::const_iterator i =
+                 data.layers.begin(); i != data.layers.end(); ++i)
+        {
+            writer.writeInt(i->x);
+            writer.writeInt(i->y);
+            writer.writeInt(i->width);
+            writer.writeInt(i->height);
+            writer.writeInt((i->fringe ? 1 : 0) | (i->collision ? 2 : 0));
+
+            writer.writeInt(i->gids.size());
+            for (std::vector<int>::const_iterator j = i->gids.begin();
+                 j != i->gids.end(); ++j)
+            {
+                writer.writeInt(*j);
+            }
+        }
+
+        writer.writeInt(data.particleEffects.size());
+        for (std::vector<MapData::ParticleEffectInfo>::const_iterator i =
+                 data.particleEffects.begin();
+             i != data.particleEffects.end(); ++i)
+        {
+            writer.writeString(i->file);
+            writer.writeInt(i->x);
+            writer.writeInt(i->y);
+        }
+    }
+
+} // namespace
+
+MapData *MapCache::load(const std::string &fileName, unsigned long checksum)
+{
+    const std::string cachePath = getCachePath(fileName);
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    if (!resman->exists(cachePath))
+        return NULL;
+
+    TraceScope trace("MapCache::load", fileName);
+
+    // The whole file is read at once and decoded from memory
+    int fileSize;
+    void *buffer = resman->loadFile(cachePath, fileSize);
+    if (!buffer)
+        return NULL;
+
+    CacheReader reader((const unsigned char*) buffer, fileSize);
+    MapData *data = NULL;
+
+    char magic[sizeof(CACHE_MAGIC)];
+    if (reader.readBytes(magic, sizeof(magic)) &&
+        std::equal(magic, magic + sizeof(magic), CACHE_MAGIC) &&
+        reader.readInt() == CACHE_VERSION &&
+        (unsigned long) (unsigned int) reader.readInt() == checksum)
+    {
+        data = readMapData(reader);
+    }
+
+    free(buffer);
+
+    if (!data)
+        logger->log("Cached map %s is outdated", fileName.c_str());
+
+    return data;
+}
+
+void MapCache::save(const std::string &fileName, unsigned long checksum,
+                    const MapData &data)
+{
+    TraceScope trace("MapCache::save", fileName);
+
+    CacheWriter writer;
+    writer.writeBytes(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    writer.writeInt(CACHE_VERSION);
+    writer.writeInt((int) checksum);
+    writeMapData(writer, data);
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    if (!resman->isDirectory(CACHE_DIR))
+        resman->mkdir(CACHE_DIR);
+
+    const std::string cachePath = getCachePath(fileName);
+    PHYSFS_file *file = PHYSFS_openWrite(cachePath.c_str());
+    if (!file)
+    {
+        logger->log("Unable to write cached map %s: %s",
+                    cachePath.c_str(), PHYSFS_getLastError());
+        return;
+    }
+
+    const std::string &contents = writer.getData();
+    const bool written =
+        PHYSFS_write(file, contents.data(), 1, contents.length()) ==
+        (PHYSFS_sint64) contents.length();
+    PHYSFS_close(file);
+
+    // Don't leave an incomplete file behind
+    if (!written)
+    {
+        logger->log("Unable to write cached map %s: %s",
+                    cachePath.c_str(), PHYSFS_getLastError());
+        PHYSFS_delete(cachePath.c_str());
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include <string>
+
+struct MapData;
+
+/**
+ * Keeps the decoded contents of map files in a compact binary form in the
+ * home directory, so that maps don't need to be parsed again when they are
+ * loaded later on. Cached maps are identified by the checksum of their map
+ * file, a cached map that doesn't match is simply read and stored again.
+ *
+ * Safe to use from any thread.
+ */
+namespace MapCache
+{
+    /**
+     * Returns the cached data of the given map file, or <code>NULL</code>
+     * when there is no valid cached data matching the given checksum. The
+     * caller is expected to delete the returned data.
+     */
+    MapData *load(const std::string &fileName, unsigned long checksum);
+
+    /**
+     * Stores the data of the given map file in the cache.
+     */
+    void save(const std::string &fileName, unsigned long checksum,
+              const MapData &data);
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "resources/maploader.h"
+
+#include "resources/mapreader.h"
+#include "resources/resourcemanager.h"
+
+#include "log.h"
+#include "map.h"
+#include "tracer.h"
+
+#include "utils/clock.h"
+
+MapLoader::MapLoader(const std::string &fileName, bool useCache):
+    mFileName(fileName),
+    mUseCache(useCache),
+    mParsed(false),
+    mData(0),
+    mParseTime(0.0f),
+    mCreateTime(0.0f),
+    mImagesRequested(false),
+    mMap(0),
+    mDone(false)
+{
+    mThread = SDL_CreateThread(loaderThread, this);
+
+    if (!mThread)
+    {
+        logger->log("Unable to create map loader thread, loading %s now",
+                    fileName.c_str());
+        const Uint64 start = getMicroseconds();
+        mData = MapReader::parseMap(mFileName, mUseCache);
+        mParseTime = (getMicroseconds() - start) / 1000.0f;
+        mParsed = true;
+    }
+}
+
+MapLoader::~MapLoader()
+{
+    if (mThread)
+        SDL_WaitThread(mThread, NULL);
+
+    for (std::vector<ResourceHandle*>::iterator i = mImages.begin();
+         i != mImages.end(); ++i)
+    {
+        (*i)->release();
+    }
+
+    delete mData;
+    delete mMap;
+}
+
+int MapLoader::loaderThread(void *data)
+{
+    MapLoader *loader = static_cast<MapLoader*>(data);
+
+    Tracer::setThreadName("map loader");
+
+    const Uint64 start = getMicroseconds();
+    MapData *mapData = MapReader::parseMap(loader->mFileName,
+                                           loader->mUseCache);
+    const float parseTime = (getMicroseconds() - start) / 1000.0f;
+
+    MutexLocker lock(&loader->mMutex);
+    loader->mData = mapData;
+    loader->mParseTime = parseTime;
+    loader->mParsed = true;
+
+    return 0;
+}
+
+bool MapLoader::update()
+{
+    if (mDone)
+        return true;
+
+    if (!mImagesRequested)
+    {
+        {
+            MutexLocker lock(&mMutex);
+            if (!mParsed)
+                return false;
+        }
+
+        if (mThread)
+        {
+            SDL_WaitThread(mThread, NULL);
+            mThread = 0;
+        }
+
+        if (!mData)
+        {
+            mDone = true;
+            return true;
+        }
+
+        // Have the images decoded in the background as well, so that
+        // creating the map only needs to pick them up
+        ResourceManager *resman = ResourceManager::getInstance();
+        const std::vector<std::string> paths = mData->getImagePaths();
+        for (std::vector<std::string>::const_iterator i = paths.begin();
+             i != paths.end(); ++i)
+        {
+            mImages.push_back(resman->getImageAsync(*i));
+        }
+
+        mImagesRequested = true;
+    }
+
+    for (std::vector<ResourceHandle*>::const_iterator i = mImages.begin();
+         i != mImages.end(); ++i)
+    {
+        if (!(*i)->isReady())
+            return false;
+    }
+
+    const Uint64 start = getMicroseconds();
+    mMap = MapReader::createMap(*mData);
+    mCreateTime = (getMicroseconds() - start) / 1000.0f;
+
+    // The map holds its own references to the images now
+    for (std::vector<ResourceHandle*>::iterator i = mImages.begin();
+         i != mImages.end(); ++i)
+    {
+        (*i)->release();
+    }
+    mImages.clear();
+
+    delete mData;
+    mData = 0;
+
+    mDone = true;
+    return true;
+}
+
+float MapLoader::getProgress() const
+{
+    if (mDone)
+        return 1.0f;
+    if (!mImagesRequested)
+        return 0.0f;
+
+    // Reading the map counts as one step, as does each image
+    int ready = 1;
+    for (std::vector<ResourceHandle*>::const_iterator i = mImages.begin();
+         i != mImages.end(); ++i)
+    {
+        if ((*i)->isReady())
+            ready++;
+    }
+
+    return (float) ready / (mImages.size() + 2);
+}
+
+Map *MapLoader::takeMap()
+{
+    Map *map = mMap;
+    mMap = 0;
+    return map;
+}
@@ -0,0 +1,107 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MAPLOADER_H
+#define MAPLOADER_H
+
+#include "utils/mutex.h"
+
+#include <string>
+#include <vector>
+
+class Map;
+class ResourceHandle;
+struct MapData;
+
+/**
+ * Loads a map in the background. The map file is read and decoded by a
+ * thread, after which the images it uses are loaded through the resource
+ * manager. Only creating the map itself is left to the main thread.
+ */
+class MapLoader
+{
+    public:
+        /**
+         * Constructor. Starts loading the given map file.
+         *
+         * @param useCache whether to use and update the map cache
+         */
+        MapLoader(const std::string &fileName, bool useCache = true);
+
+        /**
+         * Destructor. Waits for the loader thread to finish and deletes the
+         * map if it wasn't taken.
+         */
+        ~MapLoader();
+
+        /**
+         * Continues loading the map. To be called regularly from the main
+         * thread.
+         *
+         * @return <code>true</code> when loading has finished, either
+         *         successfully or not.
+         */
+        bool update();
+
+        /**
+         * Returns how far loading has progressed, between 0 and 1.
+         */
+        float getProgress() const;
+
+        /**
+         * Returns how long reading and decoding the map file took in the
+         * background, in milliseconds.
+         */
+        float getParseTime() const { return mParseTime; }
+
+        /**
+         * Returns how long creating the map took on the main thread, in
+         * milliseconds.
+         */
+        float getCreateTime() const { return mCreateTime; }
+
+        /**
+         * Returns the loaded map, giving up ownership of it. Returns
+         * <code>NULL</code> when the map couldn't be loaded.
+         */
+        Map *takeMap();
+
+    private:
+        /**
+         * The function run by the loader thread.
+         */
+        static int loaderThread(void *data);
+
+        std::string mFileName;
+        bool mUseCache;
+        SDL_Thread *mThread;
+        Mutex mMutex;                   /**< Guards mParsed. */
+        bool mParsed;                   /**< Set by the loader thread. */
+        MapData *mData;                 /**< Valid once parsed. */
+        float mParseTime;               /**< Valid once parsed. */
+        float mCreateTime;
+        std::vector<ResourceHandle*> mImages;
+        bool mImagesRequested;
+        Map *mMap;
+        bool mDone;
+};
+
+#endif
@@ -21,17 +21,19 @@
 
 #include "resources/animation.h"
 #include "resources/image.h"
+#include "resources/mapcache.h"
 #include "resources/mapreader.h"
 #include "resources/resourcemanager.h"
 
 #include "log.h"
 #include "map.h"
 #include "tileset.h"
+#include "tracer.h"
 
-#include "utils/base64.h"
 #include "utils/stringutils.h"
 #include "utils/xml.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <zlib.h>
@@ -39,6 +41,12 @@
 const unsigned int DEFAULT_TILE_WIDTH = 32;
 const unsigned int DEFAULT_TILE_HEIGHT = 32;
 
+/**
+ * The highest gid that can be used on a map layer, since the layers store
+ * their tiles as 16-bit indexes in the tile table of the map.
+ */
+static const int MAX_TILE_GID = 0xFFFF;
+
 /**
  * Inflates either zlib or gzip deflated memory. The inflated memory is
  * expected to be freed by the caller.
@@ -141,14 +149,171 @@ int inflateMemory(unsigned char *in, unsigned int inLength,
     return outLength;
 }
 
+/**
+ * Maps characters to their value in base64 encoded data. Characters that
+ * aren't part of the encoding, like whitespace, are -1 and get skipped. The
+ * padding character and the terminating null character are -2.
+ */
+static const signed char BASE64_VALUES[256] = {
+    -2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -2, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+/**
+ * Decodes base64 encoded data, skipping whitespace on the way. The output
+ * buffer needs room for at least three quarters of the input length.
+ *
+ * @return the number of decoded bytes.
+ */
+static int decodeBase64(const unsigned char *in, int length,
+                        unsigned char *out)
+{
+    const unsigned char *end = in + length;
+    unsigned char *start = out;
+    unsigned int bits = 0;
+    int count = 0;
+
+    while (in < end)
+    {
+        // Decode whole groups at once as long as there is no whitespace in
+        // between, which is the common case
+        if (count == 0 && end - in >= 4)
+        {
+            const int a = BASE64_VALUES[in[0]];
+            const int b = BASE64_VALUES[in[1]];
+            const int c = BASE64_VALUES[in[2]];
+            const int d = BASE64_VALUES[in[3]];
+
+            if ((a | b | c | d) >= 0)
+            {
+                *out++ = (a << 2) | (b >> 4);
+                *out++ = ((b << 4) | (c >> 2)) & 0xff;
+                *out++ = ((c << 6) | d) & 0xff;
+                in += 4;
+                continue;
+            }
+        }
+
+        const int value = BASE64_VALUES[*in++];
+        if (value == -1)
+            continue;
+        if (value < 0)
+            break;
+
+        bits = (bits << 6) | value;
+        if (++count == 4)
+        {
+            *out++ = (bits >> 16) & 0xff;
+            *out++ = (bits >> 8) & 0xff;
+            *out++ = bits & 0xff;
+            bits = 0;
+            count = 0;
+        }
+    }
+
+    // A partial group at the end still holds one or two bytes
+    if (count == 3)
+    {
+        *out++ = (bits >> 10) & 0xff;
+        *out++ = (bits >> 2) & 0xff;
+    }
+    else if (count == 2)
+    {
+        *out++ = (bits >> 4) & 0xff;
+    }
+
+    return out - start;
+}
+
+/**
+ * Inflates zlib or gzip deflated layer data into a buffer of the size the
+ * layer needs. Any data beyond that is ignored.
+ *
+ * @return the number of inflated bytes, or -1 on error.
+ */
+static int inflateLayer(unsigned char *in, unsigned int inLength,
+                        unsigned char *out, unsigned int outLength)
+{
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = in;
+    strm.avail_in = inLength;
+    strm.next_out = out;
+    strm.avail_out = outLength;
+
+    if (inflateInit2(&strm, 15 + 32) != Z_OK)
+        return -1;
+
+    const int ret = inflate(&strm, Z_FINISH);
+    const unsigned int remaining = strm.avail_out;
+    inflateEnd(&strm);
+
+    if (ret == Z_STREAM_END ||
+        ((ret == Z_OK || ret == Z_BUF_ERROR) && remaining == 0))
+    {
+        return outLength - remaining;
+    }
+
+    return -1;
+}
+
+std::vector<std::string> MapData::getImagePaths() const
+{
+    std::vector<std::string> paths;
+
+    for (std::vector<TilesetInfo>::const_iterator i = tilesets.begin();
+         i != tilesets.end(); ++i)
+    {
+        if (!i->image.empty())
+            paths.push_back(i->image);
+    }
+
+    for (int i = 0; hasProperty("overlay" + toString(i) + "image"); i++)
+        paths.push_back(getProperty("overlay" + toString(i) + "image"));
+
+    if (hasProperty("minimap"))
+        paths.push_back(getProperty("minimap"));
+
+    return paths;
+}
+
 Map *MapReader::readMap(const std::string &filename)
 {
+    MapData *data = parseMap(filename);
+    if (!data)
+        return NULL;
+
+    Map *map = createMap(*data);
+    delete data;
+    return map;
+}
+
+MapData *MapReader::parseMap(const std::string &filename, bool useCache)
+{
+    TraceScope trace("MapReader::parseMap", filename);
+
     logger->log("Attempting to read map %s", filename.c_str());
     // Load the file through resource manager
     ResourceManager *resman = ResourceManager::getInstance();
     int fileSize;
     void *buffer = resman->loadFile(filename, fileSize);
-    Map *map = NULL;
+    MapData *data = NULL;
 
     if (buffer == NULL)
     {
@@ -156,6 +321,16 @@ Map *MapReader::readMap(const std::string &filename)
         return NULL;
     }
 
+    // Use the cached map when it was made from this same file
+    const unsigned long checksum =
+        adler32(adler32(0L, Z_NULL, 0), (Bytef*) buffer, fileSize);
+
+    if (useCache && (data = MapCache::load(filename, checksum)))
+    {
+        free(buffer);
+        return data;
+    }
+
     unsigned char *inflated;
     unsigned int inflatedSize;
 
@@ -190,52 +365,56 @@ Map *MapReader::readMap(const std::string &filename)
             logger->log("Error: Not a map file (%s)!", filename.c_str());
         }
         else {
-            map = readMap(node, filename);
+            data = parseMap(node, filename);
         }
     } else {
         logger->log("Error while parsing map file (%s)!", filename.c_str());
     }
 
-    if (map) map->setProperty("_filename", filename);
+    if (data)
+    {
+        data->setProperty("_filename", filename);
+        if (useCache)
+            MapCache::save(filename, checksum, *data);
+    }
 
-    return map;
+    return data;
 }
 
-Map *MapReader::readMap(xmlNodePtr node, const std::string &path)
+MapData *MapReader::parseMap(xmlNodePtr node, const std::string &path)
 {
     // Take the filename off the path
     const std::string pathDir = path.substr(0, path.rfind("/") + 1);
 
-    const int w = XML::getProperty(node, "width", 0);
-    const int h = XML::getProperty(node, "height", 0);
-    const int tilew = XML::getProperty(node, "tilewidth", DEFAULT_TILE_WIDTH);
-    const int tileh = XML::getProperty(node, "tileheight", DEFAULT_TILE_HEIGHT);
-    Map *map = new Map(w, h, tilew, tileh);
+    MapData *data = new MapData;
+    data->width = XML::getProperty(node, "width", 0);
+    data->height = XML::getProperty(node, "height", 0);
+    data->tileWidth =
+        XML::getProperty(node, "tilewidth", DEFAULT_TILE_WIDTH);
+    data->tileHeight =
+        XML::getProperty(node, "tileheight", DEFAULT_TILE_HEIGHT);
 
     for_each_xml_child_node(childNode, node)
     {
         if (xmlStrEqual(childNode->name, BAD_CAST "tileset"))
         {
-            Tileset *tileset = readTileset(childNode, pathDir, map);
-            if (tileset) {
-                map->addTileset(tileset);
-            }
+            readTileset(childNode, pathDir, data);
         }
         else if (xmlStrEqual(childNode->name, BAD_CAST "layer"))
         {
-            readLayer(childNode, map);
+            readLayer(childNode, data);
         }
         else if (xmlStrEqual(childNode->name, BAD_CAST "properties"))
         {
-            readProperties(childNode, map);
+            readProperties(childNode, data);
         }
         else if (xmlStrEqual(childNode->name, BAD_CAST "objectgroup"))
         {
             // The object group offset is applied to each object individually
             const int tileOffsetX = XML::getProperty(childNode, "x", 0);
             const int tileOffsetY = XML::getProperty(childNode, "y", 0);
-            const int offsetX = tileOffsetX * tilew;
-            const int offsetY = tileOffsetY * tileh;
+            const int offsetX = tileOffsetX * data->tileWidth;
+            const int offsetY = tileOffsetY * data->tileHeight;
 
             for_each_xml_child_node(objectNode, childNode)
             {
@@ -267,9 +446,11 @@ Map *MapReader::readMap(xmlNodePtr node, const std::string &path)
                             continue;
                         }
 
-                        map->addParticleEffect(objName,
-                                               objX + offsetX,
-                                               objY + offsetY);
+                        MapData::ParticleEffectInfo effect;
+                        effect.file = objName;
+                        effect.x = objX + offsetX;
+                        effect.y = objY + offsetY;
+                        data->particleEffects.push_back(effect);
                     }
                     else
                     {
@@ -280,9 +461,7 @@ Map *MapReader::readMap(xmlNodePtr node, const std::string &path)
         }
     }
 
-    map->initializeOverlays();
-
-    return map;
+    return data;
 }
 
 void MapReader::readProperties(xmlNodePtr node, Properties *props)
@@ -301,40 +480,148 @@ void MapReader::readProperties(xmlNodePtr node, Properties *props)
     }
 }
 
-static void setTile(Map *map, MapLayer *layer, int x, int y, int gid)
+Map *MapReader::createMap(const MapData &data)
 {
-    const Tileset * const set = map->getTilesetWithGid(gid);
-    if (layer)
+    TraceScope trace("MapReader::createMap", data.getProperty("_filename"));
+
+    Map *map = new Map(data.width, data.height,
+                       data.tileWidth, data.tileHeight);
+
+    // The map takes over the properties read from the file
+    static_cast<Properties&>(*map) = data;
+
+    ResourceManager *resman = ResourceManager::getInstance();
+    std::vector<const Tileset*> tilesetForGid;
+
+    for (std::vector<MapData::TilesetInfo>::const_iterator i =
+             data.tilesets.begin(); i != data.tilesets.end(); ++i)
     {
-        // Set regular tile on a layer
-        Image * const img = set ? set->get(gid - set->getFirstGid()) : 0;
-        layer->setTile(x, y, img);
-    } else {
-        // Set collision tile
-        if (set && (gid - set->getFirstGid() != 0))
-            map->blockTile(x, y, Map::BLOCKTYPE_WALL);
+        if (i->image.empty())
+            continue;
+
+        Image *tilebmp = resman->getImage(i->image);
+        if (!tilebmp)
+        {
+            logger->log("Warning: Failed to load tileset (%s)",
+                        i->image.c_str());
+            continue;
+        }
+
+        Tileset *set = new Tileset(tilebmp, i->tileWidth, i->tileHeight,
+                                   i->firstGid);
+        tilebmp->decRef();
+        map->addTileset(set);
+
+        // Gids are looked up in a table rather than by searching the
+        // tilesets, with the first tileset containing a gid taking it. The
+        // layers refer to the tiles by gid in the tile table of the map.
+        const int lastGid = i->firstGid + (int) set->size();
+        if (lastGid - 1 > MAX_TILE_GID)
+            logger->log("Warning: Tiles with a gid above %d are not drawn "
+                        "(%s)", MAX_TILE_GID, i->image.c_str());
+        if (lastGid > (int) tilesetForGid.size())
+            tilesetForGid.resize(lastGid, 0);
+        for (int gid = std::max(i->firstGid, 1); gid < lastGid; gid++)
+        {
+            if (tilesetForGid[gid])
+                continue;
+
+            tilesetForGid[gid] = set;
+            if (gid <= MAX_TILE_GID)
+                map->setTileImage(gid, set->get(gid - i->firstGid));
+        }
+
+        for (std::vector<MapData::TileAnimationInfo>::const_iterator j =
+                 i->animations.begin(); j != i->animations.end(); ++j)
+        {
+            if (j->gid <= 0 || j->gid > MAX_TILE_GID)
+                continue;
+
+            Animation *ani = new Animation;
+            for (std::vector<MapData::AnimationFrame>::const_iterator k =
+                     j->frames.begin(); k != j->frames.end(); ++k)
+            {
+                ani->addFrame(set->get(k->first), k->second, 0, 0);
+            }
+
+            map->addAnimation(j->gid, new TileAnimation(ani, map, j->gid));
+        }
+    }
+
+    for (std::vector<MapData::LayerInfo>::const_iterator i =
+             data.layers.begin(); i != data.layers.end(); ++i)
+    {
+        MapLayer *layer = 0;
+
+        if (!i->collision) {
+            layer = new MapLayer(i->x, i->y, i->width, i->height, i->fringe,
+                                 map);
+            map->addLayer(layer);
+        }
+
+        for (int y = 0; y < i->height; y++)
+        {
+            for (int x = 0; x < i->width; x++)
+            {
+                const int index = x + y * i->width;
+                const int gid = i->gids[index];
+                if (gid <= 0 || gid >= (int) tilesetForGid.size())
+                    continue;
+
+                const Tileset * const set = tilesetForGid[gid];
+                if (!set)
+                    continue;
+
+                if (layer)
+                {
+                    if (gid > MAX_TILE_GID)
+                        continue;
+
+                    // Set regular tile on a layer
+                    layer->setTile(x, y, gid);
+
+                    TileAnimation *ani = map->getAnimationForGid(gid);
+                    if (ani)
+                        ani->addAffectedTile(layer, index);
+                }
+                else if (gid != set->getFirstGid())
+                {
+                    // Set collision tile
+                    map->blockTile(x, y, Map::BLOCKTYPE_WALL);
+                }
+            }
+        }
     }
+
+    for (std::vector<MapData::ParticleEffectInfo>::const_iterator i =
+             data.particleEffects.begin(); i != data.particleEffects.end(); ++i)
+    {
+        map->addParticleEffect(i->file, i->x, i->y);
+    }
+
+    map->initializeOverlays();
+    map->initializeOcclusion();
+
+    return map;
 }
 
-void MapReader::readLayer(xmlNodePtr node, Map *map)
+void MapReader::readLayer(xmlNodePtr node, MapData *data)
 {
     // Layers are not necessarily the same size as the map
-    const int w = XML::getProperty(node, "width", map->getWidth());
-    const int h = XML::getProperty(node, "height", map->getHeight());
-    const int offsetX = XML::getProperty(node, "x", 0);
-    const int offsetY = XML::getProperty(node, "y", 0);
+    const int w = XML::getProperty(node, "width", data->width);
+    const int h = XML::getProperty(node, "height", data->height);
     std::string name = XML::getProperty(node, "name", "");
     name = toLower(name);
 
-    const bool isFringeLayer = (name.substr(0,6) == "fringe");
-    const bool isCollisionLayer = (name.substr(0,9) == "collision");
-
-    MapLayer *layer = 0;
-
-    if (!isCollisionLayer) {
-        layer = new MapLayer(offsetX, offsetY, w, h, isFringeLayer);
-        map->addLayer(layer);
-    }
+    data->layers.push_back(MapData::LayerInfo());
+    MapData::LayerInfo &layer = data->layers.back();
+    layer.x = XML::getProperty(node, "x", 0);
+    layer.y = XML::getProperty(node, "y", 0);
+    layer.width = w;
+    layer.height = h;
+    layer.fringe = (name.substr(0,6) == "fringe");
+    layer.collision = (name.substr(0,9) == "collision");
+    layer.gids.resize(w * h, 0);
 
     logger->log("- Loading layer \"%s\"", name.c_str());
     int x = 0;
@@ -363,69 +650,39 @@ void MapReader::readLayer(xmlNodePtr node, Map *map)
             if (!dataChild)
                 continue;
 
-            int len = strlen((const char*)dataChild->content) + 1;
-            unsigned char *charData = new unsigned char[len + 1];
-            const char *charStart = (const char*)dataChild->content;
-            unsigned char *charIndex = charData;
-
-            while (*charStart) {
-                if (*charStart != ' ' && *charStart != '\t' &&
-                    *charStart != '\n')
-                {
-                    *charIndex = *charStart;
-                    charIndex++;
-                }
-                charStart++;
-            }
-            *charIndex = '\0';
-
-            int binLen;
+            const unsigned char *text = dataChild->content;
+            const int textLength = xmlStrlen(text);
             unsigned char *binData =
-                php3_base64_decode(charData, strlen((char*)charData), &binLen);
+                (unsigned char*) malloc(textLength / 4 * 3 + 3);
+            int binLen = decodeBase64(text, textLength, binData);
 
-            delete[] charData;
+            if (compression == "gzip") {
+                // Inflate the gzipped layer data straight into a buffer of
+                // the size of the layer
+                const unsigned int layerSize = w * h * 4;
+                unsigned char *inflated = (unsigned char*) malloc(layerSize);
+                binLen = inflateLayer(binData, binLen, inflated, layerSize);
 
-            if (binData) {
-                if (compression == "gzip") {
-                    // Inflate the gzipped layer data
-                    unsigned char *inflated;
-                    unsigned int inflatedSize =
-                        inflateMemory(binData, binLen, inflated);
+                free(binData);
+                binData = inflated;
 
+                if (binLen < 0) {
+                    logger->log("Error: Could not decompress layer!");
                     free(binData);
-                    binData = inflated;
-                    binLen = inflatedSize;
-
-                    if (!inflated) {
-                        logger->log("Error: Could not decompress layer!");
-                        return;
-                    }
+                    return;
                 }
+            }
 
-                for (int i = 0; i < binLen - 3; i += 4) {
-                    const int gid = binData[i] |
-                        binData[i + 1] << 8 |
-                        binData[i + 2] << 16 |
-                        binData[i + 3] << 24;
-
-                    setTile(map, layer, x, y, gid);
-
-                    TileAnimation* ani = map->getAnimationForGid(gid);
-                    if (ani)
-                    {
-                        ani->addAffectedTile(layer, x + y * w);
-                    }
-
-                    x++;
-                    if (x == w) {
-                        x = 0; y++;
+            const int count = std::min(binLen / 4, w * h);
+            for (int i = 0; i < count; i++) {
+                const unsigned char *p = binData + i * 4;
+                layer.gids[i] = p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+            }
+            free(binData);
 
-                        // When we're done, don't crash on too much data
-                        if (y == h)
-                            break;
-                    }
-                }
-                free(binData);
+            if (w > 0) {
+                x = count % w;
+                y = count / w;
             }
         }
         else {
@@ -436,7 +693,7 @@ void MapReader::readLayer(xmlNodePtr node, Map *map)
                     continue;
 
                 const int gid = XML::getProperty(childNode2, "gid", -1);
-                setTile(map, layer, x, y, gid);
+                layer.gids[x + y * w] = gid;
 
                 x++;
                 if (x == w) {
@@ -457,13 +714,12 @@ void MapReader::readLayer(xmlNodePtr node, Map *map)
     }
 }
 
-Tileset *MapReader::readTileset(xmlNodePtr node,
-                                const std::string &path,
-                                Map *map)
+void MapReader::readTileset(xmlNodePtr node,
+                            const std::string &path,
+                            MapData *data)
 {
     int firstGid = XML::getProperty(node, "firstgid", 0);
     XML::Document* doc = NULL;
-    Tileset *set = NULL;
 
     if (xmlHasProp(node, BAD_CAST "source"))
     {
@@ -475,8 +731,10 @@ Tileset *MapReader::readTileset(xmlNodePtr node,
         firstGid += XML::getProperty(node, "firstgid", 0);
     }
 
-    const int tw = XML::getProperty(node, "tilewidth", map->getTileWidth());
-    const int th = XML::getProperty(node, "tileheight", map->getTileHeight());
+    MapData::TilesetInfo set;
+    set.firstGid = firstGid;
+    set.tileWidth = XML::getProperty(node, "tilewidth", data->tileWidth);
+    set.tileHeight = XML::getProperty(node, "tileheight", data->tileHeight);
 
     for_each_xml_child_node(childNode, node)
     {
@@ -486,21 +744,8 @@ Tileset *MapReader::readTileset(xmlNodePtr node,
 
             if (!source.empty())
             {
-                std::string sourceStr = source;
-                sourceStr.erase(0, 3);  // Remove "../"
-
-                ResourceManager *resman = ResourceManager::getInstance();
-                Image* tilebmp = resman->getImage(sourceStr);
-
-                if (tilebmp)
-                {
-                    set = new Tileset(tilebmp, tw, th, firstGid);
-                    tilebmp->decRef();
-                }
-                else {
-                    logger->log("Warning: Failed to load tileset (%s)",
-                            source.c_str());
-                }
+                set.image = source;
+                set.image.erase(0, 3);  // Remove "../"
             }
         }
         else if (xmlStrEqual(childNode->name, BAD_CAST "tile"))
@@ -523,9 +768,8 @@ Tileset *MapReader::readTileset(xmlNodePtr node,
                 }
 
                 // create animation
-                if (!set) continue;
-
-                Animation *ani = new Animation;
+                MapData::TileAnimationInfo ani;
+                ani.gid = tileGID;
                 for (int i = 0; ;i++)
                 {
                     std::map<std::string, int>::iterator iFrame, iDelay;
@@ -533,18 +777,18 @@ Tileset *MapReader::readTileset(xmlNodePtr node,
                     iDelay = tileProperties.find("animation-delay" + toString(i));
                     if (iFrame != tileProperties.end() && iDelay != tileProperties.end())
                     {
-                        ani->addFrame(set->get(iFrame->second), iDelay->second, 0, 0);
+                        ani.frames.push_back(MapData::AnimationFrame(
+                                    iFrame->second, iDelay->second));
                     } else {
                         break;
                     }
                 }
 
-                if (ani->getLength() > 0)
+                if (!ani.frames.empty())
                 {
-                    map->addAnimation(tileGID, new TileAnimation(ani));
-                    logger->log("Animation length: %d", ani->getLength());
-                } else {
-                    delete ani;
+                    set.animations.push_back(ani);
+                    logger->log("Animation length: %d",
+                                (int) ani.frames.size());
                 }
             }
         }
@@ -552,5 +796,5 @@ Tileset *MapReader::readTileset(xmlNodePtr node,
 
     delete doc;
 
-    return set;
+    data->tilesets.push_back(set);
 }
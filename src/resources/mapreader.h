@@ -22,11 +22,71 @@
 #ifndef MAPREADER_H
 #define MAPREADER_H
 
+#include "properties.h"
+
 #include <libxml/tree.h>
 
+#include <string>
+#include <utility>
+#include <vector>
+
 class Map;
-class Properties;
-class Tileset;
+
+/**
+ * The contents of a map file, as read by MapReader::parseMap(). Since no
+ * images are loaded yet, it can be read on any thread. The properties are
+ * those of the map.
+ */
+struct MapData : public Properties
+{
+    /**
+     * A frame of a tile animation, as a tile index in the tileset and a
+     * delay in milliseconds.
+     */
+    typedef std::pair<int, int> AnimationFrame;
+
+    struct TileAnimationInfo
+    {
+        int gid;
+        std::vector<AnimationFrame> frames;
+    };
+
+    struct TilesetInfo
+    {
+        std::string image;      /**< Path of the tileset image */
+        int firstGid;
+        int tileWidth;
+        int tileHeight;
+        std::vector<TileAnimationInfo> animations;
+    };
+
+    struct LayerInfo
+    {
+        int x, y;
+        int width, height;
+        bool fringe;
+        bool collision;
+        std::vector<int> gids;  /**< The tiles by index, 0 for none */
+    };
+
+    struct ParticleEffectInfo
+    {
+        std::string file;
+        int x, y;
+    };
+
+    int width, height;
+    int tileWidth, tileHeight;
+    std::vector<TilesetInfo> tilesets;
+    std::vector<LayerInfo> layers;
+    std::vector<ParticleEffectInfo> particleEffects;
+
+    /**
+     * Returns the paths of the images used by the map: the tileset images,
+     * the overlays and the minimap.
+     */
+    std::vector<std::string> getImagePaths() const;
+};
 
 /**
  * Reader for XML map files (*.tmx)
@@ -39,13 +99,31 @@ class MapReader
          */
         static Map *readMap(const std::string &filename);
 
+        /**
+         * Reads and decodes an XML map file without creating the map. Safe
+         * to call from any thread.
+         *
+         * @param filename the map file
+         * @param useCache whether to use and update the map cache
+         * @return <code>NULL</code> if the map could not be read. The caller
+         *         is expected to delete the returned data.
+         */
+        static MapData *parseMap(const std::string &filename,
+                                 bool useCache = true);
+
+        /**
+         * Creates a map from data returned by parseMap(), loading the images
+         * it uses. Needs to be called from the main thread.
+         */
+        static Map *createMap(const MapData &data);
+
+    private:
         /**
          * Read an XML map from a parsed XML tree. The path is used to find the
          * location of referenced tileset images.
          */
-        static Map *readMap(xmlNodePtr node, const std::string &path);
+        static MapData *parseMap(xmlNodePtr node, const std::string &path);
 
-    private:
         /**
          * Reads the properties element.
          *
@@ -56,15 +134,15 @@ class MapReader
         static void readProperties(xmlNodePtr node, Properties* props);
 
         /**
-         * Reads a map layer and adds it to the given map.
+         * Reads a map layer and adds it to the given map data.
          */
-        static void readLayer(xmlNodePtr node, Map *map);
+        static void readLayer(xmlNodePtr node, MapData *data);
 
         /**
-         * Reads a tile set.
+         * Reads a tile set and adds it to the given map data.
          */
-        static Tileset *readTileset(xmlNodePtr node, const std::string &path,
-                                    Map *map);
+        static void readTileset(xmlNodePtr node, const std::string &path,
+                                MapData *data);
 
         /**
          * Gets an integer property from an xmlNodePtr.
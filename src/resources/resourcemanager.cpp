@@ -29,7 +29,12 @@
 #include "resources/spritedef.h"
 
 #include "log.h"
+#include "tracer.h"
 
+#include "utils/clock.h"
+#include "utils/xml.h"
+
+#include <algorithm>
 #include <cassert>
 #include <physfs.h>
 #include <SDL_image.h>
@@ -37,16 +42,163 @@
 
 #include <sys/time.h>
 
+/**
+ * The number of threads reading and decoding resources in the background.
+ */
+static const int LOADER_THREADS = 2;
+
+/**
+ * The time processAsyncLoads() may spend per call, in microseconds.
+ */
+static const Uint64 ASYNC_LOAD_BUDGET = 4000;
+
+/**
+ * A resource to be loaded in the background. The loader threads fill in the
+ * decoded images, which are turned into resources on the main thread.
+ */
+struct ResourceManager::LoadJob
+{
+    enum Type { IMAGE, SPRITE };
+
+    typedef std::pair<std::string, SDL_Surface*> DecodedImage;
+
+    Type type;
+    std::string path;
+    int variant;
+    ResourceHandle *handle;
+    std::vector<DecodedImage> images;   /**< Surfaces may be NULL */
+};
+
+namespace {
+
+    /**
+     * Collects the paths of the images used by a sprite definition and the
+     * sprites it includes, the way SpriteDef loads them.
+     */
+    void collectSpriteImages(xmlNodePtr spriteNode,
+                             const std::string &palettes,
+                             std::vector<std::string> &images)
+    {
+        for_each_xml_child_node(node, spriteNode)
+        {
+            if (xmlStrEqual(node->name, BAD_CAST "imageset"))
+            {
+                std::string src = XML::getProperty(node, "src", "");
+                Dye::instantiate(src, palettes);
+
+                if (!src.empty() &&
+                    std::find(images.begin(), images.end(), src) ==
+                    images.end())
+                {
+                    images.push_back(src);
+                }
+            }
+            else if (xmlStrEqual(node->name, BAD_CAST "include"))
+            {
+                const std::string file = XML::getProperty(node, "file", "");
+                if (file.empty())
+                    continue;
+
+                XML::Document doc("graphics/sprites/" + file);
+                xmlNodePtr rootNode = doc.rootNode();
+
+                if (rootNode && xmlStrEqual(rootNode->name, BAD_CAST "sprite"))
+                    collectSpriteImages(rootNode, "", images);
+            }
+        }
+    }
+
+    /**
+     * Reads and decodes the image with the given identifier path, which may
+     * contain a dye specification. Safe to call from any thread.
+     */
+    SDL_Surface *decodeImage(const std::string &idPath)
+    {
+        TraceScope trace("ResourceManager::decode", idPath);
+
+        std::string path = idPath;
+        std::string::size_type p = path.find('|');
+        Dye *d = NULL;
+        if (p != std::string::npos)
+        {
+            d = new Dye(path.substr(p + 1));
+            path = path.substr(0, p);
+        }
+
+        int fileSize;
+        void *buffer = ResourceManager::getInstance()->loadFile(path,
+                                                                fileSize);
+        SDL_Surface *surface = NULL;
+        if (buffer)
+        {
+            surface = Image::decode(buffer, fileSize, d);
+            free(buffer);
+        }
+
+        delete d;
+        return surface;
+    }
+
+} // namespace
+
+ResourceHandle::ResourceHandle(callback fun, void *data):
+    mResource(NULL),
+    mCallback(fun),
+    mData(data),
+    mReady(false),
+    mReleased(false)
+{
+}
+
+ResourceHandle::~ResourceHandle()
+{
+    if (mResource)
+        mResource->decRef();
+}
+
+void ResourceHandle::release()
+{
+    // While loading, the resource manager still refers to the handle and
+    // deletes it once it is done
+    if (mReady)
+        delete this;
+    else
+        mReleased = true;
+}
+
+void ResourceHandle::finish(Resource *resource)
+{
+    mResource = resource;
+    mReady = true;
+
+    if (mReleased)
+        delete this;
+    else if (mCallback)
+        mCallback(this, mData);
+}
+
+void ResourceHandle::cancel()
+{
+    mReady = true;
+
+    if (mReleased)
+        delete this;
+}
+
 ResourceManager *ResourceManager::instance = NULL;
 
 ResourceManager::ResourceManager()
-  : mOldestOrphan(0)
+  : mOldestOrphan(0),
+    mLoadSemaphore(NULL),
+    mStopLoading(false)
 {
     logger->log("Initializing resource manager...");
 }
 
 ResourceManager::~ResourceManager()
 {
+    stopLoaderThreads();
+
     mResources.insert(mOrphanedResources.begin(), mOrphanedResources.end());
 
     // Release any remaining spritedefs first because they depend on image sets
@@ -248,6 +400,8 @@ Resource *ResourceManager::get(const std::string &idPath, generator fun,
         return res;
     }
 
+    // Only creating the resource is traced, finding it is too quick to show
+    TraceScope trace("ResourceManager::get", idPath);
     Resource *resource = fun(data);
 
     if (resource)
@@ -371,6 +525,253 @@ SpriteDef *ResourceManager::getSprite(const std::string &path, int variant)
     return static_cast<SpriteDef*>(get(ss.str(), SpriteDefLoader::load, &l));
 }
 
+bool ResourceManager::isLoaded(const std::string &idPath) const
+{
+    return mResources.find(idPath) != mResources.end() ||
+           mOrphanedResources.find(idPath) != mOrphanedResources.end();
+}
+
+ResourceHandle *ResourceManager::getImageAsync(const std::string &idPath,
+                                               ResourceHandle::callback fun,
+                                               void *data)
+{
+    ResourceHandle *handle = new ResourceHandle(fun, data);
+
+    if (isLoaded(idPath))
+    {
+        handle->finish(getImage(idPath));
+        return handle;
+    }
+
+    LoadJob *job = new LoadJob;
+    job->type = LoadJob::IMAGE;
+    job->path = idPath;
+    job->variant = 0;
+    job->handle = handle;
+    queueLoad(job);
+
+    return handle;
+}
+
+ResourceHandle *ResourceManager::getSpriteAsync(const std::string &path,
+                                                int variant,
+                                                ResourceHandle::callback fun,
+                                                void *data)
+{
+    ResourceHandle *handle = new ResourceHandle(fun, data);
+
+    std::stringstream ss;
+    ss << path << "[" << variant << "]";
+    if (isLoaded(ss.str()))
+    {
+        handle->finish(getSprite(path, variant));
+        return handle;
+    }
+
+    LoadJob *job = new LoadJob;
+    job->type = LoadJob::SPRITE;
+    job->path = path;
+    job->variant = variant;
+    job->handle = handle;
+    queueLoad(job);
+
+    return handle;
+}
+
+void ResourceManager::queueLoad(LoadJob *job)
+{
+    if (mLoaderThreads.empty())
+    {
+        mLoadSemaphore = SDL_CreateSemaphore(0);
+        for (int i = 0; i < LOADER_THREADS; i++)
+        {
+            SDL_Thread *thread = SDL_CreateThread(loaderThread, this);
+            if (thread)
+                mLoaderThreads.push_back(thread);
+        }
+
+        if (mLoaderThreads.empty())
+        {
+            logger->log("Error, unable to start loader threads: %s",
+                        SDL_GetError());
+        }
+    }
+
+    MutexLocker lock(&mLoadMutex);
+
+    // Without loader threads, the job is finished without decoding anything
+    // and the resource is loaded on the main thread
+    if (mLoaderThreads.empty())
+    {
+        mFinishedLoads.push_back(job);
+        return;
+    }
+
+    mPendingLoads.push_back(job);
+    SDL_SemPost(mLoadSemaphore);
+}
+
+int ResourceManager::loaderThread(void *data)
+{
+    ResourceManager *manager = static_cast<ResourceManager*>(data);
+    Tracer::setThreadName("loader");
+
+    while (true)
+    {
+        SDL_SemWait(manager->mLoadSemaphore);
+
+        LoadJob *job;
+        {
+            MutexLocker lock(&manager->mLoadMutex);
+            if (manager->mStopLoading)
+                break;
+
+            job = manager->mPendingLoads.front();
+            manager->mPendingLoads.pop_front();
+        }
+
+        std::vector<std::string> images;
+
+        if (job->type == LoadJob::IMAGE)
+        {
+            images.push_back(job->path);
+        }
+        else
+        {
+            TraceScope trace("ResourceManager::parseSprite", job->path);
+
+            const std::string::size_type pos = job->path.find('|');
+            std::string palettes;
+            if (pos != std::string::npos)
+                palettes = job->path.substr(pos + 1);
+
+            XML::Document doc(job->path.substr(0, pos));
+            xmlNodePtr rootNode = doc.rootNode();
+
+            if (rootNode && xmlStrEqual(rootNode->name, BAD_CAST "sprite"))
+                collectSpriteImages(rootNode, palettes, images);
+        }
+
+        for (std::vector<std::string>::const_iterator i = images.begin();
+             i != images.end(); ++i)
+        {
+            job->images.push_back(LoadJob::DecodedImage(*i, decodeImage(*i)));
+        }
+
+        MutexLocker lock(&manager->mLoadMutex);
+        manager->mFinishedLoads.push_back(job);
+    }
+
+    return 0;
+}
+
+void ResourceManager::processAsyncLoads()
+{
+    const Uint64 deadline = getMicroseconds() + ASYNC_LOAD_BUDGET;
+
+    do
+    {
+        LoadJob *job;
+        {
+            MutexLocker lock(&mLoadMutex);
+            if (mFinishedLoads.empty())
+                return;
+
+            job = mFinishedLoads.front();
+            mFinishedLoads.pop_front();
+        }
+
+        finishLoad(job);
+    }
+    while (getMicroseconds() < deadline);
+}
+
+void ResourceManager::finishLoad(LoadJob *job)
+{
+    TraceScope trace("ResourceManager::finishLoad", job->path);
+
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    const time_t timestamp = tv.tv_sec;
+
+    // The decoded images are added as orphans, so they are cleaned up as
+    // usual when nothing ends up using them
+    bool failed = false;
+    for (std::vector<LoadJob::DecodedImage>::iterator i = job->images.begin();
+         i != job->images.end(); ++i)
+    {
+        SDL_Surface *surface = i->second;
+        if (!surface)
+        {
+            failed = true;
+            continue;
+        }
+
+        // Another request may have loaded the image in the meantime
+        if (!isLoaded(i->first))
+        {
+            if (Image *image = Image::loadDecoded(surface))
+            {
+                image->mIdPath = i->first;
+                image->mTimeStamp = timestamp;
+                if (mOrphanedResources.empty()) mOldestOrphan = timestamp;
+                mOrphanedResources[i->first] = image;
+            }
+        }
+
+        SDL_FreeSurface(surface);
+    }
+
+    Resource *resource;
+    if (job->type == LoadJob::IMAGE)
+        resource = (failed && !isLoaded(job->path)) ? NULL
+                                                    : getImage(job->path);
+    else
+        resource = getSprite(job->path, job->variant);
+
+    job->handle->finish(resource);
+    delete job;
+}
+
+void ResourceManager::stopLoaderThreads()
+{
+    {
+        MutexLocker lock(&mLoadMutex);
+        mStopLoading = true;
+    }
+
+    for (unsigned i = 0; i < mLoaderThreads.size(); i++)
+        SDL_SemPost(mLoadSemaphore);
+    for (unsigned i = 0; i < mLoaderThreads.size(); i++)
+        SDL_WaitThread(mLoaderThreads[i], NULL);
+    mLoaderThreads.clear();
+
+    if (mLoadSemaphore)
+    {
+        SDL_DestroySemaphore(mLoadSemaphore);
+        mLoadSemaphore = NULL;
+    }
+
+    // Handles that are still in use are deleted once their owners release
+    // them, without calling back into owners that may be shutting down
+    mPendingLoads.splice(mPendingLoads.end(), mFinishedLoads);
+    for (std::list<LoadJob*>::iterator i = mPendingLoads.begin();
+         i != mPendingLoads.end(); ++i)
+    {
+        LoadJob *job = *i;
+        for (std::vector<LoadJob::DecodedImage>::iterator j =
+                 job->images.begin(); j != job->images.end(); ++j)
+        {
+            if (j->second)
+                SDL_FreeSurface(j->second);
+        }
+
+        job->handle->cancel();
+        delete job;
+    }
+    mPendingLoads.clear();
+}
+
 void ResourceManager::release(Resource *res)
 {
     ResourceIterator resIter = mResources.find(res->mIdPath);
@@ -405,6 +806,8 @@ void ResourceManager::deleteInstance()
 
 void *ResourceManager::loadFile(const std::string &fileName, int &fileSize)
 {
+    TraceScope trace("ResourceManager::loadFile", fileName);
+
     // Attempt to open the specified file using PhysicsFS
     PHYSFS_file *file = PHYSFS_openRead(fileName.c_str());
 
@@ -22,7 +22,10 @@
 #ifndef RESOURCE_MANAGER_H
 #define RESOURCE_MANAGER_H
 
+#include "utils/mutex.h"
+
 #include <ctime>
+#include <list>
 #include <map>
 #include <string>
 #include <vector>
@@ -35,6 +38,67 @@ class SoundEffect;
 class SpriteDef;
 struct SDL_Surface;
 
+/**
+ * A resource that is being loaded in the background. Handles are only meant
+ * to be used from the main thread.
+ */
+class ResourceHandle
+{
+    friend class ResourceManager;
+
+    public:
+        /**
+         * Called on the main thread once the resource is ready.
+         */
+        typedef void (*callback)(ResourceHandle *handle, void *data);
+
+        /**
+         * Tells whether loading has finished. The resource may still be
+         * <code>NULL</code> when it could not be loaded.
+         */
+        bool isReady() const
+        { return mReady; }
+
+        /**
+         * Returns the loaded resource, or <code>NULL</code> when it isn't
+         * ready or could not be loaded. The handle keeps a reference to the
+         * resource until it is released, so callers that want to keep the
+         * resource around need to add their own reference.
+         */
+        Resource *getResource() const
+        { return mResource; }
+
+        /**
+         * Tells the handle it is no longer needed. The callback won't be
+         * called anymore and the handle deletes itself.
+         */
+        void release();
+
+    private:
+        ResourceHandle(callback fun, void *data);
+
+        ~ResourceHandle();
+
+        /**
+         * Stores the loaded resource, taking over its reference, and calls
+         * the callback.
+         */
+        void finish(Resource *resource);
+
+        /**
+         * Gives up on loading without calling the callback. The handle is
+         * deleted right away when it was released already, or otherwise as
+         * soon as its owner releases it.
+         */
+        void cancel();
+
+        Resource *mResource;
+        callback mCallback;
+        void *mData;
+        bool mReady;
+        bool mReleased;         /**< Whether the owner released the handle */
+};
+
 /**
  * A class for loading and managing resources.
  */
@@ -174,6 +238,38 @@ class ResourceManager
          */
         SpriteDef *getSprite(const std::string &path, int variant = 0);
 
+        /**
+         * Starts loading an image in the background. Reading and decoding
+         * the file is done by the loader threads, while creating the image
+         * from the decoded data is left to processAsyncLoads().
+         *
+         * @param idPath The resource identifier path, as for getImage().
+         * @param fun    A function called when the image is ready. Is called
+         *               before returning when the image is already loaded.
+         * @param data   Extra parameter for the callback.
+         * @return A handle to be released by the caller.
+         */
+        ResourceHandle *getImageAsync(const std::string &idPath,
+                                      ResourceHandle::callback fun = 0,
+                                      void *data = 0);
+
+        /**
+         * Starts loading a sprite definition in the background, decoding
+         * the images it uses on the loader threads. Otherwise behaves like
+         * getImageAsync().
+         */
+        ResourceHandle *getSpriteAsync(const std::string &path,
+                                       int variant = 0,
+                                       ResourceHandle::callback fun = 0,
+                                       void *data = 0);
+
+        /**
+         * Turns data decoded by the loader threads into resources and
+         * notifies the handles waiting for them. Only spends a few
+         * milliseconds at a time, to be called every frame.
+         */
+        void processAsyncLoads();
+
         /**
          * Releases a resource, placing it in the set of orphaned resources.
          */
@@ -221,12 +317,46 @@ class ResourceManager
 
         void cleanOrphans();
 
+        /**
+         * Returns whether the given resource is loaded, possibly orphaned.
+         */
+        bool isLoaded(const std::string &idPath) const;
+
+        struct LoadJob;
+
+        /**
+         * Queues a job for the loader threads, starting them if needed.
+         */
+        void queueLoad(LoadJob *job);
+
+        /**
+         * Creates the resources decoded by a job and finishes its handle.
+         */
+        void finishLoad(LoadJob *job);
+
+        /**
+         * Stops the loader threads and discards the jobs they had left.
+         */
+        void stopLoaderThreads();
+
+        /**
+         * The function run by the loader threads.
+         */
+        static int loaderThread(void *data);
+
         static ResourceManager *instance;
         typedef std::map<std::string, Resource*> Resources;
         typedef Resources::iterator ResourceIterator;
         Resources mResources;
         Resources mOrphanedResources;
         time_t mOldestOrphan;
+
+        std::vector<SDL_Thread*> mLoaderThreads;
+        SDL_sem *mLoadSemaphore;            /**< Counts the pending jobs */
+        Mutex mLoadMutex;                   /**< Guards the job queues */
+        std::list<LoadJob*> mPendingLoads;
+        std::list<LoadJob*> mFinishedLoads;
+        bool mStopLoading;
 };
 
 #endif
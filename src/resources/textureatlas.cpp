@@ -0,0 +1,247 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "resources/textureatlas.h"
+
+#include "log.h"
+
+#include <algorithm>
+
+#ifdef USE_OPENGL
+
+/**
+ * The size of the atlas textures, as long as the hardware supports it.
+ */
+static const int ATLAS_SIZE = 2048;
+
+/**
+ * Space left between packed images, so they don't bleed into each other.
+ */
+static const int PADDING = 1;
+
+std::list<TextureAtlas*> TextureAtlas::mAtlases;
+
+TextureAtlas::TextureAtlas(int width, int height):
+    mWidth(width), mHeight(height),
+    mTop(0),
+    mImageCount(0),
+    mUsedArea(0),
+    mFreedArea(0)
+{
+    glGenTextures(1, &mTexture);
+    glBindTexture(Image::mTextureType, mTexture);
+
+    glTexImage2D(Image::mTextureType, 0, 4, mWidth, mHeight,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glTexParameteri(Image::mTextureType, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(Image::mTextureType, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    logger->log("Created %dx%d texture atlas", mWidth, mHeight);
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    glDeleteTextures(1, &mTexture);
+}
+
+bool TextureAtlas::allocate(int width, int height, int &x, int &y)
+{
+    // Use the lowest shelf the area fits on, to waste the least space
+    Shelf *best = NULL;
+
+    for (std::vector<Shelf>::iterator i = mShelves.begin();
+         i != mShelves.end(); ++i)
+    {
+        if (i->height >= height && mWidth - i->used >= width &&
+            (!best || i->height < best->height))
+        {
+            best = &(*i);
+        }
+    }
+
+    // Avoid putting small images on much higher shelves when a new shelf
+    // can still be started.
+    if ((!best || best->height > height * 2) && mTop + height <= mHeight)
+    {
+        Shelf shelf;
+        shelf.y = mTop;
+        shelf.height = height;
+        shelf.used = 0;
+        mShelves.push_back(shelf);
+        mTop += height;
+        best = &mShelves.back();
+    }
+
+    if (!best)
+        return false;
+
+    x = best->used;
+    y = best->y;
+    best->used += width;
+    return true;
+}
+
+Image *TextureAtlas::load(SDL_Surface *surface)
+{
+    const int size = std::min(ATLAS_SIZE, Image::mTextureSize);
+    const int width = surface->w + PADDING;
+    const int height = surface->h + PADDING;
+
+    // Large images are better off in their own texture
+    if (width > size / 2 || height > size / 2)
+        return NULL;
+
+    // Make sure the alpha channel is not used, but copied to destination
+    SDL_SetAlpha(surface, 0, SDL_ALPHA_OPAQUE);
+
+    // Determine 32-bit masks based on byte order
+    Uint32 rmask, gmask, bmask, amask;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    rmask = 0xff000000;
+    gmask = 0x00ff0000;
+    bmask = 0x0000ff00;
+    amask = 0x000000ff;
+#else
+    rmask = 0x000000ff;
+    gmask = 0x0000ff00;
+    bmask = 0x00ff0000;
+    amask = 0xff000000;
+#endif
+
+    // Converted before looking for room, so that no atlas space is taken
+    // and no atlas is created when this fails
+    SDL_Surface *rgba = SDL_CreateRGBSurface(SDL_SWSURFACE,
+            surface->w, surface->h, 32, rmask, gmask, bmask, amask);
+
+    if (!rgba)
+    {
+        logger->log("Error, image convert failed: out of memory");
+        return NULL;
+    }
+
+    SDL_BlitSurface(surface, NULL, rgba, NULL);
+
+    TextureAtlas *atlas = NULL;
+    int x, y;
+
+    for (std::list<TextureAtlas*>::iterator i = mAtlases.begin();
+         i != mAtlases.end(); ++i)
+    {
+        if ((*i)->allocate(width, height, x, y))
+        {
+            atlas = *i;
+            break;
+        }
+    }
+
+    if (!atlas)
+    {
+        // Flush current error flag.
+        glGetError();
+
+        atlas = new TextureAtlas(size, size);
+
+        // Only registered once it holds an image, since it is freed when its
+        // last image is released
+        if (glGetError() || !atlas->allocate(width, height, x, y))
+        {
+            logger->log("Error: Could not create texture atlas");
+            delete atlas;
+            SDL_FreeSurface(rgba);
+            return NULL;
+        }
+
+        mAtlases.push_back(atlas);
+    }
+
+    glBindTexture(Image::mTextureType, atlas->mTexture);
+
+    if (SDL_MUSTLOCK(rgba))
+        SDL_LockSurface(rgba);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(Image::mTextureType, 0, x, y,
+                    rgba->w, rgba->h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, rgba->pixels);
+
+    if (SDL_MUSTLOCK(rgba))
+        SDL_UnlockSurface(rgba);
+
+    SDL_FreeSurface(rgba);
+
+    atlas->mImageCount++;
+    atlas->mUsedArea += width * height;
+
+    Image *image = new Image(atlas->mTexture, surface->w, surface->h,
+                             atlas->mWidth, atlas->mHeight);
+    image->mBounds.x = x;
+    image->mBounds.y = y;
+    image->mAtlas = atlas;
+
+    return image;
+}
+
+void TextureAtlas::release(TextureAtlas *atlas, int width, int height)
+{
+    width += PADDING;
+    height += PADDING;
+
+    atlas->mUsedArea -= width * height;
+    atlas->mFreedArea += width * height;
+
+    if (--atlas->mImageCount > 0)
+        return;
+
+    mAtlases.remove(atlas);
+    delete atlas;
+}
+
+int TextureAtlas::getOccupancy()
+{
+    int used = 0, total = 0;
+
+    for (std::list<TextureAtlas*>::const_iterator i = mAtlases.begin();
+         i != mAtlases.end(); ++i)
+    {
+        used += (*i)->mUsedArea;
+        total += (*i)->mWidth * (*i)->mHeight;
+    }
+
+    return total ? (int) ((long long) used * 100 / total) : 0;
+}
+
+int TextureAtlas::getFragmentation()
+{
+    int freed = 0, allocated = 0;
+
+    for (std::list<TextureAtlas*>::const_iterator i = mAtlases.begin();
+         i != mAtlases.end(); ++i)
+    {
+        freed += (*i)->mFreedArea;
+        allocated += (*i)->mUsedArea + (*i)->mFreedArea;
+    }
+
+    return allocated ? (int) ((long long) freed * 100 / allocated) : 0;
+}
+
+#endif // USE_OPENGL
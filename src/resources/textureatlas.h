@@ -0,0 +1,111 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#ifdef USE_OPENGL
+
+#include "resources/image.h"
+
+#include <list>
+#include <vector>
+
+/**
+ * A large OpenGL texture that loaded images are packed into, so that images
+ * from different files can be drawn without switching textures.
+ *
+ * Images are placed on shelves: horizontal strips as high as the first image
+ * placed on them. Space of released images is not reused, the texture is
+ * deleted once all of its images are released.
+ */
+class TextureAtlas
+{
+    public:
+        /**
+         * Uploads the given surface into one of the atlases, creating a new
+         * atlas when none has room left.
+         *
+         * @return <code>NULL</code> if the image is too large to be packed,
+         *         a valid image using the atlas texture otherwise.
+         */
+        static Image *load(SDL_Surface *surface);
+
+        /**
+         * Releases the area used by the given image. Deletes the atlas when
+         * it was the last image in it.
+         */
+        static void release(TextureAtlas *atlas, int width, int height);
+
+        /**
+         * Returns the number of atlas textures in use.
+         */
+        static int getAtlasCount() { return mAtlases.size(); }
+
+        /**
+         * Returns the percentage of atlas texture space used by images.
+         */
+        static int getOccupancy();
+
+        /**
+         * Returns the percentage of the allocated atlas space that belonged
+         * to released images and can not be used again.
+         */
+        static int getFragmentation();
+
+    private:
+        /**
+         * A horizontal strip of the atlas.
+         */
+        struct Shelf
+        {
+            int y;          /**< Top of the shelf. */
+            int height;     /**< Height of the shelf. */
+            int used;       /**< Width used by the images on the shelf. */
+        };
+
+        TextureAtlas(int width, int height);
+
+        ~TextureAtlas();
+
+        /**
+         * Finds room for an area of the given size.
+         *
+         * @return <code>true</code> if there was room, <code>false</code>
+         *         otherwise.
+         */
+        bool allocate(int width, int height, int &x, int &y);
+
+        GLuint mTexture;
+        int mWidth, mHeight;
+        int mTop;                      /**< Top of the unused space. */
+        std::vector<Shelf> mShelves;
+
+        int mImageCount;               /**< Images using the atlas. */
+        int mUsedArea;                 /**< Area of the live images. */
+        int mFreedArea;                /**< Area of released images. */
+
+        static std::list<TextureAtlas*> mAtlases;
+};
+
+#endif // USE_OPENGL
+
+#endif
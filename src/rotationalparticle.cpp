@@ -20,6 +20,7 @@
  */
 
 #include "rotationalparticle.h"
+#include "game.h"
 #include "graphics.h"
 #include "simpleanimation.h"
 
@@ -70,7 +71,13 @@ bool RotationalParticle::update()
         }
     }
 
-    mImage = mAnimation->getCurrentImage();
+    Image *image = mAnimation->getCurrentImage();
+    if (image != mImage)
+    {
+        requestMapRedraw(this);
+        mImage = image;
+        requestMapRedraw(this);
+    }
 
     return Particle::update();
 }
@@ -123,6 +123,17 @@ bool SimpleAnimation::draw(Graphics* graphics, int posX, int posY) const
                                posY + mCurrentFrame->offsetY);
 }
 
+gcn::Rectangle SimpleAnimation::getArea(int posX, int posY) const
+{
+    if (!mCurrentFrame || !mCurrentFrame->image)
+        return gcn::Rectangle(posX, posY, 0, 0);
+
+    return gcn::Rectangle(posX + mCurrentFrame->offsetX,
+                          posY + mCurrentFrame->offsetY,
+                          mCurrentFrame->image->getWidth(),
+                          mCurrentFrame->image->getHeight());
+}
+
 void SimpleAnimation::reset()
 {
     mAnimationTime = 0;
@@ -139,8 +150,9 @@ void SimpleAnimation::setFrame(int frame)
     mCurrentFrame = mAnimation->getFrame(mAnimationPhase);
 }
 
-void SimpleAnimation::update(int timePassed)
+bool SimpleAnimation::update(int timePassed)
 {
+    const Frame *oldFrame = mCurrentFrame;
     mAnimationTime += timePassed;
 
     while (mAnimationTime > mCurrentFrame->delay && mCurrentFrame->delay > 0)
@@ -153,6 +165,8 @@ void SimpleAnimation::update(int timePassed)
 
         mCurrentFrame = mAnimation->getFrame(mAnimationPhase);
     }
+
+    return mCurrentFrame != oldFrame;
 }
 
 int SimpleAnimation::getLength() const
@@ -24,6 +24,8 @@
 
 #include "utils/xml.h"
 
+#include <guichan/rectangle.hpp>
+
 class Animation;
 class Frame;
 class Graphics;
@@ -52,10 +54,21 @@ class SimpleAnimation
 
         int getLength() const;
 
-        void update(int timePassed);
+        /**
+         * Advances the animation by the given time.
+         *
+         * @return whether a different frame is shown.
+         */
+        bool update(int timePassed);
 
         bool draw(Graphics* graphics, int posX, int posY) const;
 
+        /**
+         * Returns the area covered by the current frame when drawn at the
+         * given position.
+         */
+        gcn::Rectangle getArea(int posX, int posY) const;
+
         /**
          * Resets the animation.
          */
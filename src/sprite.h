@@ -22,6 +22,8 @@
 #ifndef SPRITE_H
 #define SPRITE_H
 
+#include "guichanfwd.h"
+
 class Graphics;
 
 /**
@@ -65,6 +67,16 @@ class Sprite
          */
         virtual int getPixelY() const = 0;
 
+        /**
+         * Gets the area covered by the sprite in map pixel coordinates. Used
+         * to skip sprites that are not on the screen.
+         *
+         * @return <code>false</code> when the area is unknown, in which case
+         *         the sprite is always drawn.
+         */
+        virtual bool getBounds(gcn::Rectangle &bounds) const
+        { return false; }
+
         /**
          * Returns the number of Image layers used to draw the sprite.
          */
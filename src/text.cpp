@@ -25,6 +25,7 @@
 #include <guichan/font.hpp>
 
 #include "configuration.h"
+#include "game.h"
 #include "textmanager.h"
 #include "resources/resourcemanager.h"
 #include "resources/image.h"
@@ -87,12 +88,16 @@ Text::Text(const std::string &text, int x, int y,
     }
     mX = x - mXOffset;
     mY = y;
-    textManager->addText(this);
+    mHandle = textManager->addText(this);
+
+    requestMapRedraw(getArea());
 }
 
 Text::~Text()
 {
-    textManager->removeText(this);
+    requestMapRedraw(getArea());
+    textManager->removeText(mHandle);
+
     if (--mInstances == 0)
     {
         delete textManager;
@@ -113,6 +118,7 @@ Text::~Text()
 void Text::setColor(const gcn::Color *color)
 {
     mColor = color;
+    requestMapRedraw(getArea());
 }
 
 void Text::adviseXY(int x, int y)
@@ -148,10 +154,19 @@ FlashText::FlashText(const std::string &text, int x, int y,
 {
 }
 
+void FlashText::flash(int time)
+{
+    mTime = time;
+    requestMapRedraw(getArea());
+}
+
 void FlashText::draw(gcn::Graphics *graphics, int xOff, int yOff)
 {
     if (mTime)
     {
+        // The flashing goes on for as many frames as are drawn
+        requestMapRedraw(getArea());
+
         if ((--mTime & 4) == 0)
             return;
     }
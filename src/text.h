@@ -27,8 +27,7 @@
 
 #include "graphics.h"
 #include "guichanfwd.h"
-
-class TextManager;
+#include "textmanager.h"
 
 class Text
 {
@@ -52,6 +51,13 @@ class Text
         int getWidth() const { return mWidth; }
         int getHeight() const { return mHeight; }
 
+        /**
+         * Returns the area covered by the text and its speech bubble, in map
+         * pixel coordinates.
+         */
+        gcn::Rectangle getArea() const
+        { return gcn::Rectangle(mX - 5, mY - 5, mWidth + 10, mHeight + 10); }
+
         /**
          * Allows the originator of the text to specify the ideal coordinates.
          */
@@ -65,6 +71,7 @@ class Text
     private:
         int mX;                /**< Actual x-value of left of text written. */
         int mY;                /**< Actual y-value of top of text written. */
+        int mDesiredY;         /**< The y-value asked for by the owner. */
         int mWidth;            /**< The width of the text. */
         int mHeight;           /**< The height of the text. */
         int mXOffset;          /**< The offset of mX from the desired x. */
@@ -73,6 +80,7 @@ class Text
         const gcn::Color *mColor;     /**< The color of the text. */
         gcn::Font *mFont;      /**< The font of the text */
         bool mIsSpeech;        /**< Is this text a speech bubble? */
+        TextManager::TextHandle mHandle; /**< Handle in the text manager */
 
     protected:
         static ImageRect mBubble;   /**< Speech bubble graphic */
@@ -94,7 +102,7 @@ class FlashText : public Text
         /**
          * Flash the text for so many refreshes.
          */
-        void flash(int time) {mTime = time; }
+        void flash(int time);
 
         /**
          * Draws the text.
@@ -21,40 +21,66 @@
 
 #include "textmanager.h"
 
+#include <algorithm>
 #include <cstring>
 
+#include "game.h"
 #include "text.h"
 
 TextManager *textManager = 0;
 
+/**
+ * The size of the grid cells in pixels.
+ */
+static const int CELL_SIZE = 64;
+
+/**
+ * The number of lines checked for other text when placing a text.
+ */
+static const int TEST = 100;
+
+/**
+ * Returns the cell the given coordinate is in, rounding down.
+ */
+static int cellOf(int v)
+{
+    return v >= 0 ? v / CELL_SIZE : (v - CELL_SIZE + 1) / CELL_SIZE;
+}
+
 TextManager::TextManager()
 {
 }
 
-void TextManager::addText(Text *text)
+TextManager::TextHandle TextManager::addText(Text *text)
 {
-    place(text, 0, text->mX, text->mY, text->mHeight);
-    mTextList.push_back(text);
+    text->mDesiredY = text->mY;
+    place(text, text->mX, text->mY, text->mHeight);
+    addToGrid(text);
+    return mTextList.insert(mTextList.end(), text);
 }
 
 void TextManager::moveText(Text *text, int x, int y)
 {
+    // Texts whose owner didn't move keep their place
+    if (text->mX == x && text->mDesiredY == y)
+        return;
+
+    requestMapRedraw(text->getArea());
+
+    removeFromGrid(text);
     text->mX = x;
     text->mY = y;
-    place(text, text, text->mX, text->mY, text->mHeight);
+    text->mDesiredY = y;
+    place(text, text->mX, text->mY, text->mHeight);
+    addToGrid(text);
+
+    requestMapRedraw(text->getArea());
 }
 
-void TextManager::removeText(const Text *text)
+void TextManager::removeText(TextHandle handle)
 {
-    for (TextList::iterator ptr = mTextList.begin(),
-             pEnd = mTextList.end(); ptr != pEnd; ++ptr)
-    {
-        if (*ptr == text)
-        {
-            mTextList.erase(ptr);
-            return;
-        }
-    }
+    removeFromGrid(*handle);
+    mTextList.erase(handle);
 }
 
 TextManager::~TextManager()
@@ -70,34 +96,91 @@ void TextManager::draw(gcn::Graphics *graphics, int xOff, int yOff)
     }
 }
 
-void TextManager::place(const Text *textObj, const Text *omit,
-                        int &x, int &y, int h)
+void TextManager::addToGrid(Text *text)
+{
+    const int left = cellOf(text->mX);
+    const int right = cellOf(text->mX + text->mWidth - 1);
+    const int top = cellOf(text->mY);
+    const int bottom = cellOf(text->mY + text->mHeight - 1);
+
+    for (int cy = top; cy <= bottom; ++cy)
+        for (int cx = left; cx <= right; ++cx)
+            mGrid[Cell(cx, cy)].push_back(text);
+}
+
+void TextManager::removeFromGrid(const Text *text)
+{
+    const int left = cellOf(text->mX);
+    const int right = cellOf(text->mX + text->mWidth - 1);
+    const int top = cellOf(text->mY);
+    const int bottom = cellOf(text->mY + text->mHeight - 1);
+
+    for (int cy = top; cy <= bottom; ++cy)
+    {
+        for (int cx = left; cx <= right; ++cx)
+        {
+            Grid::iterator cell = mGrid.find(Cell(cx, cy));
+            if (cell == mGrid.end())
+                continue;
+
+            std::vector<Text *> &texts = cell->second;
+            std::vector<Text *>::iterator i =
+                std::find(texts.begin(), texts.end(), text);
+            if (i != texts.end())
+            {
+                *i = texts.back();
+                texts.pop_back();
+            }
+
+            if (texts.empty())
+                mGrid.erase(cell);
+        }
+    }
+}
+
+void TextManager::place(const Text *textObj, int &x, int &y, int h)
 {
     int xLeft = textObj->mX;
     int xRight = xLeft + textObj->mWidth - 1;
-    const int TEST = 100; // Number of lines to test for text
     bool occupied[TEST]; // is some other text obscuring this line?
     std::memset(&occupied, 0, sizeof(occupied)); // set all to false
     int wantedTop = (TEST - h) / 2; // Entry in occupied at top of text
     int occupiedTop = y - wantedTop; // Line in map representing to of occupied
 
-    for (TextList::const_iterator ptr = mTextList.begin(),
-             pEnd = mTextList.end(); ptr != pEnd; ++ptr)
+    // Only the cells around the text can hold texts in the way. Texts
+    // covering several cells are seen more than once, which doesn't matter.
+    const int left = cellOf(xLeft);
+    const int right = cellOf(xRight);
+    const int top = cellOf(occupiedTop);
+    const int bottom = cellOf(occupiedTop + TEST - 1);
+
+    for (int cy = top; cy <= bottom; ++cy)
     {
-        if (*ptr != omit &&
-            (*ptr)->mX <= xRight &&
-            (*ptr)->mX + (*ptr)->mWidth > xLeft)
+        for (int cx = left; cx <= right; ++cx)
         {
-            int from = (*ptr)->mY - occupiedTop;
-            int to = from + (*ptr)->mHeight - 1;
-            if (to < 0 || from >= TEST) // out of range considered
+            Grid::const_iterator cell = mGrid.find(Cell(cx, cy));
+            if (cell == mGrid.end())
                 continue;
-            if (from < 0)
-                from = 0;
-            if (to >= TEST)
-                to = TEST - 1;
-            for (int i = from; i <= to; ++i)
-                occupied[i] = true;
+
+            for (std::vector<Text *>::const_iterator ptr =
+                     cell->second.begin(), pEnd = cell->second.end();
+                 ptr != pEnd; ++ptr)
+            {
+                if ((*ptr)->mX <= xRight &&
+                    (*ptr)->mX + (*ptr)->mWidth > xLeft)
+                {
+                    int from = (*ptr)->mY - occupiedTop;
+                    int to = from + (*ptr)->mHeight - 1;
+                    if (to < 0 || from >= TEST) // out of range considered
+                        continue;
+                    if (from < 0)
+                        from = 0;
+                    if (to >= TEST)
+                        to = TEST - 1;
+                    for (int i = from; i <= to; ++i)
+                        occupied[i] = true;
+                }
+            }
         }
     }
     bool ok = true;
@@ -23,14 +23,28 @@
 #define TEXTMANAGER_H
 
 #include <list>
+#include <map>
+#include <vector>
 
 #include "guichanfwd.h"
 
 class Text;
 
+/**
+ * Keeps track of the texts shown over the map, and moves them up or down so
+ * that they don't overlap. The texts are kept in a grid of cells, so that
+ * only the texts near a text are checked when placing it.
+ */
 class TextManager
 {
     public:
+        typedef std::list<Text *> TextList; /**< The container type */
+
+        /**
+         * Identifies a text added to the manager.
+         */
+        typedef TextList::iterator TextHandle;
+
         /**
          * Constructor
          */
@@ -38,18 +52,21 @@ class TextManager
 
         /**
          * Add text to the manager
+         *
+         * @return the handle to remove the text with
          */
-        void addText(Text *text);
+        TextHandle addText(Text *text);
 
         /**
-         * Move the text around the screen
+         * Move the text around the screen. The text is only placed again
+         * when the given position differs from the previous one.
          */
         void moveText(Text *text, int x, int y);
 
         /**
          * Remove the text from the manager
          */
-        void removeText(const Text *text);
+        void removeText(TextHandle handle);
 
         /**
          * Destroy the manager
@@ -65,11 +82,23 @@ class TextManager
         /**
          * Position the text so as to avoid conflict
          */
-        void place(const Text *textObj, const Text *omit,
-        int &x, int &y, int h);
+        void place(const Text *textObj, int &x, int &y, int h);
+
+        /**
+         * Adds the text to the cells it covers.
+         */
+        void addToGrid(Text *text);
+
+        /**
+         * Removes the text from the cells it covers.
+         */
+        void removeFromGrid(const Text *text);
+
+        typedef std::pair<int, int> Cell;
+        typedef std::map<Cell, std::vector<Text *> > Grid;
 
-        typedef std::list<Text *> TextList; /**< The container type */
         TextList mTextList; /**< The container */
+        Grid mGrid;         /**< The texts in each cell they cover */
 };
 
 extern TextManager *textManager;
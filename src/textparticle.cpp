@@ -20,6 +20,8 @@
  */
 
 #include <guichan/color.hpp>
+#include <guichan/font.hpp>
+#include <guichan/rectangle.hpp>
 
 #include "textparticle.h"
 
@@ -36,6 +38,18 @@ TextParticle::TextParticle(Map *map, const std::string &text,
 {
 }
 
+bool TextParticle::getBounds(gcn::Rectangle &bounds) const
+{
+    const int width = mTextFont->getWidth(mText);
+
+    // Leave room for the outline
+    bounds.x = (int) mPos.x - width / 2 - 1;
+    bounds.y = (int) mPos.y - (int) mPos.z - 1;
+    bounds.width = width + 2;
+    bounds.height = mTextFont->getHeight() + 2;
+    return true;
+}
+
 void TextParticle::draw(Graphics *graphics, int offsetX, int offsetY) const
 {
     if (!mAlive)
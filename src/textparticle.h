@@ -40,6 +40,11 @@ class TextParticle : public Particle
          */
         virtual void draw(Graphics *graphics, int offsetX, int offsetY) const;
 
+        /**
+         * @see Sprite::getBounds()
+         */
+        virtual bool getBounds(gcn::Rectangle &bounds) const;
+
         // hack to improve text visibility
         virtual int getPixelY() const
         { return (int) (mPos.y + mPos.z); }
@@ -0,0 +1,172 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tracer.h"
+
+#include "utils/clock.h"
+#include "utils/mutex.h"
+
+#include <SDL_thread.h>
+
+#include <fstream>
+#include <map>
+
+volatile bool Tracer::mEnabled = false;
+
+namespace {
+    Mutex traceMutex;
+    std::ofstream traceFile;
+    bool firstEvent;
+
+    /** The names given to the threads, by thread id. */
+    std::map<Uint32, std::string> threadNames;
+
+    /**
+     * Returns the given string quoted for use in JSON.
+     */
+    std::string quote(const std::string &str)
+    {
+        std::string result = "\"";
+        for (std::string::const_iterator i = str.begin(); i != str.end(); ++i)
+        {
+            const unsigned char c = *i;
+            if (c == '"' || c == '\\')
+            {
+                result += '\\';
+                result += c;
+            }
+            else if (c >= 0x20)
+            {
+                result += c;
+            }
+        }
+        result += '"';
+        return result;
+    }
+
+    /**
+     * Starts a new event in the trace file. Needs the trace mutex.
+     */
+    void beginEvent()
+    {
+        if (!firstEvent)
+            traceFile << ",\n";
+        firstEvent = false;
+    }
+
+    void writeThreadName(Uint32 thread, const std::string &name)
+    {
+        beginEvent();
+        traceFile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                  << "\"tid\":" << thread << ","
+                  << "\"args\":{\"name\":" << quote(name) << "}}";
+    }
+}
+
+bool Tracer::start(const std::string &fileName)
+{
+    MutexLocker lock(&traceMutex);
+
+    if (mEnabled)
+    {
+        traceFile << "\n]\n";
+        traceFile.close();
+        mEnabled = false;
+    }
+
+    traceFile.open(fileName.c_str(), std::ios_base::trunc);
+    if (!traceFile.is_open())
+        return false;
+
+    traceFile << "[\n";
+    firstEvent = true;
+
+    for (std::map<Uint32, std::string>::const_iterator i =
+             threadNames.begin(); i != threadNames.end(); ++i)
+    {
+        writeThreadName(i->first, i->second);
+    }
+
+    mEnabled = true;
+    return true;
+}
+
+void Tracer::stop()
+{
+    MutexLocker lock(&traceMutex);
+
+    if (!mEnabled)
+        return;
+
+    mEnabled = false;
+    traceFile << "\n]\n";
+    traceFile.close();
+}
+
+void Tracer::setThreadName(const std::string &name)
+{
+    MutexLocker lock(&traceMutex);
+
+    const Uint32 thread = SDL_ThreadID();
+    threadNames[thread] = name;
+
+    if (mEnabled)
+        writeThreadName(thread, name);
+}
+
+void Tracer::addSpan(const char *name, const std::string &detail,
+                     Uint64 start, Uint64 end)
+{
+    MutexLocker lock(&traceMutex);
+
+    if (!mEnabled)
+        return;
+
+    beginEvent();
+    traceFile << "{\"name\":" << quote(name) << ",\"ph\":\"X\","
+              << "\"ts\":" << start << ",\"dur\":" << (end - start) << ","
+              << "\"pid\":1,\"tid\":" << SDL_ThreadID();
+
+    if (!detail.empty())
+        traceFile << ",\"args\":{\"detail\":" << quote(detail) << "}";
+
+    traceFile << "}";
+}
+
+TraceScope::TraceScope(const char *name):
+    mName(name),
+    mStart(Tracer::isEnabled() ? getMicroseconds() : 0)
+{
+}
+
+TraceScope::TraceScope(const char *name, const std::string &detail):
+    mName(name),
+    mStart(Tracer::isEnabled() ? getMicroseconds() : 0)
+{
+    if (mStart)
+        mDetail = detail;
+}
+
+TraceScope::~TraceScope()
+{
+    if (mStart)
+        Tracer::addSpan(mName, mDetail, mStart, getMicroseconds());
+}
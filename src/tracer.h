@@ -0,0 +1,99 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <SDL_types.h>
+
+#include <string>
+
+/**
+ * Writes spans of time spent in instrumented code to a file in the trace
+ * event format, which can be loaded in the Chrome trace viewer
+ * (chrome://tracing). Spans can be recorded from any thread.
+ */
+class Tracer
+{
+    public:
+        /**
+         * Starts writing spans to the given file.
+         *
+         * @return <code>true</code> on success, <code>false</code> otherwise.
+         */
+        static bool start(const std::string &fileName);
+
+        /**
+         * Stops writing spans and closes the file.
+         */
+        static void stop();
+
+        /**
+         * Returns whether spans are being written.
+         */
+        static bool isEnabled() { return mEnabled; }
+
+        /**
+         * Names the calling thread in the trace.
+         */
+        static void setThreadName(const std::string &name);
+
+        /**
+         * Writes a span that started and ended at the given times, as
+         * returned by getMicroseconds().
+         */
+        static void addSpan(const char *name, const std::string &detail,
+                            Uint64 start, Uint64 end);
+
+    private:
+        static volatile bool mEnabled;
+};
+
+/**
+ * Records a span from its construction until the end of the scope, when
+ * tracing is enabled.
+ */
+class TraceScope
+{
+    public:
+        TraceScope(const char *name);
+
+        /**
+         * Constructor, taking a detail shown with the span, like the name of
+         * the file being loaded.
+         */
+        TraceScope(const char *name, const std::string &detail);
+
+        ~TraceScope();
+
+        /**
+         * Sets the detail shown with the span. Only worth calling when
+         * tracing is enabled.
+         */
+        void setDetail(const std::string &detail) { mDetail = detail; }
+
+    private:
+        const char *mName;
+        std::string mDetail;
+        Uint64 mStart;          /**< 0 when tracing was disabled */
+};
+
+#endif
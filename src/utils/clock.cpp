@@ -0,0 +1,69 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "utils/clock.h"
+
+#include <SDL_timer.h>
+
+#if defined WIN32
+#include <windows.h>
+#elif defined __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+Uint64 getMicroseconds()
+{
+#if defined WIN32
+    static LARGE_INTEGER frequency;
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (Uint64) (counter.QuadPart * 1000000.0 / frequency.QuadPart);
+#elif defined __APPLE__
+    static mach_timebase_info_data_t timebase;
+    if (!timebase.denom)
+        mach_timebase_info(&timebase);
+
+    return mach_absolute_time() * timebase.numer / timebase.denom / 1000;
+#else
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+        return (Uint64) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+    return (Uint64) SDL_GetTicks() * 1000;
+#endif
+}
+
+void sleepUntil(Uint64 time)
+{
+    const Uint64 now = getMicroseconds();
+    if (now >= time)
+        return;
+
+    // Rounded up, so that the caller doesn't wake up early and spin. SDL_Delay
+    // may oversleep by about a millisecond, which is accepted rather than
+    // busy-waiting to be on time.
+    SDL_Delay((Uint32) ((time - now + 999) / 1000));
+}
@@ -0,0 +1,39 @@
+/*
+ *  The Mana World
+ *  Copyright (C) 2009  The Mana World Development Team
+ *
+ *  This file is part of The Mana World.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef UTILS_CLOCK_H
+#define UTILS_CLOCK_H
+
+#include <SDL_types.h>
+
+/**
+ * Returns the time in microseconds since an unspecified starting point. The
+ * clock is monotonic, so it isn't affected by changes to the system time.
+ */
+Uint64 getMicroseconds();
+
+/**
+ * Sleeps until the given time, as returned by getMicroseconds(). May wake up
+ * about a millisecond late, but doesn't busy-wait.
+ */
+void sleepUntil(Uint64 time);
+
+#endif // UTILS_CLOCK_H